@@ -6,6 +6,10 @@
 CompilerOp* BasicBlock::_add_op(int opcode, int arg, int num_regs) {
   CompilerOp* op = new CompilerOp(opcode, arg);
   op->regs.resize(num_regs);
+  op->exc_handler = entry_stack->exc_handler();
+  // Jump preludes and except clauses are keyed by the negated offset of
+  // the bytecode they lead to.
+  op->py_offset = py_offset < 0 ? -py_offset : py_offset;
   alloc_.push_back(op);
   code.push_back(op);
   return op;
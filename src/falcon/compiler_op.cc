@@ -25,6 +25,9 @@ std::string CompilerOp::str() const {
     }
   }
   w.printf(")");
+  if (OpUtil::has_immediate(code)) {
+    w.printf(" #%d", imm);
+  }
 
   return w.str();
 }
@@ -22,6 +22,17 @@ struct CompilerOp {
   // is the last register argument a destination we're writing to?
   bool has_dest;
 
+  // immediate operand, for opcodes with OpUtil::has_immediate
+  int imm;
+
+  // Python offset of the innermost except clause covering this
+  // operation, or -1 if an error leaves the frame.
+  int exc_handler;
+
+  // Offset of the Python bytecode this operation was translated from, for
+  // the line numbers of tracebacks.
+  int py_offset;
+
   std::vector<int> regs;
 
   std::string str() const;
@@ -31,6 +42,9 @@ struct CompilerOp {
     this->arg = arg;
     this->dead = false;
     this->has_dest = false;
+    this->imm = 0;
+    this->exc_handler = -1;
+    this->py_offset = 0;
   }
 
   int dest() {
@@ -22,25 +22,41 @@ public:
   int num_locals;
 
   PyCodeObject* py_code;
-  PyObject* consts_tuple;
   unsigned char* py_codestr;
   Py_ssize_t py_codelen;
+
+  // The code object's constants and names to begin with.  Inlining another
+  // function appends its own.
+  PyObject* consts_tuple;
   PyObject* names;
 
+  // The globals of the function being compiled, or NULL for a bare code
+  // object.
+  PyObject* globals;
+
+  // The functions inlined into this one, and the builtins consuming the
+  // generator expressions fused into it, indexed by the arg of their
+  // GUARD_FUNCTION (borrowed).
+  std::vector<PyObject*> inlined_functions;
+
 
   std::map<int, BasicBlock*> bb_offsets;
 
+  // The LOAD_EXCEPTION block beginning the except clause at each Python
+  // offset.
+  std::map<int, BasicBlock*> exc_handlers;
+
   CompilerState() :
       num_reg(0), num_consts(0), num_locals(0),
-      py_code(NULL),  consts_tuple(NULL),
-      py_codestr(NULL), py_codelen(0),
-      names(NULL) { }
+      py_code(NULL), py_codestr(NULL), py_codelen(0),
+      consts_tuple(NULL), names(NULL), globals(NULL) { }
 
   CompilerState(PyCodeObject* code) {
 
     int codelen = PyString_GET_SIZE(code->co_code);
     py_code = code;
     consts_tuple = code->co_consts;
+    Py_INCREF(consts_tuple);
     num_consts = PyTuple_Size(consts_tuple);
     num_locals = code->co_nlocals;
     // Offset by the number of constants and locals.
@@ -51,13 +67,16 @@ public:
     py_codestr = (unsigned char*) PyString_AsString(code->co_code);
 
     names = code->co_names;
-
+    Py_INCREF(names);
+    globals = NULL;
   }
 
   ~CompilerState() {
     for (auto bb : alloc_) {
       delete bb;
     }
+    Py_XDECREF(consts_tuple);
+    Py_XDECREF(names);
   }
 
   int num_ops() {
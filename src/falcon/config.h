@@ -5,6 +5,8 @@
 // These defines enable/disable certain optimizations in the
 // evaluator:
 
+// Take the registers of each frame from the thread's RegisterFile rather
+// than the heap.
 #ifndef STACK_ALLOC_REGISTERS
 #define STACK_ALLOC_REGISTERS 1
 #endif
@@ -21,12 +23,21 @@
 #define REUSE_INT_REGISTERS 0
 #endif
 
+// Compile try/except blocks.  Without this, functions containing them are
+// left to CPython.  try/finally and with statements are never compiled.
 #ifndef ENABLE_EXCEPTIONS
-#define ENABLE_EXCEPTIONS 0
+#define ENABLE_EXCEPTIONS 1
 #endif
 
+// Keep small integers unboxed (tagged) in registers; see register.h.
 #ifndef USE_TYPED_REGISTERS
-#define USE_TYPED_REGISTERS 0
+#define USE_TYPED_REGISTERS 1
+#endif
+
+// Box doubles and 48 bit integers into the NaN space of a register rather
+// than tag them; see register.h.  Takes precedence over USE_TYPED_REGISTERS.
+#ifndef USE_NAN_BOXING
+#define USE_NAN_BOXING 0
 #endif
 
 #ifndef USE_THREADED_DISPATCH
@@ -37,6 +48,50 @@
 #endif
 #endif
 
+// With direct threading, the opcode field of each instruction is replaced
+// by the address of its handler when a function is first evaluated, so
+// dispatch is a single indirect jump.  Requires threaded dispatch.
+#ifndef USE_DIRECT_THREADING
+#define USE_DIRECT_THREADING USE_THREADED_DISPATCH
+#endif
+
+#if USE_DIRECT_THREADING && !USE_THREADED_DISPATCH
+#error "USE_DIRECT_THREADING requires USE_THREADED_DISPATCH"
+#endif
+
+// Dispatch by tail calls between one function per handler, rather than
+// by jumps within Evaluator::eval.  The code field of each instruction
+// holds the address of its handler function, so this requires direct
+// threading.  Disassembly still runs through Evaluator::eval.
+#ifndef USE_TAILCALL_DISPATCH
+#define USE_TAILCALL_DISPATCH 0
+#endif
+
+#if USE_TAILCALL_DISPATCH && !USE_DIRECT_THREADING
+#error "USE_TAILCALL_DISPATCH requires USE_DIRECT_THREADING"
+#endif
+
+// Fuse common opcode sequences into single instructions (see
+// superinstructions.h).
+#ifndef USE_SUPERINSTRUCTIONS
+#define USE_SUPERINSTRUCTIONS 1
+#endif
+
+// Count executed opcode pairs and triples, and append them to the file
+// named by $FALCON_OP_PROFILE at exit.  The output is the input for
+// tools/gen_superinstructions.py.  Superinstructions are not formed
+// in profiling builds.
+#ifndef PROFILE_OP_SEQUENCES
+#define PROFILE_OP_SEQUENCES 0
+#endif
+
+// Let generic operations rewrite themselves at runtime to forms specialized
+// for the operand types they see (e.g. BINARY_SUBSCR to BINARY_SUBSCR_LIST).
+// Off in profiling builds, which must record the compiler's opcodes.
+#ifndef USE_QUICKENING
+#define USE_QUICKENING !PROFILE_OP_SEQUENCES
+#endif
+
 #ifndef MAX_REGISTERS
 // will fail for sufficiently large functions without CompactRegisters opt
 #define MAX_REGISTERS 1024
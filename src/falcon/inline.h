@@ -40,4 +40,33 @@
 
 #endif
 
+/* guaranteed tail calls; without them, tail calls are left to sibling
+   call optimization */
+
+#if defined(__clang__)
+#if __has_cpp_attribute(clang::musttail)
+#define f_musttail [[clang::musttail]]
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 15
+#define f_musttail [[gnu::musttail]]
+#endif
+
+#ifndef f_musttail
+#define f_musttail
+#define f_musttail_unsupported 1
+#endif
+
+/* calling convention for functions which only tail-call one another, so
+   need not preserve any registers */
+
+#if defined(__clang__) && defined(__has_attribute)
+#if __has_attribute(preserve_none)
+#define f_tailcc __attribute__((preserve_none))
+#endif
+#endif
+
+#ifndef f_tailcc
+#define f_tailcc
+#endif
+
 #endif
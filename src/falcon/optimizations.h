@@ -2,11 +2,15 @@
 #define FALCON_OPTIMIZATIONS_H
 
 #include <map>
+#include <set>
+#include <vector>
 
 #include "opcode.h"
+#include "config.h"
 #include "util.h"
 #include "compiler_pass.h"
 #include "basic_block.h"
+#include "rcompile.h"
 
 class UseCounts {
 protected:
@@ -122,6 +126,866 @@ public:
   }
 };
 
+// Inline calls to small functions which make no calls of their own.
+//
+// A CALL_FUNCTION passing only positional arguments, whose callable is
+// loaded by a LOAD_GLOBAL earlier in its basic block, is inlined if that
+// global names such a function when we compile.  The block is split at
+// the call:
+//
+//   GUARD_FUNCTION(f)  ->  the function's basic blocks, with its registers
+//                          renumbered into ours and each return moving its
+//                          value into the call's result
+//                      ->  the original call, if f has been rebound
+//
+// and both rejoin at the rest of the block.  The inlined body runs in our
+// frame: it sees our globals, so a function from another module is only
+// inlined if it uses none, and errors it raises appear to come from the
+// call.
+//
+// Generator expressions passed straight to sum, any, all, list, tuple or
+// str.join are fused into their consumer the same way (see
+// fuse_generator), so that no generator is made or resumed.
+class InlineCalls: public CompilerPass {
+private:
+  static const size_t kMaxInlineOps = 16;
+  static const size_t kMaxInlinedCalls = 32;
+
+  // What a builtin consuming a generator expression does with its items.
+  enum Consumer {
+    CONSUME_NONE,
+    CONSUME_SUM,
+    CONSUME_ANY,
+    CONSUME_ALL,
+    CONSUME_LIST,
+    // Builtins which make a sequence of all the items before looking at
+    // any, so can be passed a list of them instead.  min and max aren't:
+    // they compare each item as it comes.
+    CONSUME_COLLECT,
+  };
+
+  bool fuse_generators_;
+  CompilerState* fn_;
+  int num_consts_;
+  int next_offset_;
+
+  // Constants of the inlined functions which we don't have.  Until all
+  // calls are inlined, each is held by a temporary register.
+  std::vector<PyObject*> new_consts_;
+  std::map<PyObject*, int> new_const_registers_;
+  std::map<int, int> const_indices_;
+
+  // The blocks holding the original calls, which are left alone.
+  std::set<BasicBlock*> slow_paths_;
+
+  static bool can_inline(int opcode) {
+    switch (opcode) {
+    case LOAD_GLOBAL:
+    case STORE_GLOBAL:
+    case LOAD_ATTR:
+    case STORE_ATTR:
+    case STORE_FAST:
+    case STORE_SUBSCR:
+    case STORE_MAP:
+    case CONST_INDEX:
+    case SLICE:
+    case BUILD_TUPLE:
+    case BUILD_LIST:
+    case BUILD_SET:
+    case BUILD_MAP:
+    case UNARY_NOT:
+    case UNARY_POSITIVE:
+    case UNARY_NEGATIVE:
+    case UNARY_CONVERT:
+    case UNARY_INVERT:
+    case BINARY_POWER:
+    case BINARY_MULTIPLY:
+    case BINARY_DIVIDE:
+    case BINARY_TRUE_DIVIDE:
+    case BINARY_FLOOR_DIVIDE:
+    case BINARY_MODULO:
+    case BINARY_ADD:
+    case BINARY_SUBTRACT:
+    case BINARY_SUBSCR:
+    case BINARY_LSHIFT:
+    case BINARY_RSHIFT:
+    case BINARY_AND:
+    case BINARY_XOR:
+    case BINARY_OR:
+    case INPLACE_POWER:
+    case INPLACE_MULTIPLY:
+    case INPLACE_DIVIDE:
+    case INPLACE_TRUE_DIVIDE:
+    case INPLACE_FLOOR_DIVIDE:
+    case INPLACE_MODULO:
+    case INPLACE_ADD:
+    case INPLACE_SUBTRACT:
+    case INPLACE_LSHIFT:
+    case INPLACE_RSHIFT:
+    case INPLACE_AND:
+    case INPLACE_XOR:
+    case INPLACE_OR:
+    case COMPARE_OP:
+    case POP_JUMP_IF_FALSE:
+    case POP_JUMP_IF_TRUE:
+    case JUMP_IF_FALSE_OR_POP:
+    case JUMP_IF_TRUE_OR_POP:
+    case JUMP_ABSOLUTE:
+    case RETURN_VALUE:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  // Operations whose arg indexes the names.
+  static bool uses_name(int opcode) {
+    return opcode == LOAD_GLOBAL || opcode == STORE_GLOBAL || opcode == LOAD_ATTR || opcode == STORE_ATTR;
+  }
+
+  static void mark_entries(CompilerState* state) {
+    for (BasicBlock* bb : state->bbs) {
+      bb->entries.clear();
+    }
+    MarkEntries()(state);
+  }
+
+  // A copy of tuple with item appended, replacing tuple.
+  static PyObject* tuple_append(PyObject* tuple, PyObject* item) {
+    Py_ssize_t n = PyTuple_GET_SIZE(tuple);
+    PyObject* result = PyTuple_New(n + 1);
+    Reg_Assert(result != NULL, "Failed to allocate tuple");
+    for (Py_ssize_t i = 0; i < n; ++i) {
+      PyObject* v = PyTuple_GET_ITEM(tuple, i);
+      Py_INCREF(v);
+      PyTuple_SET_ITEM(result, i, v);
+    }
+    Py_INCREF(item);
+    PyTuple_SET_ITEM(result, n, item);
+    Py_DECREF(tuple);
+    return result;
+  }
+
+  // The position of the last operation before end in bb which writes
+  // reg, or -1.
+  static int find_def(BasicBlock* bb, size_t end, int reg) {
+    for (size_t i = end; i-- > 0;) {
+      CompilerOp* op = bb->code[i];
+      if (!op->dead && op->has_dest && op->dest() == reg) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  // The function the callable of the call at call_idx names when we
+  // compile, if bb loads it from our globals.
+  PyObject* find_callee(BasicBlock* bb, size_t call_idx) {
+    int def = find_def(bb, call_idx, bb->code[call_idx]->regs[0]);
+    if (def == -1 || bb->code[def]->code != LOAD_GLOBAL) {
+      return NULL;
+    }
+    PyObject* callee = PyDict_GetItem(fn_->globals, PyTuple_GET_ITEM(fn_->names, bb->code[def]->arg));
+    return (callee != NULL && PyFunction_Check(callee)) ? callee : NULL;
+  }
+
+  // Whether every path through body stores each of its locals other than
+  // the arguments before reading it.  In our frame, the registers they are
+  // given may still hold values from an earlier call.
+  static bool locals_assigned(CompilerState* body, int num_args) {
+    const int first = body->num_consts;
+    const int last = body->num_consts + body->num_locals;
+    std::vector<BasicBlock*> bbs;
+    std::map<BasicBlock*, std::vector<bool> > assigned_out;
+    for (BasicBlock* bb : body->bbs) {
+      if (!bb->dead) {
+        bbs.push_back(bb);
+        assigned_out[bb].assign(body->num_locals, true);
+      }
+    }
+
+    auto assigned_in = [&](BasicBlock* bb) {
+      std::vector<bool> assigned(body->num_locals, true);
+      if (bb == bbs[0]) {
+        for (int i = num_args; i < body->num_locals; ++i) {
+          assigned[i] = false;
+        }
+      }
+      for (BasicBlock* pred : bb->entries) {
+        const std::vector<bool>& out = assigned_out[pred];
+        for (int i = 0; i < body->num_locals; ++i) {
+          assigned[i] = assigned[i] && out[i];
+        }
+      }
+      return assigned;
+    };
+
+    // Narrow from everything assigned down to a fixed point.
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (BasicBlock* bb : bbs) {
+        std::vector<bool> assigned = assigned_in(bb);
+        for (CompilerOp* op : bb->code) {
+          if (op->has_dest && op->dest() >= first && op->dest() < last) {
+            assigned[op->dest() - first] = true;
+          }
+        }
+        if (assigned != assigned_out[bb]) {
+          assigned_out[bb] = assigned;
+          changed = true;
+        }
+      }
+    }
+
+    for (BasicBlock* bb : bbs) {
+      std::vector<bool> assigned = assigned_in(bb);
+      for (CompilerOp* op : bb->code) {
+        for (size_t i = 0; i < op->num_inputs(); ++i) {
+          int reg = op->regs[i];
+          if (reg >= first && reg < last && !assigned[reg - first]) {
+            return false;
+          }
+        }
+        if (op->has_dest && op->dest() >= first && op->dest() < last) {
+          assigned[op->dest() - first] = true;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Translate the body of callee into body, if it is small enough to
+  // inline, makes no calls, and takes exactly num_args arguments.
+  bool load_body(PyObject* callee, int num_args, CompilerState* body) {
+    PyCodeObject* code = body->py_code;
+    if (code->co_argcount != num_args ||
+        (code->co_flags & (CO_VARARGS | CO_VARKEYWORDS | CO_GENERATOR)) ||
+        PyTuple_GET_SIZE(code->co_cellvars) > 0 || PyTuple_GET_SIZE(code->co_freevars) > 0 ||
+        body->py_codelen > (Py_ssize_t) (8 * kMaxInlineOps)) {
+      return false;
+    }
+
+    RegisterStack stack;
+    try {
+      if (Compiler::registerize(body, &stack, 0) == NULL) {
+        return false;
+      }
+    } catch (RException) {
+      return false;
+    }
+    MarkEntries()(body);
+    FuseBasicBlocks()(body);
+    mark_entries(body);
+
+    const bool own_globals = PyFunction_GET_GLOBALS(callee) == fn_->globals;
+    size_t num_ops = 0;
+    for (BasicBlock* bb : body->bbs) {
+      if (bb->dead) {
+        continue;
+      }
+      for (CompilerOp* op : bb->code) {
+        if (!can_inline(op->code) || op->exc_handler != -1 ||
+            (!own_globals && (op->code == LOAD_GLOBAL || op->code == STORE_GLOBAL))) {
+          return false;
+        }
+        ++num_ops;
+      }
+    }
+    return num_ops <= kMaxInlineOps && locals_assigned(body, num_args);
+  }
+
+  // The register holding obj: one of our constants, or the temporary
+  // standing in for a new one.
+  int add_const(PyObject* obj) {
+    for (int i = 0; i < num_consts_; ++i) {
+      if (PyTuple_GET_ITEM(fn_->consts_tuple, i) == obj) {
+        return i;
+      }
+    }
+    auto iter = new_const_registers_.find(obj);
+    if (iter != new_const_registers_.end()) {
+      return iter->second;
+    }
+    int reg = fn_->num_reg++;
+    new_const_registers_[obj] = reg;
+    const_indices_[reg] = new_consts_.size();
+    new_consts_.push_back(obj);
+    return reg;
+  }
+
+  int add_name(PyObject* name) {
+    Py_ssize_t n = PyTuple_GET_SIZE(fn_->names);
+    for (Py_ssize_t i = 0; i < n; ++i) {
+      PyObject* item = PyTuple_GET_ITEM(fn_->names, i);
+      if (item == name || _PyString_Eq(item, name)) {
+        return i;
+      }
+    }
+    fn_->names = tuple_append(fn_->names, name);
+    return n;
+  }
+
+  BasicBlock* new_block(BasicBlock* bb) {
+    return fn_->alloc_bb(next_offset_++, bb->entry_stack);
+  }
+
+  // Append a copy of op, from body, to block, renumbering its registers
+  // with map_reg.
+  template<class RegMap>
+  CompilerOp* copy_op(BasicBlock* block, CompilerOp* op, CompilerState* body, RegMap& map_reg, int exc_handler) {
+    int arg = uses_name(op->code) ? add_name(PyTuple_GET_ITEM(body->names, op->arg)) : op->arg;
+    CompilerOp* copy = block->add_op(op->code, arg);
+    copy->has_dest = op->has_dest;
+    copy->imm = op->imm;
+    copy->exc_handler = exc_handler;
+    for (int reg : op->regs) {
+      copy->regs.push_back(map_reg(reg));
+    }
+    return copy;
+  }
+
+  void inline_call(size_t bb_idx, size_t call_idx, PyObject* callee, CompilerState* body) {
+    BasicBlock* bb = fn_->bbs[bb_idx];
+    CompilerOp* call = bb->code[call_idx];
+    const int num_args = call->regs.size() - 2;
+    const int dst = call->dest();
+    const int exc_handler = call->exc_handler;
+
+    std::vector<BasicBlock*> body_bbs;
+    for (BasicBlock* body_bb : body->bbs) {
+      if (!body_bb->dead) {
+        body_bbs.push_back(body_bb);
+      }
+    }
+
+    // Arguments the function never stores to are read from our registers
+    // directly; the rest are copied into registers of their own.
+    std::map<int, int> regs;
+    regs[-1] = -1;
+    for (int i = 0; i < body->num_consts; ++i) {
+      regs[i] = add_const(PyTuple_GET_ITEM(body->consts_tuple, i));
+    }
+    std::set<int> stored;
+    for (BasicBlock* body_bb : body_bbs) {
+      for (CompilerOp* op : body_bb->code) {
+        if (op->has_dest) {
+          stored.insert(op->dest());
+        }
+      }
+    }
+    std::vector<std::pair<int, int> > arg_moves;
+    for (int i = 0; i < num_args; ++i) {
+      int param = body->num_consts + i;
+      if (stored.count(param)) {
+        regs[param] = fn_->num_reg++;
+        arg_moves.push_back(std::make_pair(call->regs[1 + i], regs[param]));
+      } else {
+        regs[param] = call->regs[1 + i];
+      }
+    }
+    auto map_reg = [&](int reg) {
+      auto iter = regs.find(reg);
+      if (iter != regs.end()) {
+        return iter->second;
+      }
+      return regs[reg] = fn_->num_reg++;
+    };
+
+    // Allocated last, the inlined blocks and the rest of bb are moved
+    // after bb below; the original call stays at the end.
+    BasicBlock* slow = new_block(bb);
+    std::map<BasicBlock*, BasicBlock*> block_map;
+    std::vector<BasicBlock*> blocks;
+    for (BasicBlock* body_bb : body_bbs) {
+      blocks.push_back(block_map[body_bb] = new_block(bb));
+    }
+    BasicBlock* cont = new_block(bb);
+
+    for (auto& move : arg_moves) {
+      blocks[0]->add_dest_op(STORE_FAST, 0, move.first, move.second)->exc_handler = exc_handler;
+    }
+    for (size_t i = 0; i < body_bbs.size(); ++i) {
+      BasicBlock* body_bb = body_bbs[i];
+      BasicBlock* block = blocks[i];
+      for (CompilerOp* op : body_bb->code) {
+        if (op->code == RETURN_VALUE) {
+          block->add_dest_op(STORE_FAST, 0, map_reg(op->regs[0]), dst)->exc_handler = exc_handler;
+          if (i + 1 < blocks.size()) {
+            block->add_op(JUMP_ABSOLUTE, 0)->exc_handler = exc_handler;
+          }
+          block->exits.push_back(cont);
+          break;
+        }
+        copy_op(block, op, body, map_reg, exc_handler);
+      }
+      if (block->exits.empty()) {
+        for (BasicBlock* exit : body_bb->exits) {
+          block->exits.push_back(block_map[exit]);
+        }
+      }
+    }
+
+    cont->code.assign(bb->code.begin() + call_idx + 1, bb->code.end());
+    cont->exits = bb->exits;
+
+    bb->code.resize(call_idx);
+    bb->add_op(GUARD_FUNCTION, fn_->inlined_functions.size(), call->regs[0])->exc_handler = exc_handler;
+    fn_->inlined_functions.push_back(callee);
+    bb->exits.clear();
+    bb->exits.push_back(blocks[0]);
+    bb->exits.push_back(slow);
+
+    slow->code.push_back(call);
+    slow->add_op(JUMP_ABSOLUTE, 0)->exc_handler = exc_handler;
+    slow->exits.push_back(cont);
+    slow_paths_.insert(slow);
+
+    // Errors in the inlined body are reported at the line of the call.
+    bb->code.back()->py_offset = call->py_offset;
+    slow->code.back()->py_offset = call->py_offset;
+    for (BasicBlock* block : blocks) {
+      for (CompilerOp* op : block->code) {
+        op->py_offset = call->py_offset;
+      }
+    }
+
+    std::vector<BasicBlock*> moved(fn_->bbs.end() - (blocks.size() + 1), fn_->bbs.end());
+    fn_->bbs.resize(fn_->bbs.size() - moved.size());
+    fn_->bbs.insert(fn_->bbs.begin() + bb_idx + 1, moved.begin(), moved.end());
+  }
+
+  // The number of operations reading reg.
+  int num_uses(int reg) {
+    int n = 0;
+    for (BasicBlock* bb : fn_->bbs) {
+      for (CompilerOp* op : bb->code) {
+        for (size_t i = 0; i < op->num_inputs(); ++i) {
+          n += !op->dead && op->regs[i] == reg;
+        }
+      }
+    }
+    return n;
+  }
+
+  // The constant reg holds, or NULL if it isn't one.
+  PyObject* const_value(int reg) {
+    if (reg >= 0 && reg < num_consts_) {
+      return PyTuple_GET_ITEM(fn_->consts_tuple, reg);
+    }
+    auto iter = const_indices_.find(reg);
+    return iter == const_indices_.end() ? NULL : new_consts_[iter->second];
+  }
+
+  // Whether obj is the code of a generator expression, which takes the
+  // iterator of its first loop as its only argument.
+  static bool is_genexpr(PyObject* obj) {
+    if (obj == NULL || !PyCode_Check(obj)) {
+      return false;
+    }
+    PyCodeObject* code = (PyCodeObject*) obj;
+    return (code->co_flags & CO_GENERATOR) && !(code->co_flags & (CO_VARARGS | CO_VARKEYWORDS)) &&
+        code->co_argcount == 1 && PyTuple_GET_SIZE(code->co_cellvars) == 0 &&
+        strcmp(PyString_AS_STRING(code->co_name), "<genexpr>") == 0;
+  }
+
+  // What the callable loaded by def does with a generator expression, and
+  // in guard the builtin it must still be when we call it, if any.
+  Consumer find_consumer(CompilerOp* def, PyObject** guard) {
+    static const struct {
+      const char* name;
+      Consumer consumer;
+    } kConsumers[] = {
+      { "sum", CONSUME_SUM },
+      { "any", CONSUME_ANY },
+      { "all", CONSUME_ALL },
+      { "list", CONSUME_LIST },
+      { "tuple", CONSUME_COLLECT },
+    };
+
+    *guard = NULL;
+    if (def->code != LOAD_GLOBAL && def->code != LOAD_ATTR) {
+      return CONSUME_NONE;
+    }
+    PyObject* name = PyTuple_GET_ITEM(fn_->names, def->arg);
+    if (def->code == LOAD_ATTR) {
+      // The join of a constant string, which can't be rebound.
+      PyObject* obj = const_value(def->regs[0]);
+      bool join = obj != NULL && PyString_CheckExact(obj) && strcmp(PyString_AS_STRING(name), "join") == 0;
+      return join ? CONSUME_COLLECT : CONSUME_NONE;
+    }
+
+    PyObject* builtins = PyModule_GetDict(PyImport_AddModule("__builtin__"));
+    PyObject* value = PyDict_GetItem(fn_->globals, name);
+    if (value == NULL) {
+      value = PyDict_GetItem(builtins, name);
+    }
+    for (auto& c : kConsumers) {
+      if (value != NULL && value == PyDict_GetItemString(builtins, c.name)) {
+        *guard = value;
+        return c.consumer;
+      }
+    }
+    return CONSUME_NONE;
+  }
+
+  // Translate the body of a generator expression into body, if it can run
+  // in our frame: it yields once, and reads no local it hasn't stored.
+  static bool load_generator(CompilerState* body) {
+    RegisterStack stack;
+    try {
+      if (Compiler::registerize(body, &stack, 0) == NULL) {
+        return false;
+      }
+    } catch (RException) {
+      return false;
+    }
+    MarkEntries()(body);
+    FuseBasicBlocks()(body);
+    mark_entries(body);
+
+    int num_yields = 0;
+    int sent = -1;
+    std::set<int> inputs;
+    for (BasicBlock* bb : body->bbs) {
+      if (bb->dead) {
+        continue;
+      }
+      for (CompilerOp* op : bb->code) {
+        switch (op->code) {
+        case YIELD_VALUE:
+          ++num_yields;
+          sent = op->dest();
+          break;
+        case LOAD_NAME:
+        case STORE_NAME:
+        case DELETE_NAME:
+        case LOAD_LOCALS:
+        case DELETE_ATTR:
+        case DELETE_GLOBAL:
+        case IMPORT_NAME:
+        case IMPORT_FROM:
+          return false;
+        }
+        if (op->exc_handler != -1) {
+          return false;
+        }
+        for (size_t i = 0; i < op->num_inputs(); ++i) {
+          inputs.insert(op->regs[i]);
+        }
+      }
+    }
+    return num_yields == 1 && !inputs.count(sent) && locals_assigned(body, 1);
+  }
+
+  // Run the generator expression called at call_idx of bb as a loop in our
+  // frame, if the call after it passes its generator to a builtin we know.
+  // The block is split at the calls:
+  //
+  //   GUARD_FUNCTION(consumer)  ->  the expression's basic blocks, iterating
+  //                                 over our register, and each yield adding
+  //                                 up, testing or collecting its item
+  //                             ->  the original calls, if consumer has been
+  //                                 rebound
+  //
+  // and both rejoin at the rest of the block.  Errors in the expression go
+  // to a CATCH_STOP_ITERATION, since StopIteration ends a generator; those
+  // of the consumer itself don't.  str.join is never rebound, so has no
+  // guard.
+  bool fuse_generator(size_t bb_idx, size_t call_idx) {
+    BasicBlock* bb = fn_->bbs[bb_idx];
+    if (call_idx + 1 >= bb->code.size()) {
+      return false;
+    }
+    CompilerOp* call = bb->code[call_idx];
+    CompilerOp* consumer = bb->code[call_idx + 1];
+    if (call->arg != 1 || consumer->dead || consumer->code != CALL_FUNCTION || consumer->arg != 1 ||
+        consumer->regs[1] != call->dest() || num_uses(call->dest()) != 1) {
+      return false;
+    }
+    const int make_idx = find_def(bb, call_idx, call->regs[0]);
+    const int iter_idx = find_def(bb, call_idx, call->regs[1]);
+    const int callable_idx = find_def(bb, call_idx, consumer->regs[0]);
+    if (make_idx == -1 || iter_idx == -1 || callable_idx == -1 || bb->code[iter_idx]->code != GET_ITER) {
+      return false;
+    }
+    CompilerOp* make = bb->code[make_idx];
+    if ((make->code != MAKE_FUNCTION && make->code != MAKE_CLOSURE) || make->arg != 0 ||
+        num_uses(make->dest()) != 1 || !is_genexpr(const_value(make->regs[0]))) {
+      return false;
+    }
+    PyObject* guard;
+    const Consumer kind = find_consumer(bb->code[callable_idx], &guard);
+    if (kind == CONSUME_NONE) {
+      return false;
+    }
+
+    // Our cells which the expression's free variables are, from the
+    // LOAD_CLOSUREs making its closure.  Those and the function itself are
+    // only needed by the original calls.
+    PyCodeObject* code = (PyCodeObject*) const_value(make->regs[0]);
+    std::vector<int> cells;
+    std::set<int> moved;
+    moved.insert(make_idx);
+    if (make->code == MAKE_CLOSURE) {
+      const int tuple_idx = find_def(bb, make_idx, make->regs[1]);
+      if (tuple_idx == -1 || bb->code[tuple_idx]->code != BUILD_TUPLE || num_uses(make->regs[1]) != 1) {
+        return false;
+      }
+      CompilerOp* tuple = bb->code[tuple_idx];
+      for (size_t i = 0; i < tuple->num_inputs(); ++i) {
+        const int load_idx = find_def(bb, tuple_idx, tuple->regs[i]);
+        if (load_idx == -1 || bb->code[load_idx]->code != LOAD_CLOSURE || num_uses(tuple->regs[i]) != 1) {
+          return false;
+        }
+        cells.push_back(bb->code[load_idx]->arg);
+        moved.insert(load_idx);
+      }
+      moved.insert(tuple_idx);
+    }
+    if ((Py_ssize_t) cells.size() != PyTuple_GET_SIZE(code->co_freevars)) {
+      return false;
+    }
+
+    CompilerState body(code);
+    if (!load_generator(&body)) {
+      return false;
+    }
+    COMPILE_LOG("Fusing generator expression into %s",
+                PyString_AsString(PyTuple_GET_ITEM(fn_->names, bb->code[callable_idx]->arg)));
+
+    const int exc_handler = call->exc_handler;
+    const int dst = consumer->dest();
+    const size_t first_new = fn_->bbs.size();
+
+    // The argument of the expression is the iterator.
+    std::map<int, int> regs;
+    regs[-1] = -1;
+    for (int i = 0; i < body.num_consts; ++i) {
+      regs[i] = add_const(PyTuple_GET_ITEM(body.consts_tuple, i));
+    }
+    regs[body.num_consts] = call->regs[1];
+    auto map_reg = [&](int reg) {
+      auto iter = regs.find(reg);
+      if (iter != regs.end()) {
+        return iter->second;
+      }
+      return regs[reg] = fn_->num_reg++;
+    };
+
+    // sum adds up and list appends to its result directly; the rest of the
+    // collecting builtins are called with a list of the items at the end.
+    const int acc = (kind == CONSUME_COLLECT) ? fn_->num_reg++ : dst;
+
+    std::vector<BasicBlock*> body_bbs;
+    for (BasicBlock* body_bb : body.bbs) {
+      if (!body_bb->dead) {
+        body_bbs.push_back(body_bb);
+      }
+    }
+    BasicBlock* init = new_block(bb);
+    std::map<BasicBlock*, BasicBlock*> block_map;
+    for (BasicBlock* body_bb : body_bbs) {
+      block_map[body_bb] = new_block(bb);
+    }
+    BasicBlock* found = (kind == CONSUME_ANY || kind == CONSUME_ALL) ? new_block(bb) : NULL;
+    BasicBlock* done = (kind == CONSUME_SUM || kind == CONSUME_LIST) ? NULL : new_block(bb);
+    BasicBlock* cont = new_block(bb);
+    BasicBlock* slow = guard ? new_block(bb) : NULL;
+    BasicBlock* handler = new_block(bb);
+    BasicBlock* finish = done ? done : cont;
+
+    if (kind == CONSUME_SUM) {
+      static PyObject* zero = PyInt_FromLong(0);
+      init->add_dest_op(STORE_FAST, 0, add_const(zero), acc)->exc_handler = exc_handler;
+    } else if (kind == CONSUME_LIST || kind == CONSUME_COLLECT) {
+      init->add_dest_op(BUILD_LIST, 0, acc)->exc_handler = exc_handler;
+    }
+    init->exits.push_back(block_map[body_bbs[0]]);
+    init->exits.push_back(handler);
+
+    std::vector<BasicBlock*> layout(1, init);
+    for (BasicBlock* body_bb : body_bbs) {
+      BasicBlock* block = block_map[body_bb];
+      layout.push_back(block);
+      for (CompilerOp* op : body_bb->code) {
+        if (op->code == RETURN_VALUE) {
+          block->add_op(JUMP_ABSOLUTE, 0)->exc_handler = exc_handler;
+          block->exits.push_back(finish);
+          break;
+        }
+        if (op->code != YIELD_VALUE) {
+          CompilerOp* copy = copy_op(block, op, &body, map_reg, handler->py_offset);
+          if (op->code == LOAD_CLOSURE || op->code == LOAD_DEREF || op->code == STORE_DEREF) {
+            copy->arg = cells[op->arg];
+          }
+          continue;
+        }
+        const int item = map_reg(op->regs[0]);
+        if (kind == CONSUME_SUM) {
+          block->add_dest_op(BINARY_ADD, 0, acc, item, acc)->exc_handler = exc_handler;
+        } else if (found != NULL) {
+          // Leave at the first item deciding the result.
+          block->add_op(kind == CONSUME_ANY ? POP_JUMP_IF_TRUE : POP_JUMP_IF_FALSE, 0, item)->exc_handler = exc_handler;
+          BasicBlock* rest = new_block(bb);
+          block->exits.push_back(rest);
+          block->exits.push_back(found);
+          block = rest;
+          layout.push_back(rest);
+        } else {
+          block->add_op(LIST_APPEND, 0, acc, item)->exc_handler = exc_handler;
+        }
+      }
+      if (block->exits.empty()) {
+        for (BasicBlock* exit : body_bb->exits) {
+          block->exits.push_back(block_map[exit]);
+        }
+      }
+    }
+
+    if (found != NULL) {
+      PyObject* result = (kind == CONSUME_ANY) ? Py_True : Py_False;
+      found->add_dest_op(STORE_FAST, 0, add_const(result), dst)->exc_handler = exc_handler;
+      found->add_op(JUMP_ABSOLUTE, 0)->exc_handler = exc_handler;
+      found->exits.push_back(cont);
+      layout.push_back(found);
+      done->add_dest_op(STORE_FAST, 0, add_const(result == Py_True ? Py_False : Py_True), dst)->exc_handler = exc_handler;
+    } else if (done != NULL) {
+      done->add_dest_op(CALL_FUNCTION, 1, consumer->regs[0], acc, dst)->exc_handler = exc_handler;
+    }
+    if (done != NULL) {
+      done->exits.push_back(cont);
+      layout.push_back(done);
+    }
+
+    handler->add_op(CATCH_STOP_ITERATION, 0)->exc_handler = exc_handler;
+    handler->add_op(JUMP_ABSOLUTE, 0)->exc_handler = exc_handler;
+    handler->exits.push_back(finish);
+    fn_->exc_handlers[handler->py_offset] = handler;
+
+    // Errors in the expression are reported at the line of the call.
+    layout.push_back(handler);
+    for (BasicBlock* block : layout) {
+      for (CompilerOp* op : block->code) {
+        op->py_offset = call->py_offset;
+      }
+    }
+    layout.back() = cont;
+
+    cont->code.assign(bb->code.begin() + call_idx + 2, bb->code.end());
+    cont->exits = bb->exits;
+
+    std::vector<CompilerOp*> kept;
+    std::vector<CompilerOp*> calls;
+    for (size_t i = 0; i < call_idx; ++i) {
+      (moved.count(i) ? calls : kept).push_back(bb->code[i]);
+    }
+    calls.push_back(call);
+    calls.push_back(consumer);
+    bb->code = kept;
+    bb->exits.clear();
+    bb->exits.push_back(init);
+    if (slow != NULL) {
+      bb->add_op(GUARD_FUNCTION, fn_->inlined_functions.size(), consumer->regs[0])->exc_handler = exc_handler;
+      bb->code.back()->py_offset = call->py_offset;
+      fn_->inlined_functions.push_back(guard);
+      bb->exits.push_back(slow);
+
+      slow->code = calls;
+      slow->add_op(JUMP_ABSOLUTE, 0)->exc_handler = exc_handler;
+      slow->code.back()->py_offset = call->py_offset;
+      slow->exits.push_back(cont);
+      slow_paths_.insert(slow);
+    }
+
+    // The fast path follows bb; the original calls and the handler go last.
+    fn_->bbs.resize(first_new);
+    fn_->bbs.insert(fn_->bbs.begin() + bb_idx + 1, layout.begin(), layout.end());
+    if (slow != NULL) {
+      fn_->bbs.push_back(slow);
+    }
+    fn_->bbs.push_back(handler);
+    return true;
+  }
+
+  // Give the constants of the inlined functions the registers after ours,
+  // moving our locals and temporaries up to make room.
+  void place_consts() {
+    const int num_new = new_consts_.size();
+    if (num_new == 0) {
+      return;
+    }
+    for (PyObject* obj : new_consts_) {
+      fn_->consts_tuple = tuple_append(fn_->consts_tuple, obj);
+    }
+    for (BasicBlock* bb : fn_->bbs) {
+      for (CompilerOp* op : bb->code) {
+        for (int& reg : op->regs) {
+          if (reg < num_consts_) {
+            continue;
+          }
+          auto iter = const_indices_.find(reg);
+          reg = (iter != const_indices_.end()) ? num_consts_ + iter->second : reg + num_new;
+        }
+      }
+    }
+    fn_->num_consts += num_new;
+    fn_->num_reg += num_new;
+  }
+
+public:
+  explicit InlineCalls(bool fuse_generators) : fuse_generators_(fuse_generators), fn_(NULL), num_consts_(0), next_offset_(0) {
+  }
+
+  void visit_fn(CompilerState* fn) {
+    if (fn->globals == NULL) {
+      return;
+    }
+    fn_ = fn;
+    num_consts_ = fn->num_consts;
+    next_offset_ = fn->py_codelen;
+
+    for (size_t i = 0; i < fn->bbs.size() && fn->inlined_functions.size() < kMaxInlinedCalls; ++i) {
+      BasicBlock* bb = fn->bbs[i];
+      if (bb->dead || slow_paths_.count(bb)) {
+        continue;
+      }
+      // After inlining, the rest of bb is the block after the inlined
+      // body, which is visited in turn.
+      for (size_t j = 0; j < bb->code.size(); ++j) {
+        CompilerOp* op = bb->code[j];
+        if (op->dead || op->code != CALL_FUNCTION || (op->arg >> 8) != 0) {
+          continue;
+        }
+        if (fuse_generators_ && fuse_generator(i, j)) {
+          break;
+        }
+        PyObject* callee = find_callee(bb, j);
+        if (callee == NULL) {
+          continue;
+        }
+        CompilerState body((PyCodeObject*) PyFunction_GET_CODE(callee));
+        if (!load_body(callee, op->arg & 0xff, &body)) {
+          continue;
+        }
+        COMPILE_LOG("Inlining %s", PyEval_GetFuncName(callee));
+        inline_call(i, j, callee, &body);
+        break;
+      }
+    }
+
+    // Nothing was inlined or fused.
+    if (next_offset_ == fn->py_codelen) {
+      return;
+    }
+    place_consts();
+    for (size_t i = 0; i < fn->bbs.size(); ++i) {
+      fn->bbs[i]->idx = i;
+    }
+    mark_entries(fn);
+  }
+};
+
 class CopyPropagation: public CompilerPass {
 public:
   void visit_bb(BasicBlock* bb) {
@@ -489,6 +1353,14 @@ public:
 
         CompilerOp* op = bb->code[op_idx];
 
+        // The exception registers are written without being a destination.
+        if (op->code == LOAD_EXCEPTION) {
+          for (int reg : op->regs) {
+            this->update_type(reg, OBJ);
+          }
+          continue;
+        }
+
         size_t n_inputs = op->num_inputs();
         if (op->has_dest) {
           int dest = op->regs[n_inputs];
@@ -708,11 +1580,228 @@ public:
   }
 };
 
+// Fuse a COMPARE_OP whose result is only used by the conditional jump that
+// ends its basic block into a single COMPARE_AND_BRANCH instruction, so the
+// result of the comparison is never boxed.
+class FuseCompareAndBranch: public CompilerPass, UseCounts {
+private:
+  int num_frozen;
+
+public:
+  void visit_bb(BasicBlock* bb) {
+    size_t n_ops = bb->code.size();
+    if (n_ops < 2) {
+      return;
+    }
+
+    CompilerOp* cmp = bb->code[n_ops - 2];
+    CompilerOp* branch = bb->code[n_ops - 1];
+    if (cmp->dead || cmp->code != COMPARE_OP ||
+        (branch->code != POP_JUMP_IF_FALSE && branch->code != POP_JUMP_IF_TRUE)) {
+      return;
+    }
+
+    // Locals must still be written, as they may be read via locals().
+    int result = cmp->dest();
+    if (branch->regs[0] != result || result < num_frozen || this->get_count(result) != 1) {
+      return;
+    }
+
+    branch->code = (branch->code == POP_JUMP_IF_FALSE) ? COMPARE_AND_BRANCH_IF_FALSE : COMPARE_AND_BRANCH_IF_TRUE;
+    branch->arg = cmp->arg;
+    branch->regs.clear();
+    branch->regs.push_back(cmp->regs[0]);
+    branch->regs.push_back(cmp->regs[1]);
+    cmp->dead = true;
+  }
+
+  void visit_fn(CompilerState* fn) {
+    num_frozen = fn->num_consts + fn->num_locals;
+    this->count_uses(fn);
+    CompilerPass::visit_fn(fn);
+  }
+};
+
+// Switch integer operations whose right operand is a small int constant to
+// their immediate forms.  The constant register stays in the operation for
+// the non-integer path.
+class ImmediateOperands: public CompilerPass {
+private:
+  PyObject* consts_tuple;
+  int num_consts;
+
+  static int immediate_form(int opcode) {
+    switch (opcode) {
+    case BINARY_ADD: return BINARY_ADD_IMM;
+    case BINARY_SUBTRACT: return BINARY_SUBTRACT_IMM;
+    case BINARY_LSHIFT: return BINARY_LSHIFT_IMM;
+    case BINARY_RSHIFT: return BINARY_RSHIFT_IMM;
+    case BINARY_AND: return BINARY_AND_IMM;
+    case BINARY_OR: return BINARY_OR_IMM;
+    case BINARY_XOR: return BINARY_XOR_IMM;
+    case INPLACE_ADD: return INPLACE_ADD_IMM;
+    case INPLACE_SUBTRACT: return INPLACE_SUBTRACT_IMM;
+    case COMPARE_OP: return COMPARE_OP_IMM;
+    case COMPARE_AND_BRANCH_IF_FALSE: return COMPARE_AND_BRANCH_IF_FALSE_IMM;
+    case COMPARE_AND_BRANCH_IF_TRUE: return COMPARE_AND_BRANCH_IF_TRUE_IMM;
+    default: return -1;
+    }
+  }
+
+public:
+  void visit_op(CompilerOp* op) {
+    int imm_code = immediate_form(op->code);
+    if (imm_code == -1) {
+      return;
+    }
+
+    int reg = op->regs[1];
+    if (reg < 0 || reg >= num_consts) {
+      return;
+    }
+
+    PyObject* obj = PyTuple_GET_ITEM(consts_tuple, reg);
+    if (!PyInt_CheckExact(obj)) {
+      return;
+    }
+
+    long value = PyInt_AS_LONG(obj);
+    if (value < INT32_MIN || value > INT32_MAX) {
+      return;
+    }
+
+    // Out of range shifts are left to the generic path.
+    if ((op->code == BINARY_LSHIFT || op->code == BINARY_RSHIFT) &&
+        (value < 0 || value >= (long) (8 * sizeof(long)))) {
+      return;
+    }
+
+    op->code = imm_code;
+    op->imm = (int) value;
+  }
+
+  void visit_fn(CompilerState* fn) {
+    consts_tuple = fn->consts_tuple;
+    num_consts = fn->num_consts;
+    CompilerPass::visit_fn(fn);
+  }
+};
+
+// Fuse a LOAD_ATTR whose result is only used as the callable of a later
+// CALL_FUNCTION in the same basic block into LOAD_METHOD/CALL_METHOD, so
+// calling a method defined in Python doesn't allocate a bound method.
+// CALL_METHOD reads the object again, so it must not be reassigned in
+// between.
+class FuseMethodCalls: public CompilerPass, UseCounts {
+private:
+  int num_frozen;
+
+public:
+  void visit_bb(BasicBlock* bb) {
+    size_t n_ops = bb->code.size();
+    for (size_t i = 0; i < n_ops; ++i) {
+      CompilerOp* load = bb->code[i];
+      if (load->dead || load->code != LOAD_ATTR) {
+        continue;
+      }
+
+      int obj = load->regs[0];
+      int method = load->dest();
+      if (method < num_frozen || this->get_count(method) != 1) {
+        continue;
+      }
+
+      for (size_t j = i + 1; j < n_ops; ++j) {
+        CompilerOp* op = bb->code[j];
+        if (op->dead) {
+          continue;
+        }
+        if (op->code == CALL_FUNCTION && op->regs[0] == method) {
+          // The register count of a varargs operation must fit in a byte.
+          if (op->regs.size() >= UINT8_MAX) {
+            break;
+          }
+          load->code = LOAD_METHOD;
+          op->code = CALL_METHOD;
+          op->regs.insert(op->regs.begin() + 1, obj);
+          break;
+        }
+        if (op->has_dest && (op->dest() == obj || op->dest() == method)) {
+          break;
+        }
+      }
+    }
+  }
+
+  void visit_fn(CompilerState* fn) {
+    num_frozen = fn->num_consts + fn->num_locals;
+    this->count_uses(fn);
+    CompilerPass::visit_fn(fn);
+  }
+};
+
+// Rewrite common opcode sequences within a basic block into
+// superinstructions (see superinstructions.h).  Only the first operation of
+// a sequence changes: the rest keep their encoding and are executed in line
+// by the fused handler, so operation layout and jump targets are unaffected.
+class FormSuperinstructions: public CompilerPass {
+private:
+  std::map<std::vector<int>, int> sequences_;
+
+  int find(const std::vector<CompilerOp*>& code, size_t start, size_t len) {
+    if (start + len > code.size()) {
+      return -1;
+    }
+    std::vector<int> seq;
+    for (size_t i = start; i < start + len; ++i) {
+      seq.push_back(code[i]->code);
+    }
+    auto iter = sequences_.find(seq);
+    return iter == sequences_.end() ? -1 : iter->second;
+  }
+
+public:
+  FormSuperinstructions() {
+#define ADD_SEQUENCE2(super, a, b) sequences_[{ a, b }] = super;
+#define ADD_SEQUENCE3(super, a, b, c) sequences_[{ a, b, c }] = super;
+    SUPERINSTRUCTIONS(ADD_SEQUENCE2, ADD_SEQUENCE3)
+#undef ADD_SEQUENCE2
+#undef ADD_SEQUENCE3
+  }
+
+  void visit_bb(BasicBlock* bb) {
+    std::vector<CompilerOp*> code;
+    for (CompilerOp* op : bb->code) {
+      if (!op->dead) {
+        code.push_back(op);
+      }
+    }
+
+    size_t i = 0;
+    while (i < code.size()) {
+      // Prefer the longest match.
+      size_t len = 3;
+      int super = find(code, i, len);
+      if (super == -1) {
+        len = 2;
+        super = find(code, i, len);
+      }
+      if (super == -1) {
+        ++i;
+        continue;
+      }
+      code[i]->code = super;
+      i += len;
+    }
+  }
+};
+
 void optimize(CompilerState* fn) {
   MarkEntries()(fn);
   FuseBasicBlocks()(fn);
 
   if (!getenv("DISABLE_OPT")) {
+    if (!getenv("DISABLE_INLINE")) InlineCalls(!getenv("DISABLE_FUSE_GENERATORS"))(fn);
     if (!getenv("DISABLE_COPY")) CopyPropagation()(fn);
     if (!getenv("DISABLE_STORE")) StoreElim()(fn);
   }
@@ -721,6 +1810,9 @@ void optimize(CompilerState* fn) {
 
   if (!getenv("DISABLE_OPT")) {
     if (!getenv("DISABLE_SPECIALIZATION")) LocalTypeSpecialization()(fn);
+    if (!getenv("DISABLE_COMPARE_BRANCH")) FuseCompareAndBranch()(fn);
+    if (!getenv("DISABLE_IMMEDIATES")) ImmediateOperands()(fn);
+    if (!getenv("DISABLE_METHOD_CALLS")) FuseMethodCalls()(fn);
   }
 
   DeadCodeElim()(fn);
@@ -729,6 +1821,10 @@ void optimize(CompilerState* fn) {
   }
 
   RenameRegisters()(fn);
+
+#if USE_SUPERINSTRUCTIONS && !PROFILE_OP_SEQUENCES
+  if (!getenv("DISABLE_SUPERINSTRUCTIONS")) FormSuperinstructions()(fn);
+#endif
   COMPILE_LOG(fn->str().c_str());
 }
 
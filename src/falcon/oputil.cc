@@ -132,7 +132,52 @@ const char* OpUtil::name(int opcode) {
     case DICT_CONTAINS : return "DICT_CONTAINS";
     case DICT_GET : return "DICT_GET";
     case DICT_GET_DEFAULT : return "DICT_GET_DEFAULT";
+    case COMPARE_AND_BRANCH_IF_FALSE : return "COMPARE_AND_BRANCH_IF_FALSE";
+    case COMPARE_AND_BRANCH_IF_TRUE : return "COMPARE_AND_BRANCH_IF_TRUE";
+    case BINARY_ADD_IMM : return "BINARY_ADD_IMM";
+    case BINARY_SUBTRACT_IMM : return "BINARY_SUBTRACT_IMM";
+    case BINARY_LSHIFT_IMM : return "BINARY_LSHIFT_IMM";
+    case BINARY_RSHIFT_IMM : return "BINARY_RSHIFT_IMM";
+    case BINARY_AND_IMM : return "BINARY_AND_IMM";
+    case BINARY_OR_IMM : return "BINARY_OR_IMM";
+    case BINARY_XOR_IMM : return "BINARY_XOR_IMM";
+    case INPLACE_ADD_IMM : return "INPLACE_ADD_IMM";
+    case INPLACE_SUBTRACT_IMM : return "INPLACE_SUBTRACT_IMM";
+    case COMPARE_OP_IMM : return "COMPARE_OP_IMM";
+    case COMPARE_AND_BRANCH_IF_FALSE_IMM : return "COMPARE_AND_BRANCH_IF_FALSE_IMM";
+    case COMPARE_AND_BRANCH_IF_TRUE_IMM : return "COMPARE_AND_BRANCH_IF_TRUE_IMM";
+    case BINARY_ADD_FLOAT : return "BINARY_ADD_FLOAT";
+    case BINARY_SUBTRACT_FLOAT : return "BINARY_SUBTRACT_FLOAT";
+    case BINARY_MULTIPLY_FLOAT : return "BINARY_MULTIPLY_FLOAT";
+    case INPLACE_ADD_FLOAT : return "INPLACE_ADD_FLOAT";
+    case INPLACE_SUBTRACT_FLOAT : return "INPLACE_SUBTRACT_FLOAT";
+    case INPLACE_MULTIPLY_FLOAT : return "INPLACE_MULTIPLY_FLOAT";
+    case COMPARE_OP_FLOAT : return "COMPARE_OP_FLOAT";
+    case LOAD_ATTR_MODULE : return "LOAD_ATTR_MODULE";
+    case LOAD_METHOD : return "LOAD_METHOD";
+    case CALL_METHOD : return "CALL_METHOD";
+    case LOAD_EXCEPTION : return "LOAD_EXCEPTION";
+    case GUARD_FUNCTION : return "GUARD_FUNCTION";
+    case CATCH_STOP_ITERATION : return "CATCH_STOP_ITERATION";
+
+#define SUPER_NAME2(super, a, b) case super: return #super;
+#define SUPER_NAME3(super, a, b, c) case super: return #super;
+    SUPERINSTRUCTIONS(SUPER_NAME2, SUPER_NAME3)
+#undef SUPER_NAME2
+#undef SUPER_NAME3
   }
 
   return "BAD_OP";
 }
+
+int OpUtil::base_opcode(int opcode) {
+  switch (opcode) {
+#define SUPER_BASE2(super, a, b) case super: return a;
+#define SUPER_BASE3(super, a, b, c) case super: return a;
+    SUPERINSTRUCTIONS(SUPER_BASE2, SUPER_BASE3)
+#undef SUPER_BASE2
+#undef SUPER_BASE3
+  }
+
+  return opcode;
+}
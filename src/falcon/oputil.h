@@ -20,24 +20,91 @@
 #define DICT_CONTAINS 155
 #define DICT_GET 156
 #define DICT_GET_DEFAULT 157
+#define COMPARE_AND_BRANCH_IF_FALSE 158
+#define COMPARE_AND_BRANCH_IF_TRUE 159
+
+// Forms of the above taking a small integer constant as an immediate.
+#define BINARY_ADD_IMM 160
+#define BINARY_SUBTRACT_IMM 161
+#define BINARY_LSHIFT_IMM 162
+#define BINARY_RSHIFT_IMM 163
+#define BINARY_AND_IMM 164
+#define BINARY_OR_IMM 165
+#define BINARY_XOR_IMM 166
+#define INPLACE_ADD_IMM 167
+#define INPLACE_SUBTRACT_IMM 168
+#define COMPARE_OP_IMM 169
+#define COMPARE_AND_BRANCH_IF_FALSE_IMM 170
+#define COMPARE_AND_BRANCH_IF_TRUE_IMM 171
+
+// Type-specialized forms which generic operations rewrite themselves to at
+// runtime (see RegisterCode::quicken).  These are never emitted by the
+// compiler.
+#define BINARY_ADD_FLOAT 172
+#define BINARY_SUBTRACT_FLOAT 173
+#define BINARY_MULTIPLY_FLOAT 174
+#define INPLACE_ADD_FLOAT 175
+#define INPLACE_SUBTRACT_FLOAT 176
+#define INPLACE_MULTIPLY_FLOAT 177
+#define COMPARE_OP_FLOAT 178
+#define LOAD_ATTR_MODULE 179
+
+// A method lookup and the call consuming it (see FuseMethodCalls).
+#define LOAD_METHOD 180
+#define CALL_METHOD 181
+
+// The first operation of an except clause (see RegisterCode::find_handler).
+#define LOAD_EXCEPTION 182
+
+// Falls through into the body of a function inlined at a call site if the
+// callable is still that function, or jumps to the real call (see
+// InlineCalls).
+#define GUARD_FUNCTION 183
+
+// Begins the except clause around a generator expression run as a loop in
+// the frame of its consumer: ends the loop if the body raised
+// StopIteration, and raises anything else again (see InlineCalls).
+#define CATCH_STOP_ITERATION 184
+
+// The remaining opcodes are generated superinstructions.
+#define FIRST_SUPERINSTRUCTION 185
+#include "superinstructions.h"
+
+#if FIRST_SUPERINSTRUCTION + NUM_SUPERINSTRUCTIONS > 256
+#error "Too many superinstructions: opcodes must fit in a byte."
+#endif
 
 struct OpUtil {
   static const char* name(int opcode);
 
+  // Superinstructions share the encoding of their first operation; all
+  // layout queries below are answered for that operation.
+  static int base_opcode(int opcode);
+
   static bool has_hint(int opcode) {
-    if (opcode == LOAD_ATTR) {
+    opcode = base_opcode(opcode);
+    if (opcode == LOAD_ATTR || opcode == LOAD_ATTR_MODULE || opcode == STORE_ATTR ||
+        opcode == LOAD_GLOBAL || opcode == LOAD_METHOD) {
       return true;
     }
     return false;
   }
 
+  // Operations encoded as ImmRegOp or ImmBranchOp.
+  static bool has_immediate(int opcode) {
+    opcode = base_opcode(opcode);
+    return opcode >= BINARY_ADD_IMM && opcode <= COMPARE_AND_BRANCH_IF_TRUE_IMM;
+  }
+
   static bool is_varargs(int opcode) {
+    opcode = base_opcode(opcode);
     static std::set<int> r;
     if (r.empty()) {
       r.insert(CALL_FUNCTION);
       r.insert(CALL_FUNCTION_KW);
       r.insert(CALL_FUNCTION_VAR);
       r.insert(CALL_FUNCTION_VAR_KW);
+      r.insert(CALL_METHOD);
       r.insert(BUILD_LIST);
       r.insert(BUILD_TUPLE);
 //      r.insert(BUILD_MAP);
@@ -50,6 +117,7 @@ struct OpUtil {
   }
 
   static bool is_branch(int opcode) {
+    opcode = base_opcode(opcode);
     static std::set<int> r;
     if (r.empty()) {
       r.insert(FOR_ITER);
@@ -61,23 +129,27 @@ struct OpUtil {
       r.insert(JUMP_FORWARD);
       r.insert(BREAK_LOOP);
       r.insert(CONTINUE_LOOP);
-
-      // Not technically, but we need to patch up offsets they use
-      // for catching exceptions.  Sort of a `delayed branch`.
-      r.insert(SETUP_EXCEPT);
-      r.insert(SETUP_FINALLY);
+      r.insert(COMPARE_AND_BRANCH_IF_FALSE);
+      r.insert(COMPARE_AND_BRANCH_IF_TRUE);
+      r.insert(COMPARE_AND_BRANCH_IF_FALSE_IMM);
+      r.insert(COMPARE_AND_BRANCH_IF_TRUE_IMM);
+      r.insert(GUARD_FUNCTION);
     }
 
     return r.find(opcode) != r.end();
   }
 
   static bool has_arg(int opcode) {
+    opcode = base_opcode(opcode);
     static std::set<int> r;
     if (r.empty()) {
       r.insert(COMPARE_OP);
+      r.insert(COMPARE_OP_FLOAT);
       r.insert(LOAD_GLOBAL);
       r.insert(LOAD_NAME);
       r.insert(LOAD_ATTR);
+      r.insert(LOAD_ATTR_MODULE);
+      r.insert(LOAD_METHOD);
       r.insert(LOAD_CLOSURE);
       r.insert(LOAD_DEREF);
       r.insert(STORE_GLOBAL);
@@ -92,7 +164,9 @@ struct OpUtil {
       r.insert(CALL_FUNCTION_KW);
       r.insert(CALL_FUNCTION_VAR);
       r.insert(CALL_FUNCTION_VAR_KW);
+      r.insert(CALL_METHOD);
       r.insert(MAKE_FUNCTION);
+      r.insert(MAKE_CLOSURE);
       r.insert(BUILD_LIST);
       r.insert(BUILD_TUPLE);
       r.insert(BUILD_MAP);
@@ -100,6 +174,12 @@ struct OpUtil {
       r.insert(IMPORT_NAME);
       r.insert(IMPORT_FROM);
       r.insert(CONTINUE_LOOP);
+      r.insert(COMPARE_AND_BRANCH_IF_FALSE);
+      r.insert(COMPARE_AND_BRANCH_IF_TRUE);
+      r.insert(COMPARE_OP_IMM);
+      r.insert(COMPARE_AND_BRANCH_IF_FALSE_IMM);
+      r.insert(COMPARE_AND_BRANCH_IF_TRUE_IMM);
+      r.insert(GUARD_FUNCTION);
     }
 
     return r.find(opcode) != r.end();
@@ -35,7 +35,9 @@ using namespace std;
 
 struct RCompilerUtil {
   static int op_size(CompilerOp* op) {
-    if (OpUtil::is_varargs(op->code)) {
+    if (OpUtil::has_immediate(op->code)) {
+      return OpUtil::is_branch(op->code) ? sizeof(ImmBranchOp) : sizeof(ImmRegOp);
+    } else if (OpUtil::is_varargs(op->code)) {
       return sizeof(VarRegOp) + sizeof(RegisterOffset) * op->regs.size();
     } else if (OpUtil::is_branch(op->code)) {
       int n_regs = op->regs.size();
@@ -67,10 +69,27 @@ struct RCompilerUtil {
     header->code = src->code;
     header->arg = src->arg;
 
-    if (OpUtil::is_varargs(src->code)) {
+    if (OpUtil::has_immediate(src->code)) {
+      if (OpUtil::is_branch(src->code)) {
+        ImmBranchOp* op = (ImmBranchOp*) dst;
+        Reg_AssertEq(src->regs.size(), (size_t)2);
+        op->reg[0] = src->regs[0];
+        op->reg[1] = src->regs[1];
+        op->imm = src->imm;
+        op->label = 0;
+      } else {
+        ImmRegOp* op = (ImmRegOp*) dst;
+        Reg_AssertEq(src->regs.size(), (size_t)3);
+        op->reg[0] = src->regs[0];
+        op->reg[1] = src->regs[1];
+        op->reg[2] = src->regs[2];
+        op->imm = src->imm;
+      }
+    } else if (OpUtil::is_varargs(src->code)) {
       VarRegOp* op = (VarRegOp*) dst;
 	  assert(src->regs.size() <= UINT8_MAX);
       op->num_registers = (uint8_t)src->regs.size();
+      op->hint_pos = kInvalidHint;
       for (size_t i = 0; i < src->regs.size(); ++i) {
         op->reg[i] = src->regs[i];
 
@@ -345,6 +364,14 @@ BasicBlock* Compiler::registerize(CompilerState* state, RegisterStack *stack, in
       bb->add_dest_op(opcode, oparg, r1, r2);
       break;
     }
+    case YIELD_VALUE: {
+      // Pops the value yielded, and pushes the one sent when the
+      // generator resumes.
+      int r1 = stack->pop_register();
+      int r2 = stack->push_register(state->num_reg++);
+      bb->add_dest_op(opcode, oparg, r1, r2);
+      break;
+    }
     case SLICE + 0:
     case SLICE + 1:
     case SLICE + 2:
@@ -555,7 +582,7 @@ BasicBlock* Compiler::registerize(CompilerState* state, RegisterStack *stack, in
       op->regs[0] = code;
       op->regs[1] = closure_values;
       for (int i = 0; i < oparg; ++i) {
-        op->regs[i + 2] = stack->pop_register();
+        op->regs[oparg + 1 - i] = stack->pop_register();
       }
       op->regs[oparg + 2] = stack->push_register(state->num_reg++);
       break;
@@ -615,7 +642,6 @@ BasicBlock* Compiler::registerize(CompilerState* state, RegisterStack *stack, in
       break;
     }
     case RAISE_VARARGS: {
-      int target = -1;
       int exc, value, tb;
       exc = value = tb = -1;
       if (oparg == 3) {
@@ -629,41 +655,27 @@ BasicBlock* Compiler::registerize(CompilerState* state, RegisterStack *stack, in
         exc = stack->pop_register();
       }
 
+      // Any local handler is found through the exception table.
       bb->add_op(opcode, 0, exc, value, tb);
-
-      if (stack->num_exc_handlers() > 0) {
-        // The raw exception data is pushed onto the stack,
-        // by ceval, prior to the exception handler being invoked.
-        //
-        // yaarrgh.
-
-        Frame f = stack->pop_exc_handler();
-        target = f.target;
-
-        COMPILE_LOG("Found local exception handler @%d", target);
-
-        // There is no guarantee that the exception handler will be
-        // called from our current state; just use fresh registers
-        // to disable optimizations.
-        RegisterStack to_handler(*stack);
-        to_handler.push_register(state->num_reg++);
-        to_handler.push_register(state->num_reg++);
-        to_handler.push_register(state->num_reg++);
-
-        bb->exits.push_back(registerize(state, &to_handler, target));
-      }
       return entry_point;
     }
       // Control flow instructions - recurse down each branch with a copy of the current stack.
     case BREAK_LOOP: {
+      // Leave any try blocks on the way out of the loop.
       Frame f = stack->pop_frame();
+      while (f.is_exc_handler) {
+        f = stack->pop_frame();
+      }
       bb->add_op(opcode, 0);
       bb->exits.push_back(registerize(state, stack, f.target));
       return entry_point;
     }
     case CONTINUE_LOOP: {
-      stack->pop_frame();
-      bb->add_op(opcode, oparg);
+      // Only ever found in a try block, which the jump leaves.
+      while (!stack->frames.empty() && stack->frames.back().is_exc_handler) {
+        stack->pop_frame();
+      }
+      bb->add_op(JUMP_ABSOLUTE, oparg);
       bb->exits.push_back(registerize(state, stack, oparg));
       return entry_point;
     }
@@ -728,46 +740,50 @@ BasicBlock* Compiler::registerize(CompilerState* state, RegisterStack *stack, in
       return entry_point;
     }
 
-// TODO: Make sure this actually works!
 #if ENABLE_EXCEPTIONS
-      case SETUP_EXCEPT:
-      case SETUP_FINALLY: {
-        int target = offset + CODESIZE(opcode) + oparg;
-        stack->push_frame(target, true);
-
-        bb->add_op(opcode, 0);
-        RegisterStack a(*stack);
-        RegisterStack b(*stack);
-
-        // And add a jump directly to the handler (this will never be taken,
-        // but instead is used to setup the handler stack at runtime.)
-        COMPILE_LOG("Jumping to %d...", target);
-        a.push_register(state->num_reg++);
-        a.push_register(state->num_reg++);
-        a.push_register(state->num_reg++);
-        BasicBlock* handler = registerize(state, &a, target);
-        bb->exits.push_back(handler);
-
-
-        // Fall through
-        COMPILE_LOG("Fall through...");
-        BasicBlock* next = registerize(state, &b, offset + CODESIZE(opcode));
-        bb->exits.push_back(next);
-
-        return entry_point;
+    case SETUP_EXCEPT: {
+      // No code is emitted for entering the try block: the operations
+      // inside it record the except clause, which is entered through
+      // the exception table.  As in ceval, the clause starts with the
+      // stack of the try statement and the exception on top of it.
+      int target = offset + CODESIZE(opcode) + oparg;
+      RegisterStack handler_stack(*stack);
+      stack->push_frame(target, true);
+      BasicBlock* body = registerize(state, stack, offset + CODESIZE(opcode));
+
+      int tb = handler_stack.push_register(state->num_reg++);
+      int value = handler_stack.push_register(state->num_reg++);
+      int type = handler_stack.push_register(state->num_reg++);
+      BasicBlock* handler = state->alloc_bb(-target, &handler_stack);
+      handler->add_op(LOAD_EXCEPTION, 0, type, value, tb);
+      state->exc_handlers[target] = handler;
+
+      COMPILE_LOG("Exception handler @%d", target);
+      BasicBlock* clause = registerize(state, &handler_stack, target);
+      if (clause->idx != handler->idx + 1) {
+        handler->add_op(JUMP_ABSOLUTE, 0);
       }
+      handler->exits.push_back(clause);
 
-      case END_FINALLY: {
-        bb->add_op(opcode, 0);
-        break;
-      }
+      bb->exits.push_back(body);
+      bb->exits.push_back(handler);
+      return entry_point;
+    }
+    case END_FINALLY: {
+      // Only reached when no except clause matched: re-raise.
+      int type = stack->pop_register();
+      int value = stack->pop_register();
+      int tb = stack->pop_register();
+      bb->add_op(opcode, 0, type, value, tb);
+      return entry_point;
+    }
 #else
     case SETUP_EXCEPT:
-    case SETUP_FINALLY:
     case END_FINALLY:
 #endif
+    case SETUP_FINALLY:
+    case SETUP_WITH:
 
-    case YIELD_VALUE:
     default:
       throw RException(PyExc_SyntaxError, "Unsupported opcode %s, arg = %d", OpUtil::name(opcode), oparg);
       break;
@@ -776,7 +792,30 @@ BasicBlock* Compiler::registerize(CompilerState* state, RegisterStack *stack, in
   return entry_point;
 }
 
-void lower_register_code(CompilerState* state, std::string *out) {
+// Whether a CALL_FUNCTION or CALL_METHOD passes keyword arguments whose
+// names are all constants, and few enough of them to cache.
+static bool has_constant_keywords(CompilerState* state, CompilerOp* call) {
+  int na = call->arg & 0xff;
+  int nk = (call->arg >> 8) & 0xff;
+  if (nk == 0 || nk > kMaxCachedKeywords) {
+    return false;
+  }
+  // The keywords follow the callable, the method's object, and the
+  // positional arguments.
+  int first = (OpUtil::base_opcode(call->code) == CALL_METHOD ? 2 : 1) + na;
+  for (int i = 0; i < nk; ++i) {
+    if (call->regs[first + 2 * i] >= state->num_consts) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void lower_register_code(CompilerState* state, RegisterCode* code) {
+  std::string* out = &code->instructions;
+  // The except clause of each operation, by position in op_offsets.
+  std::vector<int> exc_handlers;
+  int py_offset = -1;
 
 // first, dump all of the operations to the output buffer and record
 // their positions.
@@ -791,10 +830,65 @@ void lower_register_code(CompilerState* state, std::string *out) {
       size_t offset = out->size();
       out->resize(out->size() + RCompilerUtil::op_size(c));
       RCompilerUtil::lower_op(&(*out)[0] + offset, c);
+#if GETATTR_HINTS
+      if (OpUtil::has_hint(c->code)) {
+        RegOp<0>* op = (RegOp<0>*) (out->data() + offset);
+        if (OpUtil::base_opcode(c->code) == LOAD_GLOBAL) {
+          if (code->global_caches.size() < kMaxHints) {
+            op->hint_pos = code->global_caches.size();
+            code->global_caches.push_back(GlobalCache());
+          }
+        } else if (code->attr_caches.size() < kMaxHints) {
+          op->hint_pos = code->attr_caches.size();
+          code->attr_caches.push_back(AttrCache());
+        }
+      }
+#endif
+      if ((OpUtil::base_opcode(c->code) == CALL_FUNCTION || OpUtil::base_opcode(c->code) == CALL_METHOD) &&
+          code->call_caches.size() < kMaxHints) {
+        VarRegOp* op = (VarRegOp*) (out->data() + offset);
+        op->hint_pos = code->call_caches.size();
+        CallCache cache = CallCache();
+        cache.constant_keywords = has_constant_keywords(state, c);
+        code->call_caches.push_back(cache);
+      }
+      code->op_offsets.push_back(offset);
+      exc_handlers.push_back(c->exc_handler);
+      if (c->py_offset != py_offset) {
+        py_offset = c->py_offset;
+        int line = PyCode_Addr2Line(state->py_code, py_offset);
+        if (code->line_table.empty() || code->line_table.back().line != line) {
+          code->line_table.push_back({ (JumpLoc) offset, py_offset, line });
+        }
+      }
+      Reg_AssertEq(code->op_offsets.back(), offset);
       Log_Debug("Wrote op at offset %d, size: %d, %s", offset, RCompilerUtil::op_size(c), c->str().c_str());
     }
   }
 
+  code->opcodes.assign(out->size(), 0);
+  for (size_t i = 0; i < code->op_offsets.size(); ++i) {
+    JumpLoc offset = code->op_offsets[i];
+    code->opcodes[offset] = (char) ((OpHeader*) (out->data() + offset))->code;
+  }
+  code->deopts.assign(out->size(), 0);
+
+// build the exception table from runs of operations sharing a handler.
+  for (size_t i = 0; i < exc_handlers.size(); ++i) {
+    if (exc_handlers[i] == -1) {
+      continue;
+    }
+    JumpLoc end = (i + 1 < code->op_offsets.size()) ? code->op_offsets[i + 1] : out->size();
+    JumpLoc handler = state->exc_handlers[exc_handlers[i]]->reg_offset;
+    if (!code->exception_handlers.empty() &&
+        code->exception_handlers.back().end == code->op_offsets[i] &&
+        code->exception_handlers.back().handler == handler) {
+      code->exception_handlers.back().end = end;
+    } else {
+      code->exception_handlers.push_back({ code->op_offsets[i], end, handler });
+    }
+  }
+
 // now patchup labels in the emitted code to point to the correct
 // locations.
   int pos = 0;
@@ -811,7 +905,7 @@ void lower_register_code(CompilerState* state, std::string *out) {
       op = (OpHeader*) (out->data() + pos);
       Log_Debug("Checking op %s at offset %d.", OpUtil::name(op->code), pos);
 
-      Reg_AssertEq(op->code, bb->code[j]->code);
+      Reg_AssertEq((int) op->code, bb->code[j]->code);
       if (OpUtil::has_arg(op->code)) {
         Reg_Assert(op->arg == bb->code[j]->arg, "Malformed bytecode arg %d for %s",
                    bb->code[j]->arg, OpUtil::name(op->code));
@@ -824,6 +918,7 @@ void lower_register_code(CompilerState* state, std::string *out) {
 
     Reg_Assert(op->code == RETURN_VALUE ||
                op->code == RAISE_VARARGS ||
+               op->code == END_FINALLY ||
                OpUtil::is_branch(op->code) ||
                (bb->exits[0] == state->bbs[i + 1]),
                "Non-local jump from non-branch op %s", OpUtil::name(op->code));
@@ -832,7 +927,7 @@ void lower_register_code(CompilerState* state, std::string *out) {
       if (bb->exits.size() == 1) {
         BasicBlock& jmp = *bb->exits[0];
         ((BranchOp<0>*) op)->label = jmp.reg_offset;
-        Reg_AssertGt(jmp.reg_offset, 0);
+        Reg_AssertGe(jmp.reg_offset, 0);
         Reg_AssertEq(((BranchOp<0>*)op)->label, jmp.reg_offset);
       } else {
         // One exit is the fall-through to the next block.
@@ -843,7 +938,7 @@ void lower_register_code(CompilerState* state, std::string *out) {
                    a.idx, b.idx, fallthrough.idx);
         BasicBlock& jmp = (a.idx == fallthrough.idx) ? b : a;
 //        Log_Info("%d, %d", a.idx, b.idx);
-        Reg_AssertGt(jmp.reg_offset, 0);
+        Reg_AssertGe(jmp.reg_offset, 0);
         ((BranchOp<0>*) op)->label = jmp.reg_offset;
         Reg_AssertEq(((BranchOp<0>*)op)->label, jmp.reg_offset);
       }
@@ -869,7 +964,18 @@ RegisterCode* Compiler::compile_(PyObject* func) {
 
   COMPILE_LOG("Compiling... %s", PyEval_GetFuncName(func));
 
+#if STACK_ALLOC_REGISTERS
+  // Frames keep their cells in a fixed-size array.
+  const Py_ssize_t num_cells = PyTuple_GET_SIZE(code->co_freevars) + PyTuple_GET_SIZE(code->co_cellvars);
+  if (num_cells > kMaxCells) {
+    throw RException(PyExc_SystemError, "Too many cell variables (%d)", (int) num_cells);
+  }
+#endif
+
   CompilerState state(code);
+  if (PyFunction_Check(func)) {
+    state.globals = PyFunction_GET_GLOBALS(func);
+  }
   RegisterStack stack;
 
   BasicBlock* entry_point = registerize(&state, &stack, 0);
@@ -880,7 +986,7 @@ RegisterCode* Compiler::compile_(PyObject* func) {
   optimize(&state);
   RegisterCode *regcode = new RegisterCode;
 
-  lower_register_code(&state, &regcode->instructions);
+  lower_register_code(&state, regcode);
 
   regcode->code_ = (PyObject*) code;
   regcode->version = 1;
@@ -890,13 +996,51 @@ RegisterCode* Compiler::compile_(PyObject* func) {
     regcode->function = NULL;
   }
   regcode->mapped_registers = 0;
+  regcode->generator = (code->co_flags & CO_GENERATOR) != 0;
   regcode->mapped_labels = 0;
+  regcode->labels = NULL;
   regcode->num_registers = state.num_reg;
 
   regcode->num_freevars = PyTuple_GET_SIZE(code->co_freevars);
   regcode->num_cellvars = PyTuple_GET_SIZE(code->co_cellvars);
   regcode->num_cells = regcode->num_freevars + regcode->num_cellvars;
 
+  regcode->num_args = code->co_argcount;
+  regcode->num_arg_registers = code->co_argcount +
+      ((code->co_flags & CO_VARARGS) ? 1 : 0) + ((code->co_flags & CO_VARKEYWORDS) ? 1 : 0);
+  regcode->cell_args.assign(regcode->num_cellvars, -1);
+  for (int i = 0; i < regcode->num_cellvars; ++i) {
+    const char* cellname = PyString_AS_STRING(PyTuple_GET_ITEM(code->co_cellvars, i));
+    for (int arg = 0; arg < regcode->num_arg_registers; ++arg) {
+      if (strcmp(cellname, PyString_AS_STRING(PyTuple_GET_ITEM(code->co_varnames, arg))) == 0) {
+        regcode->cell_args[i] = arg;
+        break;
+      }
+    }
+  }
+
+  // The pool borrows the constants, so keep the code object alive.
+  Py_INCREF(code);
+  regcode->names_ = state.names;
+  Py_INCREF(regcode->names_);
+  regcode->consts_ = state.consts_tuple;
+  Py_INCREF(regcode->consts_);
+  const int num_consts = PyTuple_GET_SIZE(regcode->consts_);
+  regcode->const_pool.resize(num_consts);
+  for (int i = 0; i < num_consts; ++i) {
+    regcode->const_pool[i].borrow(PyTuple_GET_ITEM(regcode->consts_, i));
+  }
+
+  for (PyObject* fn : state.inlined_functions) {
+    // Functions from other modules are only inlined if they read no globals.
+    const bool is_function = PyFunction_Check(fn);
+    InlineGuard guard = { fn, is_function ? PyFunction_GET_CODE(fn) : NULL,
+                          is_function && PyFunction_GET_GLOBALS(fn) == state.globals };
+    Py_INCREF(guard.function);
+    Py_XINCREF(guard.code);
+    regcode->inline_guards.push_back(guard);
+  }
+
   Log_Info(
       "COMPILED %s, %d registers, %d operations, %d stack ops.",
       PyString_AsString(code->co_name), regcode->num_registers, state.num_ops(), num_python_ops(PyString_AsString(code->co_code), PyString_GET_SIZE(code->co_code)));
@@ -22,7 +22,6 @@ struct Compiler {
 private:
   typedef google::dense_hash_map<PyObject*, RegisterCode*> CodeCache;
   CodeCache cache_;
-  BasicBlock* registerize(CompilerState* state, RegisterStack *stack, int offset);
   RegisterCode* compile_(PyObject* function);
 
 
@@ -39,7 +38,18 @@ public:
     cache_.set_empty_key(NULL);
   }
 
+  // Translate the Python bytecode of state->py_code from offset into basic
+  // blocks, returning the first.  Throws RException for unsupported code.
+  static BasicBlock* registerize(CompilerState* state, RegisterStack *stack, int offset);
+
   inline RegisterCode* compile(PyObject* function);
+
+  // The code compiled earlier for a function, or NULL if it hasn't been
+  // compiled (or failed to).
+  inline RegisterCode* lookup(PyObject* function) {
+    CodeCache::iterator i = cache_.find(PyFunction_GET_CODE(function));
+    return i == cache_.end() ? NULL : i->second;
+  }
 };
 
 
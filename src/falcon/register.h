@@ -2,6 +2,8 @@
 #ifndef FALCON_REGISTER_H
 #define FALCON_REGISTER_H
 
+#include <string.h>
+
 #include "py_include.h"
 
 #include "config.h"
@@ -10,10 +12,203 @@
 static const int ObjType = 0;
 static const int IntType = 1;
 
-#if USE_TYPED_REGISTERS
+#if USE_NAN_BOXING
+
+// A register is a single word holding an object pointer, an integer or a
+// double, told apart by its top 16 bits.  Pointers only use the low 48:
+//
+//   0x0000           object pointer (or NULL)
+//   0x0001 - 0xfffe  double, stored as its bits plus 2**48
+//   0xffff           integer, sign extended from the low 48 bits
+//
+// Negative NaNs whose bits would land outside the double range are
+// replaced by a single quiet NaN of the same sign.  Integers which need
+// more than 48 bits are kept as int objects; as with tagged registers,
+// is_int()/as_int() and is_float()/as_float() accept both forms, and the
+// ownership rules are the same (see below).  A number held unboxed has no
+// identity: copies of it in two registers are boxed separately.
+struct Register {
+  union {
+    int64_t i_value;
+    double f_value;
+    PyObject* objval;
+  };
+
+  static const uint64_t kIntTag = 0xffff000000000000ULL;
+  static const uint64_t kDoubleOffset = 1ULL << 48;
+
+  Register() {
+
+  }
+
+  Register(PyObject* v) {
+    store(v);
+  }
+
+  operator long() {
+    return as_int();
+  }
+
+  operator PyObject*() {
+    return as_obj();
+  }
+
+  static f_inline bool fits_tag(long v) {
+    return ((int64_t) ((uint64_t) v << 16) >> 16) == v;
+  }
+
+  static f_inline int64_t encode_double(double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    if ((bits >> 48) >= 0xfffe) {
+      bits = 0xfff8000000000000ULL;
+    }
+    return (int64_t) (bits + kDoubleOffset);
+  }
+
+  int compare(PyObject* v, int *result) {
+    if (PyInt_Check(v) && is_int()) {
+      long lv = PyInt_AsLong(v);
+      long rv = long(*this);
+      if (rv > lv) { *result = 1; }
+      else if (rv == lv) { *result = 0; }
+      else { *result = -1; }
+      return 0;
+    }
+
+    return PyObject_Cmp(as_obj(), v, result);
+  }
+
+  f_inline bool is_obj() const {
+    return ((uint64_t) i_value >> 48) == 0;
+  }
+
+  f_inline bool is_tagged_int() const {
+    return (uint64_t) i_value >= kIntTag;
+  }
+
+  f_inline bool is_tagged_float() const {
+    return !is_obj() && !is_tagged_int();
+  }
+
+  f_inline bool is_null() const {
+    return i_value == 0;
+  }
+
+  f_inline bool is_int() const {
+    return is_tagged_int() || (is_obj() && PyInt_CheckExact(objval));
+  }
+
+  f_inline long as_int() const {
+    return is_tagged_int() ? (int64_t) ((uint64_t) i_value << 16) >> 16 : PyInt_AS_LONG(objval);
+  }
+
+  f_inline bool is_float() const {
+    return is_tagged_float() || (is_obj() && PyFloat_CheckExact(objval));
+  }
+
+  f_inline double as_float() const {
+    if (is_obj()) {
+      return PyFloat_AS_DOUBLE(objval);
+    }
+    uint64_t bits = (uint64_t) i_value - kDoubleOffset;
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+  }
+
+  f_inline PyObject* as_obj() {
+    if (is_obj()) {
+      return objval;
+    }
+    PyObject* box = is_tagged_int() ? PyInt_FromLong(as_int()) : PyFloat_FromDouble(as_float());
+    if (box != NULL) {
+      objval = box;
+    }
+    return box;
+  }
+
+  f_inline void reset() {
+    objval = (PyObject*) NULL;
+  }
+
+  f_inline void decref() {
+    if (is_obj()) {
+      Py_XDECREF(objval);
+    }
+  }
+
+  f_inline void incref() {
+    if (is_obj()) {
+      Py_XINCREF(objval);
+    }
+  }
+
+  template<bool DECREF_OLD>
+  f_inline void set_bits(int64_t bits) {
+    if (DECREF_OLD) {
+      Register old(*this);
+      i_value = bits;
+      old.decref();
+    } else {
+      i_value = bits;
+    }
+  }
+
+  template<bool DECREF_OLD = false>
+  f_inline void store(const Register& r) {
+    set_bits<DECREF_OLD>(r.i_value);
+  }
+
+  template<bool DECREF_OLD = false>
+  f_inline void store(int v) {
+    store<DECREF_OLD>((long) v);
+  }
+
+  template<bool DECREF_OLD = false>
+  f_inline void store(long v) {
+    if (fits_tag(v)) {
+      set_bits<DECREF_OLD>((int64_t) (kIntTag | ((uint64_t) v & (kDoubleOffset - 1))));
+    } else {
+      set_bits<DECREF_OLD>((int64_t) PyInt_FromLong(v));
+    }
+  }
+
+  template<bool DECREF_OLD = false>
+  f_inline void store(double v) {
+    set_bits<DECREF_OLD>(encode_double(v));
+  }
+
+  template<bool DECREF_OLD = false>
+  f_inline void store(PyObject* obj) {
+    set_bits<DECREF_OLD>((int64_t) obj);
+  }
+
+  f_inline void borrow(PyObject* obj) {
+    objval = obj;
+  }
+};
+
+#elif USE_TYPED_REGISTERS
 
 #define TYPE_MASK 0x1
 
+// A register holds either a tagged integer, (value << 1) | 1, or an owned
+// reference to an object (aligned, so its low bit is 0).  The integer fast
+// paths store their results tagged when they fit in 63 bits; int objects
+// from elsewhere are kept as they are.  is_int() and as_int() accept both
+// forms, so handlers needn't care which one they were given.
+//
+// Ownership:
+//  - store() takes over the reference passed in; store<true> also releases
+//    whatever the register held before.
+//  - borrow() refers to an object without taking a reference, for
+//    argument vectors that are copied into a frame and then incref()'d.
+//  - as_obj() returns a borrowed reference.  An int register is boxed in
+//    place, so the box is owned by the register from then on.
+//
+// Registers must stay trivially copyable, so that they are returned in a
+// machine register and the tail-call dispatch's handlers can be sibcalls.
 struct Register {
   union {
     int64_t i_value;
@@ -29,10 +224,6 @@ struct Register {
     store(v);
   }
 
-  Register(const Register& r) {
-    objval = r.objval;
-  }
-
   operator long() {
     return as_int();
   }
@@ -41,8 +232,12 @@ struct Register {
     return as_obj();
   }
 
+  static f_inline bool fits_tag(long v) {
+    return ((v << 1) >> 1) == v;
+  }
+
   int compare(PyObject* v, int *result) {
-    if (PyInt_Check(v) && get_type() == IntType) {
+    if (PyInt_Check(v) && is_int()) {
       long lv = PyInt_AsLong(v);
       long rv = long(*this);
       if (rv > lv) { *result = 1; }
@@ -51,26 +246,43 @@ struct Register {
       return 0;
     }
 
-    return PyObject_Cmp((PyObject*)this, v, result);
+    return PyObject_Cmp(as_obj(), v, result);
+  }
+
+  f_inline bool is_int() const {
+    return get_type() == IntType || PyInt_CheckExact(objval);
   }
 
   f_inline long as_int() const {
 //    Log_Info("load: %p : %d", this, value);
-    return i_value >> 1;
+    return get_type() == IntType ? i_value >> 1 : PyInt_AS_LONG(objval);
   }
 
-  f_inline bool is_obj() {
+  f_inline bool is_obj() const {
     return get_type() == ObjType;
   }
 
+  f_inline bool is_null() const {
+    return i_value == 0;
+  }
+
+  f_inline bool is_float() const {
+    return is_obj() && PyFloat_CheckExact(objval);
+  }
+
+  f_inline double as_float() const {
+    return PyFloat_AS_DOUBLE(objval);
+  }
+
   f_inline PyObject* as_obj() {
     if (get_type() == ObjType) {
       return objval;
-    } else {
-      objval = PyInt_FromLong(as_int());
-      //Log_Info("Coerced: %p %d", this, objval->ob_refcnt);
-      return objval;
     }
+    PyObject* box = PyInt_FromLong(as_int());
+    if (box != NULL) {
+      objval = box;
+    }
+    return box;
   }
 
   f_inline void reset() {
@@ -91,18 +303,26 @@ struct Register {
   f_inline void incref() {
     if (get_type() == ObjType) {
 //      Log_Info("Incref %p %d", this, objval == NULL ? -1 : objval->ob_refcnt);
-      Py_INCREF(objval);
+      Py_XINCREF(objval);
+    }
+  }
+
+  // Replace the contents of the register, releasing the old ones only
+  // after the new ones are in place, as Py_SETREF does.
+  template<bool DECREF_OLD>
+  f_inline void set_bits(int64_t bits) {
+    if (DECREF_OLD) {
+      Register old(*this);
+      i_value = bits;
+      old.decref();
+    } else {
+      i_value = bits;
     }
   }
 
   template<bool DECREF_OLD = false>
-  f_inline void store(Register& r) {
-      if (DECREF_OLD && get_type() == ObjType) {
-          auto old = objval;
-          objval = r.objval;
-          Py_XDECREF(old);
-      } else 
-          objval = r.objval;
+  f_inline void store(const Register& r) {
+    set_bits<DECREF_OLD>(r.i_value);
   }
 
   template<bool DECREF_OLD = false>
@@ -113,33 +333,27 @@ struct Register {
   template<bool DECREF_OLD = false>
   f_inline void store(long v) {
 //    Log_Info("store: %p : %d", this, v);
-      if (DECREF_OLD && get_type() == ObjType) {
-          auto old = objval;
-          i_value = v << 1;
-          i_value |= IntType;
-          Py_XDECREF(old);
-      }
-      else {
-          i_value = v << 1;
-          i_value |= IntType;
-      }
+    if (fits_tag(v)) {
+      set_bits<DECREF_OLD>((v << 1) | IntType);
+    } else {
+      PyObject* box = PyInt_FromLong(v);
+      set_bits<DECREF_OLD>((int64_t) box);
+    }
+  }
+
+  template<bool DECREF_OLD = false>
+  f_inline void store(double v) {
+    set_bits<DECREF_OLD>((int64_t) PyFloat_FromDouble(v));
   }
 
   template<bool DECREF_OLD = false>
   f_inline void store(PyObject* obj) {
-    if (obj == NULL || !PyInt_CheckExact(obj)) {
-        if (DECREF_OLD) {
-            auto old = objval;
-            objval = obj;
-            Py_XDECREF(old);
-        } else 
-            // Type flag is implicitly set to zero as a result of pointer alignment.
-            objval = obj;
-    } else {
-      store<DECREF_OLD>(PyInt_AS_LONG(obj) );
-      Py_DECREF(obj);
-      //Log_Info("Register store object %d %d", as_int(), obj->ob_refcnt);
-    }
+    // Type flag is implicitly set to zero as a result of pointer alignment.
+    set_bits<DECREF_OLD>((int64_t) obj);
+  }
+
+  f_inline void borrow(PyObject* obj) {
+    objval = obj;
   }
 };
 
@@ -159,13 +373,29 @@ struct Register {
   }
   
   int compare(PyObject* v, int *result) {
-    return PyObject_Cmp((PyObject*)this, v, result);
+    return PyObject_Cmp(this->v, v, result);
   }
 
   f_inline bool is_obj() {
     return true;
   }
 
+  f_inline bool is_int() {
+    return PyInt_CheckExact(v);
+  }
+
+  f_inline bool is_null() const {
+    return v == NULL;
+  }
+
+  f_inline bool is_float() const {
+    return PyFloat_CheckExact(v);
+  }
+
+  f_inline double as_float() const {
+    return PyFloat_AS_DOUBLE(v);
+  }
+
   f_inline PyObject*& as_obj() {
     return v;
   }
@@ -197,8 +427,12 @@ struct Register {
       }    
   }
 
+  f_inline void borrow(PyObject* obj) {
+    v = obj;
+  }
+
   template<bool DECREF_OLD = false>
-  f_inline void store(Register& r) {
+  f_inline void store(const Register& r) {
       if (DECREF_OLD) {
           auto old = v;
           v = r.v;
@@ -214,6 +448,11 @@ struct Register {
     store<DECREF_OLD>((long)ival);
   }
 
+  template<bool DECREF_OLD = false>
+  f_inline void store(double dval) {
+    store<DECREF_OLD>(PyFloat_FromDouble(dval));
+  }
+
   template<bool DECREF_OLD = false>
   f_inline void store(long ival) {
     if (DECREF_OLD) {
@@ -10,6 +10,14 @@ int RegisterStack::num_exc_handlers() {
   return total;
 }
 
+int RegisterStack::exc_handler() {
+  for (auto f = frames.rbegin(); f != frames.rend(); ++f) {
+    if (f->is_exc_handler) {
+      return f->target;
+    }
+  }
+  return -1;
+}
 
 void RegisterStack::push_frame(int target, bool exc_handler) {
   Frame f;
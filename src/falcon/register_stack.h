@@ -24,6 +24,8 @@ public:
   Frame pop_exc_handler();
 
   int num_exc_handlers();
+  // The target of the innermost exception handler frame, or -1.
+  int exc_handler();
 
   int push_register(int reg);
   int pop_register();
@@ -2,10 +2,13 @@
 
 #include <opcode.h>
 #include <marshal.h>
+#include <structmember.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdarg.h>
 
+#include <map>
+
 #include "reval.h"
 #include "rcompile.h"
 
@@ -39,6 +42,8 @@ static f_inline PyObject* load_obj(Register* registers, int regnum) {
 #define LOAD_FLOAT(regnum) registers[regnum].as_float()
 
 typedef long (*IntegerBinaryOp)(long, long);
+typedef bool (*IntegerOverflowCheck)(long, long, long);
+typedef double (*FloatBinaryOp)(double, double);
 typedef PyObject* (*PythonBinaryOp)(PyObject*, PyObject*);
 typedef PyObject* (*UnaryFunction)(PyObject*);
 
@@ -89,12 +94,229 @@ struct PyObjHelper {
   }
 };
 
-RegisterFrame::RegisterFrame(RegisterCode* rcode, PyObject* obj, const ObjVector& args, const ObjVector& kw, PyObject* globals, PyObject* locals) :
-    code(rcode), pyframe_(NULL) {
+RegisterFile* RegisterFile::current() {
+  static thread_local RegisterFile file;
+  return &file;
+}
+
+// Registers for a frame: a window of the thread's register file, or from
+// the heap if that is full.
+static inline f_inline Register* alloc_registers(int n) {
+#if STACK_ALLOC_REGISTERS
+  Register* window = RegisterFile::current()->push(n);
+  if (window != NULL) {
+    return window;
+  }
+#endif
+  return new Register[n];
+}
+
+static inline f_inline void free_registers(Register* registers) {
+#if STACK_ALLOC_REGISTERS
+  if (RegisterFile::current()->pop(registers)) {
+    return;
+  }
+#endif
+  delete[] registers;
+}
+
+static inline f_inline void copy_consts(RegisterCode* code, Register* registers) {
+  if (code->num_consts() > 0) {
+    memcpy(registers, &code->const_pool[0], code->num_consts() * sizeof(Register));
+  }
+}
+
+// The argument lists a frame can be made from.  Positional arguments are
+// indexed like a vector of registers.  Keyword arguments each have a
+// name, a value, and the parameter of the code being called that the
+// name is found at, or -1 if the code takes no parameter of that name.
+
+// The arguments of a direct call, read from the caller's registers.
+struct CallerArgs {
+  Register* registers;
+  const RegisterOffset* arg_regs;
+
+  f_inline Register& operator[](int i) const {
+    return registers[arg_regs[i]];
+  }
+};
+
+// A call without keyword arguments.
+struct NoKeywords {
+  f_inline int size() const {
+    return 0;
+  }
+
+  PyObject* name(int i) const {
+    return NULL;
+  }
+
+  Register& value(int i) const {
+    static Register none((PyObject*) NULL);
+    return none;
+  }
+
+  int param(RegisterCode* code, int i) const {
+    return -1;
+  }
+};
+
+// The keyword arguments of a direct call, as (name, value) pairs of the
+// caller's registers, with the parameters found for them by the call's
+// CallCache.
+struct CallerKeywords {
+  Register* registers;
+  const RegisterOffset* kw_regs;
+  int count;
+  const int16_t* params;
+
+  f_inline int size() const {
+    return count;
+  }
+
+  f_inline PyObject* name(int i) const {
+    return registers[kw_regs[2 * i]].as_obj();
+  }
+
+  f_inline Register& value(int i) const {
+    return registers[kw_regs[2 * i + 1]];
+  }
+
+  f_inline int param(RegisterCode* code, int i) const {
+    return params[i];
+  }
+};
+
+// The parameter of code called name, or -1.  Names are nearly always
+// interned, so are first compared by identity, as ceval does.
+static int find_param(RegisterCode* code, PyObject* name) {
+  PyObject* varnames = code->varnames();
+  for (int i = 0; i < code->num_args; ++i) {
+    if (PyTuple_GET_ITEM(varnames, i) == name) {
+      return i;
+    }
+  }
+  for (int i = 0; i < code->num_args; ++i) {
+    if (_PyString_Eq(PyTuple_GET_ITEM(varnames, i), name)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int Keywords::param(RegisterCode* code, int i) const {
+  return find_param(code, names[i]);
+}
+
+template<class KwList>
+static bool has_keyword_for(RegisterCode* code, const KwList& kw, int param) {
+  for (int i = 0; i < kw.size(); ++i) {
+    if (kw.param(code, i) == param) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template<class ArgList, class KwList>
+RegisterFrame::RegisterFrame(RegisterCode* rcode, PyObject* obj, const ArgList& args, int num_args, const KwList& kw,
+                             PyObject* globals, PyObject* locals) :
+    code(rcode), pyframe_(NULL),
+    saved_exc_type_(NULL), saved_exc_value_(NULL), saved_exc_tb_(NULL), error_pc_(NULL), reraised_(false) {
   instructions_ = code->instructions.data();
+  start_pc_ = instructions_;
+  yield_pc_ = NULL;
+
+  // Globals, defaults and closure come from the function being called,
+  // which needn't be the one rcode was compiled from: closures made by
+  // the same MAKE_CLOSURE share their code.
+  PyObject* function = PyMethod_Check(obj) ? PyMethod_GET_FUNCTION(obj) : obj;
+  if (!PyFunction_Check(function)) {
+    function = rcode->function;
+  }
+
+  PyObject* self = NULL;
+  if (PyMethod_Check(obj)) {
+    self = PyMethod_GET_SELF(obj);
+    Reg_Assert(self != NULL, "Method call without a bound self.");
+  }
+
+  const int num_registers = code->num_registers;
+  Reg_AssertLt(num_registers, kMaxRegisters);
+
+  // Check the arguments against the code, and pack any *args and
+  // **kwargs, before taking anything that needs releasing.  Positional
+  // arguments (self first) fill the parameters in order, keywords those
+  // they name, and defaults the rest.
+  const int first = self != NULL;
+  const int num_params = code->num_args;
+  const int num_given = first + num_args;
+  const int num_positional = std::min(num_given, num_params);
+  PyObject* def_args = function ? PyFunction_GET_DEFAULTS(function) : NULL;
+  const int num_defaults = def_args == NULL ? 0 : PyTuple_GET_SIZE(def_args);
+  PyObject* varargs = NULL;
+  PyObject* varkw = NULL;
+  if (function) {
+    const char* name = PyString_AS_STRING(code->code()->co_name);
+    const int flags = code->code()->co_flags;
+    if (num_given > num_params && !(flags & CO_VARARGS)) {
+      throw RException(PyExc_TypeError, "%.200s() takes %s %d argument%s (%d given)",
+                       name, num_defaults ? "at most" : "exactly", num_params, num_params == 1 ? "" : "s",
+                       num_given + kw.size());
+    }
+
+    int num_keywords = 0;
+    for (int i = 0; i < kw.size(); ++i) {
+      const int param = kw.param(code, i);
+      if (param < 0) {
+        if (!(flags & CO_VARKEYWORDS)) {
+          throw RException(PyExc_TypeError, "%.200s() got an unexpected keyword argument '%.400s'",
+                           name, PyString_AS_STRING(kw.name(i)));
+        }
+      } else if (param < num_positional) {
+        throw RException(PyExc_TypeError, "%.200s() got multiple values for keyword argument '%.400s'",
+                         name, PyString_AS_STRING(kw.name(i)));
+      } else {
+        ++num_keywords;
+      }
+    }
+
+    const int num_required = num_params - num_defaults;
+    for (int i = num_positional; i < num_required; ++i) {
+      if (!has_keyword_for(code, kw, i)) {
+        throw RException(PyExc_TypeError, "%.200s() takes %s %d argument%s (%d given)",
+                         name, (flags & CO_VARARGS) || num_defaults ? "at least" : "exactly",
+                         num_required, num_required == 1 ? "" : "s", num_positional + num_keywords);
+      }
+    }
+
+    if (flags & CO_VARARGS) {
+      varargs = PyTuple_New(std::max(num_given - num_params, 0));
+      if (varargs == NULL) {
+        throw RException();
+      }
+      for (int i = num_params; i < num_given; ++i) {
+        PyObject* v = i < first ? self : args[i - first].as_obj();
+        Py_INCREF(v);
+        PyTuple_SET_ITEM(varargs, i - num_params, v);
+      }
+    }
+    if (flags & CO_VARKEYWORDS) {
+      varkw = PyDict_New();
+      for (int i = 0; varkw != NULL && i < kw.size(); ++i) {
+        if (kw.param(code, i) < 0 && PyDict_SetItem(varkw, kw.name(i), kw.value(i).as_obj()) < 0) {
+          Py_CLEAR(varkw);
+        }
+      }
+      if (varkw == NULL) {
+        Py_XDECREF(varargs);
+        throw RException();
+      }
+    }
+  }
 
-  if (rcode->function) {
-    globals_ = globals ? globals : PyFunction_GetGlobals(rcode->function);
+  if (function) {
+    globals_ = globals ? globals : PyFunction_GetGlobals(function);
     Py_INCREF(globals_);
     locals_ = locals ? (Py_INCREF(locals), locals) : NULL;
   } else {
@@ -104,44 +326,81 @@ RegisterFrame::RegisterFrame(RegisterCode* rcode, PyObject* obj, const ObjVector
     Py_INCREF(locals_);
   }
 
-  Reg_Assert(kw.empty(), "Keyword args not supported.");
-
   builtins_ = PyEval_GetBuiltins();
 
   names_ = code->names();
   consts_ = code->consts();
 
-#if ! STACK_ALLOC_REGISTERS
-  registers = new Register[rcode->num_registers];
-#endif
+  registers = alloc_registers(num_registers);
+
+//  Log_Info("Alignments: reg: %d code: %d consts: %d globals: %d, this: %d",
+//           ((long)registers) % 64, ((long)rcode->instructions.data()) % 64, (long)consts_ % 64, (long)globals_ % 64, (long)this % 64);
+
+  // setup const and local register aliases.
+  int num_consts = code->num_consts();
+  copy_consts(code, registers);
+
+  int offset = num_consts;
+  if (function) {
+    Register* params = registers + num_consts;
+    for (int i = 0; i < num_positional; ++i) {
+      if (i < first) {
+        Py_INCREF(self);
+        params[i].store(self);
+      } else {
+        params[i].store(args[i - first]);
+        params[i].incref();
+      }
+    }
+    if (num_positional < num_params) {
+      for (int i = num_positional; i < num_params; ++i) {
+        params[i].reset();
+      }
+      for (int i = 0; i < kw.size(); ++i) {
+        const int param = kw.param(code, i);
+        if (param >= 0) {
+          params[param].store(kw.value(i));
+          params[param].incref();
+        }
+      }
+      const int default_start = num_params - num_defaults;
+      EVAL_LOG("Calling function with defaults: %s", obj_to_str(def_args));
+      for (int i = num_positional; i < num_params; ++i) {
+        if (params[i].is_null()) {
+          params[i].borrow(PyTuple_GET_ITEM(def_args, i - default_start));
+          params[i].incref();
+        }
+      }
+    }
+    offset += num_params;
+    if (varargs != NULL) {
+      registers[offset++].store(varargs);
+    }
+    if (varkw != NULL) {
+      registers[offset++].store(varkw);
+    }
+  } else if (self != NULL) {
+    Py_INCREF(self);
+    registers[offset++].store(self);
+  }
 
-  const int num_args = args.size();
+  // Cells for arguments start out holding the argument, so are made once
+  // the argument registers are filled in.
   if (rcode->num_cells > 0) {
 #if ! STACK_ALLOC_REGISTERS
     freevars = new PyObject*[rcode->num_cells];
 #else
-    assert(rcode->num_cells <= 8);
+    assert(rcode->num_cells <= kMaxCells);
 #endif
-    int i;
-    for (i = 0; i < rcode->num_cellvars; ++i) {
-      bool found_argname = false;
-      char *cellname = PyString_AS_STRING(PyTuple_GET_ITEM(rcode->code()->co_cellvars, i));
-      for (int arg_idx = 0; arg_idx < num_args; ++arg_idx) {
-        char* argname = PyString_AS_STRING(PyTuple_GET_ITEM(rcode->code()->co_varnames, arg_idx));
-        if (strcmp(cellname, argname) == 0) {
-          PyObject* arg_value = args[arg_idx].as_obj();
-          freevars[i] = PyCell_New(arg_value);
-          found_argname = true;
-          break;
-        }
-      }
-      if (!found_argname) {
-        freevars[i] = PyCell_New(NULL);
-      }
+    // Without a function no arguments were bound, so no cell starts full.
+    const int num_bound = offset - num_consts;
+    for (int i = 0; i < rcode->num_cellvars; ++i) {
+      const int arg = rcode->cell_args[i];
+      freevars[i] = PyCell_New(arg >= 0 && arg < num_bound ? registers[num_consts + arg].as_obj() : NULL);
     }
 
-	assert(rcode->function);
-    PyObject* closure = ((PyFunctionObject*) rcode->function)->func_closure;
+	assert(function);
+    PyObject* closure = ((PyFunctionObject*) function)->func_closure;
     if (closure) {
       for (int i = rcode->num_cellvars; i < rcode->num_cells; ++i) {
         freevars[i] = PyTuple_GET_ITEM(closure, i - rcode->num_cellvars) ;
@@ -158,57 +417,6 @@ RegisterFrame::RegisterFrame(RegisterCode* rcode, PyObject* obj, const ObjVector
 #endif
           }
 
-//  Log_Info("Alignments: reg: %d code: %d consts: %d globals: %d, this: %d",
-//           ((long)registers) % 64, ((long)rcode->instructions.data()) % 64, (long)consts_ % 64, (long)globals_ % 64, (long)this % 64);
-
-  const int num_registers = code->num_registers;
-
-  // setup const and local register aliases.
-  int num_consts = PyTuple_GET_SIZE(consts());
-  for (int i = 0; i < num_consts; ++i) {
-    PyObject* v = PyTuple_GET_ITEM(consts(), i) ;
-    Py_INCREF(v);
-    registers[i].store(v);
-  }
-
-  int needed_args = code->code()->co_argcount;
-  int offset = num_consts;
-  if (PyMethod_Check(obj)) {
-    PyObject* self = PyMethod_GET_SELF(obj);
-
-    Reg_Assert(self != NULL, "Method call without a bound self.");
-    Py_INCREF(self);
-    registers[offset].store(self);
-    ++offset;
-    needed_args--;
-  }
-
-  if (code->function) {
-    PyObject* def_args = PyFunction_GET_DEFAULTS(code->function);
-    int num_def_args = def_args == NULL ? 0 : PyTuple_GET_SIZE(def_args);
-    int num_args = args.size();
-    if (num_args + num_def_args < needed_args) {
-      throw RException(PyExc_TypeError, "Wrong number of arguments for %s, expected %d, got %d.",
-                       PyEval_GetFuncName(code->function), needed_args - num_def_args, num_args);
-    }
-
-    int default_start = needed_args - num_def_args;
-    EVAL_LOG("Calling function with defaults: %s", obj_to_str(def_args));
-    for (int i = 0; i < needed_args; ++i) {
-      if (i < num_args) {
-        EVAL_LOG("Assigning arguments: %d <- args[%d] %s", offset, i, obj_to_str(args[i].as_obj()));
-        registers[offset].store(args[i]);
-      } else {
-        PyObject* default_arg = PyTuple_GET_ITEM(def_args, i - default_start);
-        EVAL_LOG("Assigning arguments: %d <- defaults[%d] %s", offset, i, obj_to_str(default_arg));
-        registers[offset].store(default_arg);
-      }
-      registers[offset].incref();
-      ++offset;
-    }
-  }
-
-  Reg_AssertLt(num_registers, kMaxRegisters);
   for (register int i = offset; i < num_registers; ++i) {
     registers[i].reset();
   }
@@ -216,19 +424,19 @@ RegisterFrame::RegisterFrame(RegisterCode* rcode, PyObject* obj, const ObjVector
 }
 
 RegisterFrame::RegisterFrame(RegisterCode* rcode, PyFrameObject* f)
-        :code(rcode), pyframe_((PyObject*)f) {
+        :code(rcode), pyframe_((PyObject*)f),
+         saved_exc_type_(NULL), saved_exc_value_(NULL), saved_exc_tb_(NULL), error_pc_(NULL), reraised_(false) {
     Py_INCREF(f);
     instructions_ = code->instructions.data();
+    start_pc_ = instructions_;
+    yield_pc_ = NULL;
     builtins_ = f->f_builtins;
     names_ = code->names();
     consts_ = code->consts();
+    registers = alloc_registers(code->num_registers);
 
-    int num_consts = PyTuple_GET_SIZE(consts_);
-    for (int i = 0; i < num_consts; ++i) {
-        PyObject* v = PyTuple_GET_ITEM(consts_, i);
-        Py_INCREF(v);
-        registers[i].store(v);
-    }
+    int num_consts = code->num_consts();
+    copy_consts(code, registers);
 
     globals_ = f->f_globals;
     locals_ = f->f_locals;
@@ -250,7 +458,7 @@ RegisterFrame::RegisterFrame(RegisterCode* rcode, PyFrameObject* f)
 
 RegisterFrame::~RegisterFrame() {
   const int num_registers = code->num_registers;
-  for (register int i = 0; i < num_registers; ++i) {
+  for (register int i = code->num_consts(); i < num_registers; ++i) {
     registers[i].decref();
   }
 
@@ -260,27 +468,85 @@ RegisterFrame::~RegisterFrame() {
 
   Py_XDECREF(pyframe_);
 
+  if (saved_exc_type_ != NULL) {
+    reset_exc_info();
+  }
+
+  free_registers(registers);
 #if ! STACK_ALLOC_REGISTERS
-  delete[] registers;
   delete[] freevars;
 #endif
 }
 
+void RegisterFrame::move_registers_to_heap() {
+#if STACK_ALLOC_REGISTERS
+  Register* heap = new Register[code->num_registers];
+  memcpy(heap, registers, code->num_registers * sizeof(Register));
+  free_registers(registers);
+  registers = heap;
+#endif
+}
+
+// As ceval's reset_exc_info.
+void RegisterFrame::reset_exc_info() {
+  PyThreadState* tstate = PyThreadState_GET();
+  PyObject* tmp_type = tstate->exc_type;
+  PyObject* tmp_value = tstate->exc_value;
+  PyObject* tmp_tb = tstate->exc_traceback;
+  tstate->exc_type = saved_exc_type_;
+  tstate->exc_value = saved_exc_value_;
+  tstate->exc_traceback = saved_exc_tb_;
+  Py_XDECREF(tmp_type);
+  Py_XDECREF(tmp_value);
+  Py_XDECREF(tmp_tb);
+  PySys_SetObject((char*) "exc_type", saved_exc_type_);
+  PySys_SetObject((char*) "exc_value", saved_exc_value_);
+  PySys_SetObject((char*) "exc_traceback", saved_exc_tb_);
+  saved_exc_type_ = NULL;
+  saved_exc_value_ = NULL;
+  saved_exc_tb_ = NULL;
+}
+
+// As ceval's set_exc_info.
+void RegisterFrame::set_exc_info(PyObject* type, PyObject* value, PyObject* tb) {
+  PyThreadState* tstate = PyThreadState_GET();
+  if (saved_exc_type_ == NULL) {
+    if (tstate->exc_type == NULL) {
+      Py_INCREF(Py_None);
+      tstate->exc_type = Py_None;
+    }
+    Py_INCREF(tstate->exc_type);
+    Py_XINCREF(tstate->exc_value);
+    Py_XINCREF(tstate->exc_traceback);
+    saved_exc_type_ = tstate->exc_type;
+    saved_exc_value_ = tstate->exc_value;
+    saved_exc_tb_ = tstate->exc_traceback;
+  }
+
+  PyObject* tmp_type = tstate->exc_type;
+  PyObject* tmp_value = tstate->exc_value;
+  PyObject* tmp_tb = tstate->exc_traceback;
+  Py_INCREF(type);
+  Py_XINCREF(value);
+  Py_XINCREF(tb);
+  tstate->exc_type = type;
+  tstate->exc_value = value;
+  tstate->exc_traceback = tb;
+  Py_XDECREF(tmp_type);
+  Py_XDECREF(tmp_value);
+  Py_XDECREF(tmp_tb);
+
+  PySys_SetObject((char*) "exc_type", type);
+  PySys_SetObject((char*) "exc_value", value);
+  PySys_SetObject((char*) "exc_traceback", tb);
+}
+
 Evaluator::Evaluator() {
   memset(op_counts_, 0, sizeof(op_counts_));
   memset(op_times_, 0, sizeof(op_times_));
   total_count_ = 0;
   last_clock_ = 0;
-  hint_hits_ = 0;
-  hint_misses_ = 0;
   compiler = new Compiler;
-  memset(hints, 0, sizeof(Hint) * kMaxHints);
-
-  // We use a sentinel value for the invalid hint index.
-  hints[kInvalidHint].guard.obj = NULL;
-  hints[kInvalidHint].key = NULL;
-  hints[kInvalidHint].value = NULL;
-  hints[kInvalidHint].version = (unsigned int) -1;
 }
 
 Evaluator::~Evaluator() {
@@ -316,6 +582,11 @@ PyObject* Evaluator::eval_frame_delegate(PyFrameObject* f, int throwflag) {
 }
 
 PyObject* Evaluator::EvalFrame(PyFrameObject* f, int throwflag) {
+    // Resuming one would start it over: generators made by CPython stay
+    // there.
+    if (f->f_code->co_flags & CO_GENERATOR) {
+        return PyEval_EvalFrameDefault(f, throwflag);
+    }
     auto rcode = compiler->compile((PyObject*)f->f_code);
     if (rcode == NULL) {
         return NULL;
@@ -343,10 +614,17 @@ PyObject* RegisterFrame::locals() {
   return locals_;
 }
 
+static void flush_traceback();
+static void clear_traceback();
+static PyObject* new_generator(Evaluator* eval, RegisterFrame* frame);
+
 PyObject* Evaluator::eval_frame_to_pyobj(RegisterFrame* frame) {
     Register result = eval(frame);
     //bool needs_incref = !result.is_obj();
     PyObject* result_obj = result.as_obj();
+    if (result_obj == NULL) {
+      flush_traceback();
+    }
     //if (needs_incref) Py_INCREF(result_obj);
 
     EVAL_LOG("Returning to python: %s", obj_to_str(result_obj));
@@ -370,6 +648,9 @@ PyObject* Evaluator::eval_python(PyObject* func, PyObject* args, PyObject* kw) {
   if (frame == NULL) {
     EVAL_LOG("Couldn't compile function, calling CPython.");
     return PyObject_Call(func, args, kw);
+  } else if (frame->code->generator) {
+    frame->move_registers_to_heap();
+    return new_generator(this, auto_delete.release());
   } else {
     return eval_frame_to_pyobj(frame);
   }
@@ -388,29 +669,31 @@ RegisterFrame* Evaluator::frame_from_pyfunc(PyObject* obj, PyObject* args, PyObj
   ObjVector v_args;
   v_args.resize(PyTuple_GET_SIZE(args) );
   for (size_t i = 0; i < v_args.size(); ++i) {
-    v_args[i].store(PyTuple_GET_ITEM(args, i) );
+    v_args[i].borrow(PyTuple_GET_ITEM(args, i));
   }
 
-  ObjVector kw_args;
-
-  size_t n_kwds = 0;
+  Keywords kw_args;
   if (kw != NULL && PyDict_Check(kw)) {
-    n_kwds = PyDict_Size(kw);
-  }
-
-  for (size_t i = 0; i < n_kwds; ++i) {
-    throw RException(PyExc_ValueError, "Keywords not yet supported, n_given = %d", n_kwds);
-    // should check whether kw is present in the args
-    // and use default otherwise
-    // kw_args.push_back()
+    Py_ssize_t pos = 0;
+    PyObject* key;
+    PyObject* value;
+    while (PyDict_Next(kw, &pos, &key, &value)) {
+      // Leave other keys, and the errors they raise, to CPython.
+      if (!PyString_Check(key)) {
+        return NULL;
+      }
+      Register r;
+      r.borrow(value);
+      kw_args.push_back(key, r);
+    }
   }
-  return new RegisterFrame(regcode, obj, v_args, kw_args, globals, locals);
+  return new RegisterFrame(regcode, obj, v_args, v_args.size(), kw_args, globals, locals);
 }
 
 RegisterFrame* Evaluator::frame_from_codeobj(PyObject* code) {
-  ObjVector args, kw;
+  ObjVector args;
   RegisterCode *regcode = compiler->compile(code);
-  return new RegisterFrame(regcode, code, args, kw);
+  return new RegisterFrame(regcode, code, args, 0, NoKeywords());
 }
 
 PyObject* Evaluator::disassemble(PyObject* func) {
@@ -469,25 +752,89 @@ void Evaluator::collect_info(int opcode) {
 
 template <class OpType>
 static f_inline void log_operation(RegisterFrame* frame, const OpType* op, Register* registers, const char* pc) {
-  EVAL_LOG("%5d %s %s", frame->offset(pc), frame->str().c_str(), op->str(registers).c_str());
+  EVAL_LOG("%5d %s %s", frame->offset(pc), frame->str().c_str(),
+           op->str(frame->code->opcode(pc), registers).c_str());
+}
+
+#if PROFILE_OP_SEQUENCES
+// Executed opcode pairs and triples, keyed by (a << 16 | b << 8 | c).  Only
+// sequences that fall through are recorded, as only those can be fused.
+static std::map<int, int64_t> op_sequence_counts;
+static std::string op_profile_workload;
+
+static void dump_op_sequences() {
+  const char* path = getenv("FALCON_OP_PROFILE");
+  if (path == NULL || op_sequence_counts.empty()) {
+    return;
+  }
+
+  FILE* out = fopen(path, "a");
+  if (out == NULL) {
+    Log_Error("Failed to open op profile: %s", path);
+    return;
+  }
+
+  fprintf(out, "# %s\n", op_profile_workload.c_str());
+  for (auto& kv : op_sequence_counts) {
+    int a = kv.first >> 16, b = (kv.first >> 8) & 0xff, c = kv.first & 0xff;
+    fprintf(out, "%lld %s %s", (long long) kv.second, OpUtil::name(a), OpUtil::name(b));
+    if (c != 0) {
+      fprintf(out, " %s", OpUtil::name(c));
+    }
+    fprintf(out, "\n");
+  }
+  fclose(out);
+}
+
+static void profile_op_sequence(RegisterFrame* frame, const char* pc, size_t size) {
+  if (op_sequence_counts.empty()) {
+    PyObject* argv = PySys_GetObject((char*) "argv");
+    if (argv != NULL && PyList_Check(argv) && PyList_GET_SIZE(argv) > 0) {
+      op_profile_workload = obj_to_str(PyList_GET_ITEM(argv, 0));
+    }
+    Py_AtExit(dump_op_sequences);
+  }
+
+  const RegisterCode* code = frame->code;
+  JumpLoc next = (JumpLoc) (frame->offset(pc) + size);
+  auto iter = std::lower_bound(code->op_offsets.begin(), code->op_offsets.end(), next);
+  if (iter == code->op_offsets.end()) {
+    return;
+  }
+
+  int a = code->opcode(pc);
+  int b = (uint8_t) code->opcodes[next];
+  ++op_sequence_counts[a << 16 | b << 8];
+
+  if (++iter != code->op_offsets.end() && b != RETURN_VALUE && !OpUtil::is_branch(b)) {
+    int c = (uint8_t) code->opcodes[*iter];
+    ++op_sequence_counts[a << 16 | b << 8 | c];
+  }
 }
+#endif
 
 #define WRITEOP_DISASM() do {						\
 	auto& writer = eval->get_disasm_writer();		\
-	writer.write(op.str());							\
+	writer.write(op.str(frame->code->opcode((const char*) &op)));	\
 	writer.printf("\n");							\
 } while (0)
 
+// Each operation's _eval returns false when it raises, with the Python
+// error set; eval then returns NULL in place of the next pc, and the
+// dispatch loop looks for a handler (see RegisterCode::find_handler).
 template<class OpType, class SubType>
 struct RegOpImpl {
   template<bool DISASM>
   static f_inline const char* eval(Evaluator* eval, RegisterFrame* frame, const char* pc, Register* registers) {
     OpType& op = *((OpType*) pc);
 	if (!DISASM) log_operation(frame, &op, registers, pc);
+#if PROFILE_OP_SEQUENCES
+	if (!DISASM) profile_op_sequence(frame, pc, op.size());
+#endif
 	pc += op.size();
-	if (!DISASM)
-		SubType::_eval(eval, frame, op, registers);
-	else
+	if (!DISASM) {
+		if (!SubType::_eval(eval, frame, op, registers)) return NULL;
+	} else
 		WRITEOP_DISASM();
     return pc;
   }
@@ -499,24 +846,53 @@ struct VarArgsOpImpl {
   static f_inline const char* eval(Evaluator* eval, RegisterFrame* frame, const char* pc, Register* registers) {
     VarRegOp& op = *(VarRegOp*) pc;
 	if (!DISASM) log_operation(frame, &op, registers, pc);
+#if PROFILE_OP_SEQUENCES
+	if (!DISASM) profile_op_sequence(frame, pc, op.size());
+#endif
     pc += op.size();
-	if (!DISASM)
-		SubType::_eval(eval, frame, &op, registers);
-	else
+	if (!DISASM) {
+		if (!SubType::_eval(eval, frame, &op, registers)) return NULL;
+	} else
 		WRITEOP_DISASM();
     return pc;
   }
 };
 
+// Every _Py_CheckInterval backward branches, run pending calls (such as
+// signal handlers) and let other threads take the GIL, as ceval does every
+// so many instructions.  Straight-line code always reaches a branch or a
+// call soon, so loops are the only place this is needed.
+static n_inline bool periodic_check() {
+  PyThreadState* tstate = PyThreadState_GET();
+  _Py_Ticker = _Py_CheckInterval;
+  tstate->tick_counter++;
+  if (Py_MakePendingCalls() < 0) {
+    return false;
+  }
+  if (PyEval_ThreadsInitialized()) {
+    PyEval_RestoreThread(PyEval_SaveThread());
+  }
+  if (tstate->async_exc != NULL) {
+    PyObject* exc = tstate->async_exc;
+    tstate->async_exc = NULL;
+    PyErr_SetNone(exc);
+    Py_DECREF(exc);
+    return false;
+  }
+  return true;
+}
+
 template<class OpType, class SubType>
 struct BranchOpImpl {
   template<bool DISASM>
   static f_inline const char* eval(Evaluator* eval, RegisterFrame* frame, const char* pc, Register* registers) {
     OpType& op = *((OpType*) pc);
 	if (!DISASM) log_operation(frame, &op, registers, pc);
-	if (!DISASM)
-		SubType::_eval(eval, frame, op, &pc, registers);
-	else {
+	if (!DISASM) {
+		const char* branch_pc = pc;
+		if (!SubType::_eval(eval, frame, op, &pc, registers)) return NULL;
+		if (pc <= branch_pc && --_Py_Ticker < 0 && !periodic_check()) return NULL;
+	} else {
 		pc += op.size();
 		WRITEOP_DISASM();
 	}
@@ -535,13 +911,88 @@ struct IntegerOps {
   _OP(add, +)
   _OP(sub, -)
   _OP(mul, *)
-  _OP(div, /)
-  _OP(mod, %)
   _OP(Or, |)
   _OP(Xor, ^)
   _OP(And, &)
-  _OP(Rshift, >>)
-  _OP(Lshift, <<)
+
+  // Each operation is paired with a check of whether its result differs
+  // from Python's, in which case the operation is redone on objects.  The
+  // operations themselves must not trap on any input.
+  static f_inline bool add_overflowed(long a, long b, long i) {
+    return OP_OVERFLOWED(a, b, i);
+  }
+
+  static f_inline bool sub_overflowed(long a, long b, long i) {
+    return (a ^ b) < 0 && (a ^ i) < 0;
+  }
+
+  static f_inline bool mul_overflowed(long a, long b, long i) {
+    if (a == 0) {
+      return false;
+    }
+    if ((a == -1 && b == LONG_MIN) || (b == -1 && a == LONG_MIN)) {
+      return true;
+    }
+    return i / a != b;
+  }
+
+  // Python rounds quotients towards negative infinity, and gives the
+  // remainder the sign of the divisor.
+  static f_inline long floor_div(long a, long b) {
+    if (div_overflowed(a, b, 0)) {
+      return 0;
+    }
+    long q = a / b;
+    if (a % b != 0 && ((a < 0) != (b < 0))) {
+      --q;
+    }
+    return q;
+  }
+
+  static f_inline long floor_mod(long a, long b) {
+    if (div_overflowed(a, b, 0)) {
+      return 0;
+    }
+    long r = a % b;
+    if (r != 0 && ((r < 0) != (b < 0))) {
+      r += b;
+    }
+    return r;
+  }
+
+  // Division by zero is left to the object path to raise.
+  static f_inline bool div_overflowed(long a, long b, long i) {
+    return b == 0 || (b == -1 && a == LONG_MIN);
+  }
+
+  static f_inline long Lshift(long a, long b) {
+    return (b < 0 || b >= (long) (8 * sizeof(long))) ? 0 : (long) ((unsigned long) a << b);
+  }
+
+  static f_inline long Rshift(long a, long b) {
+    if (b < 0) {
+      return 0;
+    }
+    return b >= (long) (8 * sizeof(long)) ? (a < 0 ? -1 : 0) : a >> b;
+  }
+
+  // Negative shifts raise ValueError on the object path.
+  static f_inline bool shift_overflowed(long a, long b, long i) {
+    return b < 0;
+  }
+
+  static f_inline bool lshift_overflowed(long a, long b, long i) {
+    return b < 0 || b >= (long) (8 * sizeof(long)) || (i >> b) != a;
+  }
+
+  // The immediate forms check the shift count at compile time.
+  static f_inline long arith_rshift(long a, long b) {
+    return a >> b;
+  }
+
+  static f_inline bool never_overflows(long a, long b, long i) {
+    return false;
+  }
 
   static f_inline PyObject* compare(long a, long b, int arg) {
     switch (arg) {
@@ -570,13 +1021,27 @@ struct IntegerOps {
 };
 
 struct FloatOps {
-  static f_inline PyObject* compare(PyObject* w, PyObject* v, int arg) {
-    if (!PyFloat_CheckExact(v) || !PyFloat_CheckExact(w)) {
+  static f_inline double add(double a, double b) {
+    return a + b;
+  }
+
+  static f_inline double sub(double a, double b) {
+    return a - b;
+  }
+
+  static f_inline double mul(double a, double b) {
+    return a * b;
+  }
+
+  // Both operands must be floats; identity tests are left to the caller,
+  // as an unboxed double has none.
+  static f_inline PyObject* compare(const Register& w, const Register& v, int arg) {
+    if (!w.is_float() || !v.is_float()) {
       return NULL;
     }
 
-    double a = PyFloat_AS_DOUBLE(w);
-    double b = PyFloat_AS_DOUBLE(v);
+    double a = w.as_float();
+    double b = v.as_float();
 
     switch (arg) {
     case PyCmp_LT:
@@ -591,10 +1056,6 @@ struct FloatOps {
       return a > b ? Py_True : Py_False ;
     case PyCmp_GE:
       return a >= b ? Py_True : Py_False ;
-    case PyCmp_IS:
-      return v == w ? Py_True : Py_False ;
-    case PyCmp_IS_NOT:
-      return v != w ? Py_True : Py_False ;
     default:
       return NULL;
     }
@@ -603,72 +1064,182 @@ struct FloatOps {
   }
 };
 
-template<int OpCode, PythonBinaryOp ObjF, IntegerBinaryOp IntegerF, bool CanOverFlow>
+// Loads the operands of a float operation: both floats, or a float and an
+// int, which Python converts to a double the same way.
+static inline f_inline bool load_float_operands(Register& r1, Register& r2, double* a, double* b) {
+  if (r1.is_float()) {
+    *a = r1.as_float();
+  } else if (r1.is_int() && r2.is_float()) {
+    *a = (double) r1.as_int();
+  } else {
+    return false;
+  }
+
+  if (r2.is_float()) {
+    *b = r2.as_float();
+  } else if (r2.is_int()) {
+    *b = (double) r2.as_int();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// The opcode an arithmetic operation is quickened to when both of its
+// operands are floats, or -1 if there is none.
+static inline int float_form(int opcode) {
+  switch (opcode) {
+  case BINARY_ADD: return BINARY_ADD_FLOAT;
+  case BINARY_SUBTRACT: return BINARY_SUBTRACT_FLOAT;
+  case BINARY_MULTIPLY: return BINARY_MULTIPLY_FLOAT;
+  case INPLACE_ADD: return INPLACE_ADD_FLOAT;
+  case INPLACE_SUBTRACT: return INPLACE_SUBTRACT_FLOAT;
+  case INPLACE_MULTIPLY: return INPLACE_MULTIPLY_FLOAT;
+  default: return -1;
+  }
+}
+
+template<int OpCode, PythonBinaryOp ObjF, IntegerBinaryOp IntegerF, IntegerOverflowCheck Overflowed>
 struct BinaryOpWithSpecialization: public RegOpImpl<RegOp<3>,
-    BinaryOpWithSpecialization<OpCode, ObjF, IntegerF, CanOverFlow> > {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+    BinaryOpWithSpecialization<OpCode, ObjF, IntegerF, Overflowed> > {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     Register& r1 = registers[op.reg[0]];
     Register& r2 = registers[op.reg[1]];
 
-    if (r1.get_type() == IntType && r2.get_type() == IntType) {
+    if (r1.is_int() && r2.is_int()) {
       register long a = r1.as_int();
       register long b = r2.as_int();
       register long val = IntegerF(a, b);
-      if (!CanOverFlow || !OP_OVERFLOWED(a, b, val)) {
+      if (!Overflowed(a, b, val)) {
         STORE_REG(op.reg[2], val);
-        return;
+        return true;
       }
     }
 
-    STORE_REG(op.reg[2], ObjF(r1.as_obj(), r2.as_obj()));
+    double fa, fb;
+    if (float_form(OpCode) != -1 && load_float_operands(r1, r2, &fa, &fb)) {
+      frame->code->quicken((const char*) &op, OpCode, float_form(OpCode));
+    }
+    PyObject* res = ObjF(r1.as_obj(), r2.as_obj());
+    if (res == NULL) {
+      return false;
+    }
+    STORE_REG(op.reg[2], res);
+    return true;
   }
 };
 
-template<int OpCode, PythonBinaryOp ObjF>
-struct BinaryOp: public RegOpImpl<RegOp<3>, BinaryOp<OpCode, ObjF> > {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
-    PyObject* r1 = LOAD_OBJ(op.reg[0]);
-    PyObject* r2 = LOAD_OBJ(op.reg[1]);
-    CHECK_VALID(r1);
-    CHECK_VALID(r2);
-    PyObject* r3 = ObjF(r1, r2);
-    STORE_REG(op.reg[2], r3);
+// Quickened form of an arithmetic operation which has only seen floats.
+// A float may also meet an int; anything else rewrites the instruction back
+// to Generic.  The result is stored as a double, which is only boxed
+// without USE_NAN_BOXING.
+template<int OpCode, int Generic, PythonBinaryOp ObjF, FloatBinaryOp FloatF>
+struct BinaryFloatOp: public RegOpImpl<RegOp<3>, BinaryFloatOp<OpCode, Generic, ObjF, FloatF> > {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+    Register& r1 = registers[op.reg[0]];
+    Register& r2 = registers[op.reg[1]];
+
+    double a, b;
+    if (load_float_operands(r1, r2, &a, &b)) {
+      double val = FloatF(a, b);
+      STORE_REG(op.reg[2], val);
+      return true;
+    }
+
+    frame->code->deoptimize((const char*) &op, Generic);
+    PyObject* res = ObjF(r1.as_obj(), r2.as_obj());
+    if (res == NULL) {
+      return false;
+    }
+    STORE_REG(op.reg[2], res);
+    return true;
   }
 };
 
-template<int OpCode, UnaryFunction ObjF>
+// Integer operation with an immediate right operand.  Only the left
+// operand needs a type test; the constant's register is only read if we
+// fall back to the object path.
+template<int OpCode, PythonBinaryOp ObjF, IntegerBinaryOp IntegerF, IntegerOverflowCheck Overflowed>
+struct BinaryOpImm: public RegOpImpl<ImmRegOp, BinaryOpImm<OpCode, ObjF, IntegerF, Overflowed> > {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, ImmRegOp& op, Register* registers) {
+    Register& r1 = registers[op.reg[0]];
+
+    if (r1.is_int()) {
+      register long a = r1.as_int();
+      register long val = IntegerF(a, op.imm);
+      if (!Overflowed(a, op.imm, val)) {
+        STORE_REG(op.reg[2], val);
+        return true;
+      }
+    }
+
+    PyObject* res = ObjF(r1.as_obj(), LOAD_OBJ(op.reg[1]));
+    if (res == NULL) {
+      return false;
+    }
+    STORE_REG(op.reg[2], res);
+    return true;
+  }
+};
+
+template<int OpCode, PythonBinaryOp ObjF>
+struct BinaryOp: public RegOpImpl<RegOp<3>, BinaryOp<OpCode, ObjF> > {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+    PyObject* r1 = LOAD_OBJ(op.reg[0]);
+    PyObject* r2 = LOAD_OBJ(op.reg[1]);
+    CHECK_VALID(r1);
+    CHECK_VALID(r2);
+    PyObject* r3 = ObjF(r1, r2);
+    if (r3 == NULL) {
+      return false;
+    }
+    STORE_REG(op.reg[2], r3);
+    return true;
+  }
+};
+
+template<int OpCode, UnaryFunction ObjF>
 struct UnaryOp: public RegOpImpl<RegOp<2>, UnaryOp<OpCode, ObjF> > {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
     PyObject* r1 = LOAD_OBJ(op.reg[0]);
     CHECK_VALID(r1);
     PyObject* r2 = ObjF(r1);
+    if (r2 == NULL) {
+      return false;
+    }
     STORE_REG(op.reg[1], r2);
+    return true;
   }
 };
 
 struct UnaryNot: public RegOpImpl<RegOp<2>, UnaryNot> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
     PyObject* r1 = LOAD_OBJ(op.reg[0]);
-    PyObject* res = PyObject_IsTrue(r1) ? Py_False : Py_True;
+    int truth = PyObject_IsTrue(r1);
+    if (truth < 0) {
+      return false;
+    }
+    PyObject* res = truth ? Py_False : Py_True;
     Py_INCREF(res);
     STORE_REG(op.reg[1], res);
+    return true;
   }
 };
 
 struct BinaryModulo: public RegOpImpl<RegOp<3>, BinaryModulo> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     Register& r1 = registers[op.reg[0]];
     Register& r2 = registers[op.reg[1]];
 
-    if (r1.get_type() == IntType && r2.get_type() == IntType) {
+    if (r1.is_int() && r2.is_int()) {
       long x = r1.as_int();
       long y = r2.as_int();
       // C's modulo differs from Python's remainder when
       // args can be negative
-      if (x >= 0 && y >= 0) {
+      if (x >= 0 && y > 0) {
         Register& dst = registers[op.reg[2]];
         dst.store<true>(x % y);
-        return;
+        return true;
       }
     }
 
@@ -681,32 +1252,37 @@ struct BinaryModulo: public RegOpImpl<RegOp<3>, BinaryModulo> {
       dst = PyNumber_Remainder(o1, o2);
     }
     if (!dst) {
-      throw RException();
+      return false;
     }
     STORE_REG(op.reg[2], dst);
+    return true;
   }
 };
 
 struct BinaryPower: public RegOpImpl<RegOp<3>, BinaryPower> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* r1 = LOAD_OBJ(op.reg[0]);
     CHECK_VALID(r1);
     PyObject* r2 = LOAD_OBJ(op.reg[1]);
     CHECK_VALID(r2);
     PyObject* r3 = PyNumber_Power(r1, r2, Py_None);
-    CHECK_VALID(r3);
+    if (r3 == NULL) {
+      return false;
+    }
 
     STORE_REG(op.reg[2], r3);
+    return true;
   }
 };
 
 struct BinarySubscr: public RegOpImpl<RegOp<3>, BinarySubscr> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* list = LOAD_OBJ(op.reg[0]);
     Register& key = registers[op.reg[1]];
     CHECK_VALID(list);
     PyObject* res = NULL;
-    if (PyList_CheckExact(list) && key.get_type() == IntType) {
+    if (PyList_CheckExact(list) && key.is_int()) {
+      frame->code->quicken((const char*) &op, BINARY_SUBSCR, BINARY_SUBSCR_LIST);
       Py_ssize_t i = key.as_int();
       if (i < 0) i += PyList_GET_SIZE(list);
       if (i >= 0 && i < PyList_GET_SIZE(list) ) {
@@ -714,28 +1290,38 @@ struct BinarySubscr: public RegOpImpl<RegOp<3>, BinarySubscr> {
         Py_INCREF(res);
         CHECK_VALID(res);
         STORE_REG(op.reg[2], res);
-        return;
+        return true;
       }
+    } else if (PyDict_CheckExact(list)) {
+      frame->code->quicken((const char*) &op, BINARY_SUBSCR, BINARY_SUBSCR_DICT);
     }
 
     res = PyObject_GetItem(list, key.as_obj());
 
     if (!res) {
-      throw RException();
+      return false;
     }
 
     CHECK_VALID(res);
     STORE_REG(op.reg[2], res);
+    return true;
   }
 };
 
+// BINARY_SUBSCR_LIST and BINARY_SUBSCR_DICT are emitted by the compiler when
+// the container type is known, and quickened to from BINARY_SUBSCR otherwise;
+// the type guard only fails in the latter case.
 struct BinarySubscrList: public RegOpImpl<RegOp<3>, BinarySubscrList> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* list = LOAD_OBJ(op.reg[0]);
     Register& key = registers[op.reg[1]];
     CHECK_VALID(list);
+    if (!PyList_CheckExact(list)) {
+      frame->code->deoptimize((const char*) &op, BINARY_SUBSCR);
+      return BinarySubscr::_eval(eval, frame, op, registers);
+    }
     PyObject* res = NULL;
-    if (key.get_type() == IntType) {
+    if (key.is_int()) {
       Py_ssize_t i = key.as_int();
       Py_ssize_t n = PyList_GET_SIZE(list);
       if (i < 0) i += n;
@@ -744,25 +1330,30 @@ struct BinarySubscrList: public RegOpImpl<RegOp<3>, BinarySubscrList> {
         Py_INCREF(res);
         CHECK_VALID(res);
         STORE_REG(op.reg[2], res);
-        return;
+        return true;
       }
     }
     res = PyObject_GetItem(list, key.as_obj());
     if (!res) {
-      throw RException();
+      return false;
     }
     CHECK_VALID(res);
     STORE_REG(op.reg[2], res);
+    return true;
   }
 };
 
 struct BinarySubscrDict: public RegOpImpl<RegOp<3>, BinarySubscrDict> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* dict = LOAD_OBJ(op.reg[0]);
     PyObject* key = LOAD_OBJ(op.reg[1]);
 
     CHECK_VALID(dict);
     CHECK_VALID(key);
+    if (!PyDict_CheckExact(dict)) {
+      frame->code->deoptimize((const char*) &op, BINARY_SUBSCR);
+      return BinarySubscr::_eval(eval, frame, op, registers);
+    }
 
     PyObject* res = PyDict_GetItem(dict, key);
 
@@ -770,28 +1361,30 @@ struct BinarySubscrDict: public RegOpImpl<RegOp<3>, BinarySubscrDict> {
       Py_INCREF(res);
       CHECK_VALID(res);
       STORE_REG(op.reg[2], res);
-      return;
+      return true;
     }
     res = PyObject_GetItem(dict, key);
     if (!res) {
-      throw RException();
+      return false;
     }
     CHECK_VALID(res);
     STORE_REG(op.reg[2], res);
+    return true;
   }
 };
 
 struct InplacePower: public RegOpImpl<RegOp<3>, InplacePower> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* r1 = LOAD_OBJ(op.reg[0]);
     CHECK_VALID(r1);
     PyObject* r2 = LOAD_OBJ(op.reg[1]);
     CHECK_VALID(r2);
     PyObject* r3 = PyNumber_Power(r1, r2, Py_None);
     if (!r3) {
-      throw RException();
+      return false;
     }
     STORE_REG(op.reg[2], r3);
+    return true;
   }
 };
 
@@ -803,7 +1396,7 @@ struct InplacePower: public RegOpImpl<RegOp<3>, InplacePower> {
                          "BaseException is not allowed in 3.x"
 
     /* slow path for comparisons, copied from ceval */
-static f_inline PyObject* cmp_outcome(int op, PyObject *v, PyObject *w) {
+static inline f_inline PyObject* cmp_outcome(int op, PyObject *v, PyObject *w) {
   int res = 0;
   switch (op) {
   case PyCmp_IS:
@@ -882,16 +1475,18 @@ static f_inline PyObject* cmp_outcome(int op, PyObject *v, PyObject *w) {
 }
 
 struct CompareOp: public RegOpImpl<RegOp<3>, CompareOp> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     Register& r1 = registers[op.reg[0]];
     Register& r2 = registers[op.reg[1]];
     PyObject* r3 = NULL;
-    if (r1.get_type() == IntType && r2.get_type() == IntType) {
+    if (r1.is_int() && r2.is_int()) {
       r3 = IntegerOps::compare(r1.as_int(), r2.as_int(), op.arg);
-    } /* else {
-     r3 = FloatOps::compare(r1.as_obj(), r2.as_obj(), op.arg);
-     }
-     */
+    } else {
+      r3 = FloatOps::compare(r1, r2, op.arg);
+      if (r3 != NULL) {
+        frame->code->quicken((const char*) &op, COMPARE_OP, COMPARE_OP_FLOAT);
+      }
+    }
     if (r3 != NULL) {
       Py_INCREF(r3);
     } else {
@@ -899,15 +1494,117 @@ struct CompareOp: public RegOpImpl<RegOp<3>, CompareOp> {
       r3 = cmp_outcome(op.arg, r1.as_obj(), r2.as_obj());
     }
     if (!r3) {
-      throw RException();
+      return false;
+    }
+
+    STORE_REG(op.reg[2], r3);
+    return true;
+  }
+};
+
+struct CompareOpFloat: public RegOpImpl<RegOp<3>, CompareOpFloat> {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+    Register& r1 = registers[op.reg[0]];
+    Register& r2 = registers[op.reg[1]];
+    PyObject* r3 = FloatOps::compare(r1, r2, op.arg);
+    if (r3 == NULL) {
+      frame->code->deoptimize((const char*) &op, COMPARE_OP);
+      return CompareOp::_eval(eval, frame, op, registers);
+    }
+
+    Py_INCREF(r3);
+    STORE_REG(op.reg[2], r3);
+    return true;
+  }
+};
+
+struct CompareOpImm: public RegOpImpl<ImmRegOp, CompareOpImm> {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, ImmRegOp& op, Register* registers) {
+    Register& r1 = registers[op.reg[0]];
+    PyObject* r3 = NULL;
+    if (r1.is_int()) {
+      r3 = IntegerOps::compare(r1.as_int(), op.imm, op.arg);
+    }
+    if (r3 != NULL) {
+      Py_INCREF(r3);
+    } else {
+      r3 = cmp_outcome(op.arg, r1.as_obj(), LOAD_OBJ(op.reg[1]));
+    }
+    if (!r3) {
+      return false;
     }
 
     STORE_REG(op.reg[2], r3);
+    return true;
+  }
+};
+
+// Truth value of the generic comparison path, for compare-and-branch.
+// Returns -1 with an exception set on failure.
+static inline f_inline int compare_truth(int arg, PyObject* v, PyObject* w) {
+  PyObject* r = cmp_outcome(arg, v, w);
+  if (!r) {
+    return -1;
+  }
+  int truth = (r == Py_True) ? 1 : (r == Py_False) ? 0 : PyObject_IsTrue(r);
+  Py_DECREF(r);
+  return truth;
+}
+
+// A comparison whose result is only used by a conditional jump.  Integer
+// and float comparisons branch on the C result directly, without creating
+// (and reference counting) a bool.
+template<bool JumpIfTrue>
+struct CompareAndBranch: public BranchOpImpl<BranchOp<2>, CompareAndBranch<JumpIfTrue> > {
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<2>& op, const char **pc,
+                             Register* registers) {
+    Register& r1 = registers[op.reg[0]];
+    Register& r2 = registers[op.reg[1]];
+    PyObject* r3 = NULL;
+    if (r1.is_int() && r2.is_int()) {
+      r3 = IntegerOps::compare(r1.as_int(), r2.as_int(), op.arg);
+    } else {
+      r3 = FloatOps::compare(r1, r2, op.arg);
+    }
+
+    int truth = (r3 != NULL) ? r3 == Py_True : compare_truth(op.arg, r1.as_obj(), r2.as_obj());
+    if (truth < 0) {
+      return false;
+    }
+    if (truth == JumpIfTrue) {
+      *pc = frame->instructions() + op.label;
+    } else {
+      *pc += sizeof(BranchOp<2>);
+    }
+    return true;
+  }
+};
+
+template<bool JumpIfTrue>
+struct CompareAndBranchImm: public BranchOpImpl<ImmBranchOp, CompareAndBranchImm<JumpIfTrue> > {
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame *frame, ImmBranchOp& op, const char **pc,
+                             Register* registers) {
+    Register& r1 = registers[op.reg[0]];
+    PyObject* r3 = NULL;
+    if (r1.is_int()) {
+      r3 = IntegerOps::compare(r1.as_int(), op.imm, op.arg);
+    }
+
+    int truth = (r3 != NULL) ? r3 == Py_True : compare_truth(op.arg, r1.as_obj(), LOAD_OBJ(op.reg[1]));
+    if (truth < 0) {
+      return false;
+    }
+    if (truth == JumpIfTrue) {
+      *pc = frame->instructions() + op.label;
+    } else {
+      *pc += sizeof(ImmBranchOp);
+    }
+    return true;
   }
 };
 
 struct DictContains: public RegOpImpl<RegOp<3>, DictContains> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* dict = LOAD_OBJ(op.reg[0]);
     CHECK_VALID(dict);
 
@@ -918,17 +1615,18 @@ struct DictContains: public RegOpImpl<RegOp<3>, DictContains> {
     if (result_code == -1) {
       result_code = PySequence_Contains(dict, elt);
       if (result_code == -1) {
-        throw RException();
+        return false;
       }
     }
     PyObject* result = result_code ? Py_True : Py_False;
     Py_INCREF(result);
     STORE_REG(op.reg[2], result);
+    return true;
   }
 };
 
 struct DictGet: public RegOpImpl<RegOp<3>, DictGet> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* dict = LOAD_OBJ(op.reg[0]);
     CHECK_VALID(dict);
 
@@ -941,11 +1639,12 @@ struct DictGet: public RegOpImpl<RegOp<3>, DictGet> {
     }
     Py_INCREF(result);
     STORE_REG(op.reg[2], result);
+    return true;
   }
 };
 
 struct DictGetDefault: public RegOpImpl<RegOp<4>, DictGetDefault> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<4>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<4>& op, Register* registers) {
     PyObject* dict = LOAD_OBJ(op.reg[0]);
     CHECK_VALID(dict);
 
@@ -958,66 +1657,49 @@ struct DictGetDefault: public RegOpImpl<RegOp<4>, DictGetDefault> {
     }
     Py_INCREF(result);
     STORE_REG(op.reg[3], result);
+    return true;
   }
 };
 
 struct IncRef: public RegOpImpl<RegOp<1>, IncRef> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
-    CHECK_VALID(LOAD_OBJ(op.reg[0]));
-    Py_INCREF(LOAD_OBJ(op.reg[0]));
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+    registers[op.reg[0]].incref();
+    return true;
   }
 };
 
 struct DecRef: public RegOpImpl<RegOp<1>, DecRef> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
-    CHECK_VALID(LOAD_OBJ(op.reg[0]));
-    Py_DECREF(LOAD_OBJ(op.reg[0]));
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+    registers[op.reg[0]].decref();
+    return true;
   }
 };
 
 struct LoadLocals: public RegOpImpl<RegOp<1>, LoadLocals> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
     Py_INCREF(frame->locals());
     STORE_REG(op.reg[0], frame->locals());
-  }
-};
-
-struct LoadGlobal: public RegOpImpl<RegOp<1>, LoadGlobal> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
-    PyObject* key = PyTuple_GET_ITEM(frame->names(), op.arg) ;
-    PyObject* value = PyDict_GetItem(frame->globals(), key);
-    if (value != NULL) {
-      Py_INCREF(value);
-      STORE_REG(op.reg[0], value);
-      return;
-    }
-    value = PyDict_GetItem(frame->builtins(), key);
-    if (value != NULL) {
-      Py_INCREF(value);
-      STORE_REG(op.reg[0], value);
-      return;
-    }
-    throw RException(PyExc_NameError, "Global name %.200s not defined.", obj_to_str(key));
+    return true;
   }
 };
 
 struct StoreGlobal: public RegOpImpl<RegOp<1>, StoreGlobal> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
     PyObject* key = PyTuple_GET_ITEM(frame->names(), op.arg) ;
     PyObject* val = LOAD_OBJ(op.reg[0]);
-    PyDict_SetItem(frame->globals(), key, val);
+    return PyDict_SetItem(frame->globals(), key, val) == 0;
   }
 };
 
 struct DeleteGlobal: public RegOpImpl<RegOp<0>, DeleteGlobal> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<0>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<0>& op, Register* registers) {
     PyObject* key = PyTuple_GET_ITEM(frame->names(), op.arg) ;
-    PyDict_DelItem(frame->globals(), key);
+    return PyDict_DelItem(frame->globals(), key) == 0;
   }
 };
 
 struct LoadName: public RegOpImpl<RegOp<1>, LoadName> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
     PyObject* r1 = PyTuple_GET_ITEM(frame->names(), op.arg) ;
     PyObject* r2 = PyDict_GetItem(frame->locals(), r1);
     if (r2 == NULL) {
@@ -1027,57 +1709,46 @@ struct LoadName: public RegOpImpl<RegOp<1>, LoadName> {
       r2 = PyDict_GetItem(frame->builtins(), r1);
     }
     if (r2 == NULL) {
-      throw RException(PyExc_NameError, "Name %.200s not defined.", obj_to_str(r1));
+      PyErr_Format(PyExc_NameError, "Name %.200s not defined.", obj_to_str(r1));
+      return false;
     }
     Py_INCREF(r2);
     STORE_REG(op.reg[0], r2);
+    return true;
   }
 };
 
 struct StoreName: public RegOpImpl<RegOp<1>, StoreName> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
     PyObject* r1 = PyTuple_GET_ITEM(frame->names(), op.arg) ;
     PyObject* r2 = LOAD_OBJ(op.reg[0]);
     CHECK_VALID(r1);
     CHECK_VALID(r2);
-    PyObject_SetItem(frame->locals(), r1, r2);
+    return PyObject_SetItem(frame->locals(), r1, r2) == 0;
   }
 };
 
 struct DeleteName: public RegOpImpl<RegOp<0>, DeleteName> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<0>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<0>& op, Register* registers) {
     PyObject* key = PyTuple_GET_ITEM(frame->names(), op.arg) ;
-    PyObject_DelItem(frame->locals(), key);
+    return PyObject_DelItem(frame->locals(), key) == 0;
   }
 };
 
 // LOAD_FAST and STORE_FAST both perform the same operation in the register VM.
 struct LoadFast: public RegOpImpl<RegOp<2>, LoadFast> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
     Register& a = registers[op.reg[0]];
     Register& b = registers[op.reg[1]];
     a.incref();
     b.store<true>(a);
+    return true;
   }
 };
 typedef LoadFast StoreFast;
 
-struct StoreAttr: public RegOpImpl<RegOp<2>, StoreAttr> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
-    PyObject* obj = LOAD_OBJ(op.reg[0]);
-    PyObject* key = PyTuple_GET_ITEM(frame->names(), op.arg);
-    PyObject* value = LOAD_OBJ(op.reg[1]);
-    CHECK_VALID(obj);
-    CHECK_VALID(key);
-    CHECK_VALID(value);
-    if (PyObject_SetAttr(obj, key, value) != 0) {
-      throw RException();
-    }
-  }
-};
-
 struct StoreSubscr: public RegOpImpl<RegOp<3>, StoreSubscr> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* key = LOAD_OBJ(op.reg[0]);
     PyObject* list = LOAD_OBJ(op.reg[1]);
     PyObject* value = LOAD_OBJ(op.reg[2]);
@@ -1085,35 +1756,38 @@ struct StoreSubscr: public RegOpImpl<RegOp<3>, StoreSubscr> {
     CHECK_VALID(list);
     CHECK_VALID(value);
     if (PyObject_SetItem(list, key, value) != 0) {
-      throw RException();
+      return false;
     }
+    return true;
   }
 };
 
 struct StoreSubscrList: public RegOpImpl<RegOp<3>, StoreSubscrList> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* list = LOAD_OBJ(op.reg[1]);
     PyObject* value = LOAD_OBJ(op.reg[2]);
     CHECK_VALID(list);
     CHECK_VALID(value);
     Register& idx_reg = registers[op.reg[0]];
-    if (idx_reg.get_type() != IntType) {
-      PyObject* idx_obj = LOAD_OBJ(op.reg[0]);
-      CHECK_VALID(idx_obj);
-      if (PyObject_SetItem(list, idx_obj, value) != 0) {
-        throw RException();
-      }
-    } else {
+    if (PyList_CheckExact(list) && idx_reg.is_int()) {
       Py_ssize_t idx = idx_reg.as_int();
-      if (PyList_SetItem(list, idx, value) != 0) {
-        throw RException();
+      Py_ssize_t n = PyList_GET_SIZE(list);
+      if (idx < 0) idx += n;
+      if (idx >= 0 && idx < n) {
+        // The register keeps its reference; the list takes a new one.
+        PyObject* old = PyList_GET_ITEM(list, idx);
+        Py_INCREF(value);
+        PyList_SET_ITEM(list, idx, value);
+        Py_DECREF(old);
+        return true;
       }
     }
+    return PyObject_SetItem(list, idx_reg.as_obj(), value) == 0;
   }
 };
 
 struct StoreSubscrDict: public RegOpImpl<RegOp<3>, StoreSubscrDict> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* key = LOAD_OBJ(op.reg[0]);
     PyObject* list = LOAD_OBJ(op.reg[1]);
     PyObject* value = LOAD_OBJ(op.reg[2]);
@@ -1121,8 +1795,9 @@ struct StoreSubscrDict: public RegOpImpl<RegOp<3>, StoreSubscrDict> {
     CHECK_VALID(list);
     CHECK_VALID(value);
     if (PyDict_SetItem(list, key, value) != 0) {
-      throw RException();
+      return false;
     }
+    return true;
   }
 };
 
@@ -1151,32 +1826,53 @@ static int assign_slice(PyObject *u, PyObject *v, PyObject *w, PyObject *x) {
 }
 
 struct StoreSlice: public RegOpImpl<RegOp<4>, StoreSlice> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<4>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<4>& op, Register* registers) {
     PyObject* list = LOAD_OBJ(op.reg[0]);
     PyObject* left = op.reg[1] != kInvalidRegister ? LOAD_OBJ(op.reg[1]) : NULL;
     PyObject* right = op.reg[2] != kInvalidRegister ? LOAD_OBJ(op.reg[2]) : NULL;
     PyObject* value = LOAD_OBJ(op.reg[3]);
     if (assign_slice(list, left, right, value) != 0) {
-      throw RException();
+      return false;
     }
+    return true;
   }
 };
 
 struct ConstIndex: public RegOpImpl<RegOp<2>, ConstIndex> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
     PyObject* list = LOAD_OBJ(op.reg[0]);
 	assert(op.arg <= UINT8_MAX);
     uint8_t key = (uint8_t)op.arg;
     if (op.reg[1] == kInvalidRegister) {
-      return;
+      return true;
+    }
+
+    // The index is an immediate: unpacking a tuple or list needs no
+    // boxed key.
+    PyObject* item = NULL;
+    if (PyTuple_CheckExact(list) && key < PyTuple_GET_SIZE(list)) {
+      item = PyTuple_GET_ITEM(list, key);
+    } else if (PyList_CheckExact(list) && key < PyList_GET_SIZE(list)) {
+      item = PyList_GET_ITEM(list, key);
+    }
+    if (item != NULL) {
+      Py_INCREF(item);
+      STORE_REG(op.reg[1], item);
+      return true;
     }
 
     PyObject* pykey = PyInt_FromLong(key);
-    STORE_REG(op.reg[1], PyObject_GetItem(list, pykey));
+    item = PyObject_GetItem(list, pykey);
     Py_DECREF(pykey);
+    if (item == NULL) {
+      return false;
+    }
+    STORE_REG(op.reg[1], item);
+    return true;
   }
 };
 
+#if GETATTR_HINTS
 static PyDictObject* obj_getdictptr(PyObject* obj, PyTypeObject* type) {
   Py_ssize_t dictoffset;
   PyObject **dictptr;
@@ -1216,169 +1912,408 @@ static size_t dict_getoffset(PyDictObject* dict, PyObject* key) {
   return pos - dict->ma_table;
 }
 
-// LOAD_ATTR is common enough to warrant inlining some common code.
-// Most of this is taken from _PyObject_GenericGetAttrWithDict
-static PyObject * obj_getattr(Evaluator* eval, RegOp<2>& op, PyObject *obj, PyObject *name) {
-  PyObjHelper<PyTypeObject*> type(Py_TYPE(obj) );
-  PyObjHelper<PyDictObject*> dict(obj_getdictptr(obj, type));
-  PyObject *descr = NULL;
-#if GETATTR_HINTS
-  const Hint &op_hint = eval->hints[op.hint_pos];
+// The value cached for a LOAD_GLOBAL, or NULL if the cache is stale.
+static inline f_inline PyObject* global_cache_get(const GlobalCache& cache, PyDictObject* globals,
+                                           PyDictObject* builtins, PyObject* key) {
+  PyDictObject* dict = cache.dict;
+  if ((dict != globals && dict != builtins) || dict->ma_table != cache.table || cache.index > dict->ma_mask) {
+    return NULL;
+  }
 
-  // A hint for an instance dictionary lookup.
-  if (dict.val_ && op_hint.guard.dict_size == dict->ma_mask) {
-    const PyDictEntry &e(dict->ma_table[op_hint.version]);
-    if (e.me_key == name) {
-      Py_INCREF(e.me_value);
-      return e.me_value;
-    }
+  const PyDictEntry& e = dict->ma_table[cache.index];
+  if (e.me_key != key || e.me_value == NULL) {
+    return NULL;
   }
-#endif
 
-  if (!PyString_Check(name)) {
-    throw RException(PyExc_SystemError, "attribute name must be string, not '%.200s'", Py_TYPE(name) ->tp_name);
+  // A builtin is only valid while the globals don't shadow it.  If the
+  // first slot probed for the name is empty the name can't be there;
+  // otherwise we have to look.
+  if (dict != globals) {
+    long hash = ((PyStringObject*) key)->ob_shash;
+    if (hash == -1 || globals->ma_table[hash & globals->ma_mask].me_key != NULL) {
+      if (PyDict_GetItem((PyObject*) globals, key) != NULL) {
+        return NULL;
+      }
+    }
   }
+  return e.me_value;
+}
+
+static inline f_inline void global_cache_fill(GlobalCache& cache, PyDictObject* dict, PyObject* key) {
+  cache.dict = dict;
+  cache.table = dict->ma_table;
+  cache.index = dict_getoffset(dict, key);
+}
 
+// Look the attribute up on the type and record the result in the next
+// entry of the cache.  Returns NULL if the type can't be cached.
+static AttrCacheEntry* attr_cache_fill(AttrCache& cache, PyTypeObject* type, PyObject* name) {
   if (type->tp_dict == NULL) {
     if (PyType_Ready(type) < 0) {
-      throw RException();
+      // The generic path will raise the error again.
+      PyErr_Clear();
+      return NULL;
     }
   }
 
-  // A hint for a type dictionary lookup, we've cached the 'descr' object.
-//  if (op_hint.guard.obj == type && op_hint.key == name && op_hint.version == type->tp_version_tag) {
-//    descr = op_hint.value;
-//  } else {
-  descr = _PyType_Lookup(type, name);
-//  }
+  // This also assigns the type a version tag, if it can have one.
+  PyObject* descr = _PyType_Lookup(type, name);
+  if (!PyType_HasFeature(type, Py_TPFLAGS_VALID_VERSION_TAG)) {
+    return NULL;
+  }
 
-  descrgetfunc getter = NULL;
+  AttrCacheEntry& e = cache.entries[cache.next];
+  cache.next = (cache.next + 1) % kAttrCacheEntries;
+
+  e.type = type;
+  e.version = type->tp_version_tag;
+  e.descr = descr;
+  e.getter = NULL;
   if (descr != NULL && PyType_HasFeature(descr->ob_type, Py_TPFLAGS_HAVE_CLASS)) {
-    getter = descr->ob_type->tp_descr_get;
-    if (getter != NULL && PyDescr_IsData(descr)) {
-      return getter(descr, obj, (PyObject*) type);
+    e.getter = descr->ob_type->tp_descr_get;
+  }
+  e.data_descr = descr != NULL && PyType_HasFeature(descr->ob_type, Py_TPFLAGS_HAVE_CLASS) &&
+      PyDescr_IsData(descr);
+  e.dict_index = 0;
+  return &e;
+}
+
+// The cache entry for type, filling one if needed.  Returns NULL if the
+// type can't be cached.
+static inline f_inline AttrCacheEntry* attr_cache_lookup(AttrCache& cache, PyTypeObject* type, PyObject* name) {
+  if (PyType_HasFeature(type, Py_TPFLAGS_VALID_VERSION_TAG)) {
+    for (int i = 0; i < kAttrCacheEntries; ++i) {
+      AttrCacheEntry& entry = cache.entries[i];
+      if (entry.type == type && entry.version == type->tp_version_tag) {
+        return &entry;
+      }
     }
   }
+  return attr_cache_fill(cache, type, name);
+}
+
+// LOAD_ATTR is common enough to warrant inlining some common code.
+// This follows _PyObject_GenericGetAttrWithDict, with the type lookup
+// cached per instruction.  Returns NULL with an exception set on failure.
+static inline f_inline PyObject* obj_getattr(AttrCache& cache, PyObject *obj, PyObject *name) {
+  PyTypeObject* type = Py_TYPE(obj);
+  if (type->tp_getattro != PyObject_GenericGetAttr || !PyString_CheckExact(name)) {
+    return PyObject_GetAttr(obj, name);
+  }
+
+  AttrCacheEntry* e = attr_cache_lookup(cache, type, name);
+  if (e == NULL) {
+    return PyObject_GetAttr(obj, name);
+  }
+
+  if (e->data_descr && e->getter != NULL) {
+    return e->getter(e->descr, obj, (PyObject*) type);
+  }
 
-  // Look for a match in our object dictionary
+  PyDictObject* dict = obj_getdictptr(obj, type);
   if (dict != NULL) {
-    PyObject* res = PyDict_GetItem(dict, name);
-    // We found a match.  Create a hint for where to look next time.
+    if (e->dict_index <= dict->ma_mask) {
+      const PyDictEntry& de = dict->ma_table[e->dict_index];
+      if (de.me_key == name && de.me_value != NULL) {
+        Py_INCREF(de.me_value);
+        return de.me_value;
+      }
+    }
+
+    PyObject* res = PyDict_GetItem((PyObject*) dict, name);
     if (res != NULL) {
-#if GETATTR_HINTS
-      HintOffset hint_pos = (HintOffset)hint_offset(type, name);
-      size_t dict_pos = dict_getoffset(dict, name);
-
-      Hint h;
-      h.guard.dict_size = dict->ma_mask;
-      h.key = name;
-      h.value = type;
-      h.version = dict_pos;
-      eval->hints[hint_pos] = h;
-      op.hint_pos = hint_pos;
-#endif
+      e->dict_index = dict_getoffset(dict, name);
       Py_INCREF(res);
       return res;
     }
   }
 
-  // Instance dictionary lookup failed, try to find a match in the class hierarchy.
-  if (getter != NULL) {
-    PyObject* res = getter(descr, obj, (PyObject*) type);
-    if (res != NULL) {
-//      size_t hint_pos = hint_offset(type, name);
-//      Hint h;
-//      h.guard.obj = type;
-//      h.key = name;
-//      h.value = descr;
-//      h.version = type->tp_version_tag;
-//      eval->hints[hint_pos] = h;
-//      op.hint_pos = hint_pos;
+  if (e->getter != NULL) {
+    return e->getter(e->descr, obj, (PyObject*) type);
+  }
 
-      return res;
+  if (e->descr != NULL) {
+    Py_INCREF(e->descr);
+    return e->descr;
+  }
+
+  // Raise the usual AttributeError.
+  return PyObject_GetAttr(obj, name);
+}
+
+// As obj_getattr, for PyObject_GenericSetAttr.  When the attribute is
+// already in the instance dictionary, the value is replaced in place.
+// Returns -1 with an exception set on failure.
+static inline f_inline int obj_setattr(AttrCache& cache, PyObject* obj, PyObject* name, PyObject* value) {
+  PyTypeObject* type = Py_TYPE(obj);
+  if (type->tp_setattro != PyObject_GenericSetAttr || !PyString_CheckExact(name)) {
+    return PyObject_SetAttr(obj, name, value);
+  }
+
+  AttrCacheEntry* e = attr_cache_lookup(cache, type, name);
+  if (e == NULL) {
+    return PyObject_SetAttr(obj, name, value);
+  }
+
+  if (e->data_descr) {
+    return e->descr->ob_type->tp_descr_set(e->descr, obj, value);
+  }
+
+  PyDictObject* dict = obj_getdictptr(obj, type);
+  if (dict == NULL) {
+    // Let the generic path create the dictionary, or raise.
+    return PyObject_SetAttr(obj, name, value);
+  }
+
+  if (e->dict_index <= dict->ma_mask) {
+    PyDictEntry& de = dict->ma_table[e->dict_index];
+    if (de.me_key == name && de.me_value != NULL) {
+      PyObject* old = de.me_value;
+      Py_INCREF(value);
+      de.me_value = value;
+      Py_DECREF(old);
+      return 0;
     }
   }
 
-  if (descr != NULL) {
-    return descr;
+  if (PyDict_SetItem((PyObject*) dict, name, value) != 0) {
+    return -1;
   }
+  e->dict_index = dict_getoffset(dict, name);
+  return 0;
+}
 
-  throw RException(PyExc_AttributeError, "'%.50s' object has no attribute '%.400s'", type->tp_name,
-                   PyString_AS_STRING(name) );
+// As obj_getattr, but a plain function found on the type is returned
+// without binding it to obj, and unbound is set: the caller passes obj as
+// the first argument instead of allocating a bound method.
+static inline f_inline PyObject* obj_getmethod(AttrCache& cache, PyObject* obj, PyObject* name, bool* unbound) {
+  PyTypeObject* type = Py_TYPE(obj);
+  if (type->tp_getattro == PyObject_GenericGetAttr && PyString_CheckExact(name)) {
+    AttrCacheEntry* e = attr_cache_lookup(cache, type, name);
+    if (e != NULL && e->descr != NULL && Py_TYPE(e->descr) == &PyFunction_Type) {
+      // An instance attribute of the same name shadows the function.
+      PyDictObject* dict = obj_getdictptr(obj, type);
+      if (dict == NULL || PyDict_GetItem((PyObject*) dict, name) == NULL) {
+        *unbound = true;
+        Py_INCREF(e->descr);
+        return e->descr;
+      }
+    }
+  }
+  return obj_getattr(cache, obj, name);
 }
+#endif
 
 struct LoadAttr: public RegOpImpl<RegOp<2>, LoadAttr> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
     PyObject* obj = LOAD_OBJ(op.reg[0]);
     PyObject* name = PyTuple_GET_ITEM(frame->names(), op.arg);
-    //PyObject* res = obj_getattr(eval, op, obj, name);
-	PyObject* res = PyObject_GetAttr(obj, name);
+    if (PyModule_CheckExact(obj)) {
+      frame->code->quicken((const char*) &op, LOAD_ATTR, LOAD_ATTR_MODULE);
+    }
+#if GETATTR_HINTS
+    PyObject* res = op.hint_pos != kInvalidHint ?
+        obj_getattr(frame->code->attr_caches[op.hint_pos], obj, name) : PyObject_GetAttr(obj, name);
+#else
+    PyObject* res = PyObject_GetAttr(obj, name);
+#endif
+    if (res == NULL) {
+      return false;
+    }
     STORE_REG(op.reg[1], res);
+    return true;
   }
 };
 
-struct LoadDeref: public RegOpImpl<RegOp<1>, LoadDeref> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
-    PyObject* closure_cell = frame->freevars[op.arg];
-    PyObject* closure_value = PyCell_Get(closure_cell);
-    STORE_REG(op.reg[0], closure_value);
-    Py_INCREF(closure_value);
+struct LoadGlobal: public RegOpImpl<RegOp<1>, LoadGlobal> {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+    PyObject* key = PyTuple_GET_ITEM(frame->names(), op.arg) ;
+#if GETATTR_HINTS
+    GlobalCache* cache = NULL;
+    if (op.hint_pos != kInvalidHint) {
+      cache = &frame->code->global_caches[op.hint_pos];
+      PyObject* value = global_cache_get(*cache, (PyDictObject*) frame->globals(),
+                                         (PyDictObject*) frame->builtins(), key);
+      if (value != NULL) {
+        Py_INCREF(value);
+        STORE_REG(op.reg[0], value);
+        return true;
+      }
+    }
+#endif
+    PyObject* value = PyDict_GetItem(frame->globals(), key);
+    if (value != NULL) {
+#if GETATTR_HINTS
+      if (cache != NULL) global_cache_fill(*cache, (PyDictObject*) frame->globals(), key);
+#endif
+      Py_INCREF(value);
+      STORE_REG(op.reg[0], value);
+      return true;
+    }
+    value = PyDict_GetItem(frame->builtins(), key);
+    if (value != NULL) {
+#if GETATTR_HINTS
+      if (cache != NULL) global_cache_fill(*cache, (PyDictObject*) frame->builtins(), key);
+#endif
+      Py_INCREF(value);
+      STORE_REG(op.reg[0], value);
+      return true;
+    }
+    PyErr_Format(PyExc_NameError, "Global name %.200s not defined.", obj_to_str(key));
+    return false;
   }
 };
 
-struct StoreDeref: public RegOpImpl<RegOp<1>, StoreDeref> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
-    PyObject* value = LOAD_OBJ(op.reg[0]);
-    PyObject* dest_cell = frame->freevars[op.arg];
-    PyCell_Set(dest_cell, value);
+struct StoreAttr: public RegOpImpl<RegOp<2>, StoreAttr> {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+    PyObject* obj = LOAD_OBJ(op.reg[0]);
+    PyObject* key = PyTuple_GET_ITEM(frame->names(), op.arg);
+    PyObject* value = LOAD_OBJ(op.reg[1]);
+    CHECK_VALID(obj);
+    CHECK_VALID(key);
+    CHECK_VALID(value);
+#if GETATTR_HINTS
+    int res = op.hint_pos != kInvalidHint ?
+        obj_setattr(frame->code->attr_caches[op.hint_pos], obj, key, value) : PyObject_SetAttr(obj, key, value);
+#else
+    int res = PyObject_SetAttr(obj, key, value);
+#endif
+    if (res != 0) {
+      return false;
+    }
+    return true;
   }
 };
 
-struct LoadClosure: public RegOpImpl<RegOp<1>, LoadClosure> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
-    PyObject* closure_cell = frame->freevars[op.arg];
-    Py_INCREF(closure_cell);
-    STORE_REG(op.reg[0], closure_cell);
-  }
-};
+// Quickened LOAD_ATTR for module attributes (math.sqrt, ...), which reads
+// the module dictionary directly.
+struct LoadAttrModule: public RegOpImpl<RegOp<2>, LoadAttrModule> {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+    PyObject* obj = LOAD_OBJ(op.reg[0]);
+    if (!PyModule_CheckExact(obj)) {
+      frame->code->deoptimize((const char*) &op, LOAD_ATTR);
+      return LoadAttr::_eval(eval, frame, op, registers);
+    }
 
-struct MakeFunction: public VarArgsOpImpl<MakeFunction> {
-  static f_inline void _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
-    PyObject* code = LOAD_OBJ(op->reg[0]);
-    PyObject* func = PyFunction_New(code, frame->globals());
-    PyObject* defaults = PyTuple_New(op->arg);
-    for (int i = 0; i < op->arg; ++i) {
-      PyTuple_SetItem(defaults, i, LOAD_OBJ(op->reg[i + 1]));
+    PyObject* name = PyTuple_GET_ITEM(frame->names(), op.arg);
+    PyObject* res = PyDict_GetItem(PyModule_GetDict(obj), name);
+    if (res == NULL) {
+      return LoadAttr::_eval(eval, frame, op, registers);
     }
-    PyFunction_SetDefaults(func, defaults);
-    STORE_REG(op->reg[op->arg + 1], func);
+    Py_INCREF(res);
+    STORE_REG(op.reg[1], res);
+    return true;
   }
 };
 
-struct MakeClosure: public VarArgsOpImpl<MakeClosure> {
-  static f_inline void _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
-    // first register argument is the code object
-    // second is the closure args tuple
-    // rest of the registers are default argument values
+// LOAD_ATTR whose result is only called (see FuseMethodCalls).  Methods
+// defined in Python are left unbound, and the following CALL_METHOD passes
+// the object as the first argument.
+struct LoadMethod: public RegOpImpl<RegOp<2>, LoadMethod> {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+    PyObject* obj = LOAD_OBJ(op.reg[0]);
+    PyObject* name = PyTuple_GET_ITEM(frame->names(), op.arg);
+    bool unbound = false;
+#if GETATTR_HINTS
+    PyObject* res = op.hint_pos != kInvalidHint ?
+        obj_getmethod(frame->code->attr_caches[op.hint_pos], obj, name, &unbound) : PyObject_GetAttr(obj, name);
+#else
+    PyObject* res = PyObject_GetAttr(obj, name);
+#endif
+    if (res == NULL) {
+      return false;
+    }
+    frame->set_unbound_method(op.reg[1], unbound);
+    STORE_REG(op.reg[1], res);
+    return true;
+  }
+};
+
+struct LoadDeref: public RegOpImpl<RegOp<1>, LoadDeref> {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+    PyObject* closure_cell = frame->freevars[op.arg];
+    PyObject* closure_value = PyCell_GET(closure_cell);
+    if (closure_value == NULL) {
+      PyErr_Format(PyExc_NameError, "free variable referenced before assignment in enclosing scope");
+      return false;
+    }
+    Py_INCREF(closure_value);
+    STORE_REG(op.reg[0], closure_value);
+    return true;
+  }
+};
+
+struct StoreDeref: public RegOpImpl<RegOp<1>, StoreDeref> {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+    PyObject* value = LOAD_OBJ(op.reg[0]);
+    PyObject* dest_cell = frame->freevars[op.arg];
+    PyCell_Set(dest_cell, value);
+    return true;
+  }
+};
+
+struct LoadClosure: public RegOpImpl<RegOp<1>, LoadClosure> {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+    PyObject* closure_cell = frame->freevars[op.arg];
+    Py_INCREF(closure_cell);
+    STORE_REG(op.reg[0], closure_cell);
+    return true;
+  }
+};
+
+struct MakeFunction: public VarArgsOpImpl<MakeFunction> {
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
+    PyObject* code = LOAD_OBJ(op->reg[0]);
+    PyObject* func = PyFunction_New(code, frame->globals());
+    if (func == NULL) {
+      return false;
+    }
+    if (op->arg > 0) {
+      PyObject* defaults = PyTuple_New(op->arg);
+      for (int i = 0; i < op->arg; ++i) {
+        PyObject* val = LOAD_OBJ(op->reg[i + 1]);
+        Py_INCREF(val);
+        PyTuple_SET_ITEM(defaults, i, val);
+      }
+      PyFunction_SetDefaults(func, defaults);
+      Py_DECREF(defaults);
+    }
+    STORE_REG(op->reg[op->arg + 1], func);
+    return true;
+  }
+};
+
+struct MakeClosure: public VarArgsOpImpl<MakeClosure> {
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
+    // first register argument is the code object
+    // second is the closure args tuple
+    // rest of the registers are default argument values
     PyObject* code = LOAD_OBJ(op->reg[0]);
     PyObject* func = PyFunction_New(code, frame->globals());
+    if (func == NULL) {
+      return false;
+    }
     PyObject* closure_values = LOAD_OBJ(op->reg[1]);
     PyFunction_SetClosure(func, closure_values);
 
-    PyObject* defaults = PyTuple_New(op->arg);
-    for (int i = 0; i < op->arg; ++i) {
-      PyObject* val = LOAD_OBJ(op->reg[i + 2]);
-      Py_INCREF(val);
-      PyTuple_SetItem(defaults, i, val);
+    if (op->arg > 0) {
+      PyObject* defaults = PyTuple_New(op->arg);
+      for (int i = 0; i < op->arg; ++i) {
+        PyObject* val = LOAD_OBJ(op->reg[i + 2]);
+        Py_INCREF(val);
+        PyTuple_SET_ITEM(defaults, i, val);
+      }
+      PyFunction_SetDefaults(func, defaults);
+      Py_DECREF(defaults);
     }
-    PyFunction_SetDefaults(func, defaults);
     STORE_REG(op->reg[op->arg + 2], func);
+    return true;
   }
 };
 
 template<bool HasVarArgs, bool HasKwDict>
 struct CallFunction_Old: public VarArgsOpImpl<CallFunction_Old<HasVarArgs, HasKwDict> > {
-  static f_inline void _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
     int na = op->arg & 0xff;
     int nk = (op->arg >> 8) & 0xff;
     int n = nk * 2 + na;
@@ -1395,11 +2330,11 @@ struct CallFunction_Old: public VarArgsOpImpl<CallFunction_Old<HasVarArgs, HasKw
     RegisterCode* code = NULL;
 
     /* TODO:
-     *   Actually accelerate object construction in Falcon by
-     *   first creating the raw/unitialized object and then
-     *   compiling the __init__ method of the called class.
+     *   Object construction is accelerated by CallFunction, which
+     *   allocates the object and runs its compiled __init__ directly
+     *   (see call_class).
      *
-     *   To actually get a performance gain from this we would need
+     *   To get a larger performance gain from this we would need
      *   special instance dictionaries which store Falcon registers
      *   and only lazily construct PyObject representations when asked
      *   by other Python C API code.
@@ -1447,26 +2382,334 @@ struct CallFunction_Old: public VarArgsOpImpl<CallFunction_Old<HasVarArgs, HasKw
       Py_DECREF(args);
 
       if (res == NULL) {
-        throw RException();
+        return false;
       }
 
       STORE_REG(dst, res);
     } else {
 //      Log_Info("Native call");
-      ObjVector args, kw;
+      ObjVector args;
       args.resize(na);
       for (register int i = 0; i < na; ++i) {
         args[i].store(registers[op->reg[i + 1]]);
       }
-      RegisterFrame f(code, fn, args, kw);
-      STORE_REG(dst, eval->eval(&f));
+      RegisterFrame f(code, fn, args, na, NoKeywords());
+      Register res = eval->eval(&f);
+      if (res.is_null()) {
+        return false;
+      }
+      STORE_REG(dst, res);
     }
+    return true;
   }
 };
 
+// The code of fn if it can be called directly: a plain function already
+// compiled by Falcon.  NULL otherwise.  Generator functions are compiled
+// on their first call here: other functions are compiled when CPython
+// first runs them, but generator frames are left to CPython (see
+// EvalFrame).
+static inline f_inline RegisterCode* direct_callee(Evaluator* eval, PyObject* fn) {
+  if (!PyFunction_Check(fn)) {
+    return NULL;
+  }
+  PyCodeObject* co = (PyCodeObject*) PyFunction_GET_CODE(fn);
+  if (co->co_flags & CO_GENERATOR) {
+    return eval->compiler->compile(fn);
+  }
+  return eval->compiler->lookup(fn);
+}
+
+// Calls generator code: the frame is made on the heap, and left to a
+// generator to run.
+template<class ArgList, class KwList>
+static n_inline Register start_generator(Evaluator* eval, RegisterCode* code, PyObject* fn, const ArgList& args,
+                                         int na, const KwList& kw) {
+  RegisterFrame* frame;
+  try {
+    frame = new RegisterFrame(code, fn, args, na, kw);
+  } catch (const RException& error) {
+    if (error.exception != NULL && !PyErr_Occurred()) {
+      PyErr_SetObject(error.exception, error.value);
+    }
+    return Register((PyObject*) NULL);
+  }
+  frame->move_registers_to_heap();
+  return Register(new_generator(eval, frame));
+}
+
+// Runs a function returned by direct_callee.  The callee's frame is
+// filled straight from the argument lists, so there is no argument
+// tuple or Python frame, and tagged values are passed without boxing.
+// Returns the result, or a null register if the call raised.
+template<class ArgList, class KwList>
+static n_inline Register call_code(Evaluator* eval, RegisterCode* code, PyObject* fn, const ArgList& args, int na,
+                                   const KwList& kw) {
+  if (code->generator) {
+    return start_generator(eval, code, fn, args, na, kw);
+  }
+  if (Py_EnterRecursiveCall((char*) " while calling a Python object")) {
+    return Register((PyObject*) NULL);
+  }
+  Register res;
+  try {
+    RegisterFrame f(code, fn, args, na, kw);
+    res = eval->eval(&f);
+  } catch (const RException& error) {
+    // The arguments don't fit the callee.  This is an error of the call,
+    // which the caller's except clauses can catch.
+    if (error.exception != NULL && !PyErr_Occurred()) {
+      PyErr_SetObject(error.exception, error.value);
+    }
+    res.reset();
+  }
+  Py_LeaveRecursiveCall();
+  return res;
+}
+
+// Calls a function returned by direct_callee, as call_code.
+template<class ArgList, class KwList>
+static inline f_inline bool call_direct(Evaluator* eval, RegisterCode* code, PyObject* fn, const ArgList& args, int na,
+                                 const KwList& kw, Register* registers, int dst) {
+  Register res = call_code(eval, code, fn, args, na, kw);
+  if (res.is_null()) {
+    return false;
+  }
+  STORE_REG(dst, res);
+  return true;
+}
+
+// The parameters of code named by the constant keywords of a call,
+// looked up when the call first reaches code and then kept in its cache.
+static inline f_inline const int16_t* keyword_params(CallCache& cache, RegisterCode* code, Register* registers,
+                                              const RegisterOffset* kw_regs, int nk) {
+  if (cache.keyword_code != code) {
+    for (int i = 0; i < nk; ++i) {
+      cache.params[i] = find_param(code, LOAD_OBJ(kw_regs[2 * i]));
+    }
+    cache.keyword_code = code;
+  }
+  return cache.params;
+}
+
+// As call_direct, for a call with keyword arguments whose names are
+// constants.
+static n_inline bool call_keywords(Evaluator* eval, CallCache& cache, RegisterCode* code, PyObject* fn,
+                                   Register* registers, const RegisterOffset* arg_regs, int na, int nk, int dst) {
+  const RegisterOffset* kw_regs = arg_regs + na;
+  CallerArgs args = { registers, arg_regs };
+  CallerKeywords kw = { registers, kw_regs, nk, keyword_params(cache, code, registers, kw_regs, nk) };
+  return call_direct(eval, code, fn, args, na, kw, registers, dst);
+}
+
+// As call_direct, for calls with keywords not in a CallCache, or with
+// *args or **kwargs: the arguments are gathered into lists first, as
+// ceval's ext_do_call does.  *args must be a tuple or list, and **kwargs
+// a dictionary of strings repeating none of the other keywords; calls
+// with anything else are left to CPython, which converts or rejects it.
+// Returns -1 for those, and otherwise whether the call succeeded.
+template<bool HasVarArgs, bool HasKwDict>
+static n_inline int call_unpacked(Evaluator* eval, RegisterCode* code, PyObject* fn, Register* registers,
+                                  const RegisterOffset* arg_regs, int na, int nk, int dst) {
+  ObjVector args;
+  Keywords kw;
+  for (int i = 0; i < na; ++i) {
+    args.push_back(registers[arg_regs[i]]);
+  }
+  const RegisterOffset* kw_regs = arg_regs + na;
+  for (int i = 0; i < nk; ++i) {
+    kw.push_back(LOAD_OBJ(kw_regs[2 * i]), registers[kw_regs[2 * i + 1]]);
+  }
+
+  if (HasVarArgs) {
+    PyObject* varargs = LOAD_OBJ(kw_regs[2 * nk]);
+    if (!PyTuple_Check(varargs) && !PyList_Check(varargs)) {
+      return -1;
+    }
+    PyObject** items = PySequence_Fast_ITEMS(varargs);
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(varargs); ++i) {
+      Register r;
+      r.borrow(items[i]);
+      args.push_back(r);
+    }
+  }
+
+  if (HasKwDict) {
+    PyObject* kwdict = LOAD_OBJ(kw_regs[2 * nk + HasVarArgs]);
+    if (!PyDict_Check(kwdict)) {
+      return -1;
+    }
+    Py_ssize_t pos = 0;
+    PyObject* key;
+    PyObject* value;
+    while (PyDict_Next(kwdict, &pos, &key, &value)) {
+      if (!PyString_Check(key)) {
+        return -1;
+      }
+      for (int i = 0; i < nk; ++i) {
+        if (_PyString_Eq(key, kw.name(i))) {
+          return -1;
+        }
+      }
+      Register r;
+      r.borrow(value);
+      kw.push_back(key, r);
+    }
+  }
+
+  return call_direct(eval, code, fn, args, args.size(), kw, registers, dst);
+}
+
+// Looks up the __init__ that call_class runs for type, and records it in
+// the call's cache.  NULL if type's instances can't be made directly.
+static PyObject* class_init_fill(CallCache& cache, PyTypeObject* type) {
+  static PyObject* init_str = PyString_InternFromString("__init__");
+
+  // This also assigns the type a version tag, if it can have one.
+  PyObject* init = _PyType_Lookup(type, init_str);
+  if (!PyType_HasFeature(type, Py_TPFLAGS_VALID_VERSION_TAG)) {
+    return NULL;
+  }
+  if (Py_TYPE(type) != &PyType_Type ||
+      type->tp_new != PyBaseObject_Type.tp_new ||
+      PyType_HasFeature(type, Py_TPFLAGS_IS_ABSTRACT) ||
+      init == NULL || !PyFunction_Check(init)) {
+    init = NULL;
+  }
+  cache.type = type;
+  cache.version = type->tp_version_tag;
+  cache.init = init;
+  return init;
+}
+
+// The __init__ of cls if calls of it can be made by call_class: a class
+// of the plain metaclass, whose instances come from object.__new__ and
+// are set up by an __init__ written in Python.  NULL otherwise.
+static inline f_inline PyObject* class_init(CallCache& cache, PyObject* cls) {
+  PyTypeObject* type = (PyTypeObject*) cls;
+  if (cache.type == type && cache.version == type->tp_version_tag &&
+      PyType_HasFeature(type, Py_TPFLAGS_VALID_VERSION_TAG)) {
+    return cache.init;
+  }
+  return class_init_fill(cache, type);
+}
+
+// The arguments of an __init__ run by call_class: the new instance, then
+// the caller's argument registers.
+struct InitArgs {
+  Register* self;
+  Register* registers;
+  const RegisterOffset* arg_regs;
+
+  f_inline Register& operator[](int i) const {
+    return i == 0 ? *self : registers[arg_regs[i - 1]];
+  }
+};
+
+// Calls cls, whose instances can be made directly (see class_init), as
+// type_call would: the instance is allocated as object.__new__ does, and
+// its __init__ run through call_code with the instance as the first
+// argument, so there is neither a bound method nor an argument tuple.
+// Returns -1, leaving the call to CPython, if it can't be made so, and
+// otherwise whether it succeeded.
+static n_inline int call_class(Evaluator* eval, CallCache& cache, PyObject* cls, Register* registers,
+                               const RegisterOffset* arg_regs, int na, int nk, int dst) {
+  PyObject* init = class_init(cache, cls);
+  if (init == NULL) {
+    return -1;
+  }
+  RegisterCode* code = direct_callee(eval, init);
+  if (code == NULL || (nk > 0 && !cache.constant_keywords)) {
+    return -1;
+  }
+
+  PyTypeObject* type = (PyTypeObject*) cls;
+  PyObject* obj = type->tp_alloc(type, 0);
+  if (obj == NULL) {
+    return false;
+  }
+  Register self;
+  self.store(obj);
+  InitArgs args = { &self, registers, arg_regs };
+  Register res;
+  if (nk == 0) {
+    res = call_code(eval, code, init, args, na + 1, NoKeywords());
+  } else {
+    const RegisterOffset* kw_regs = arg_regs + na;
+    CallerKeywords kw = { registers, kw_regs, nk, keyword_params(cache, code, registers, kw_regs, nk) };
+    res = call_code(eval, code, init, args, na + 1, kw);
+  }
+  if (res.is_null()) {
+    Py_DECREF(obj);
+    return false;
+  }
+  if (!res.is_obj() || res.as_obj() != Py_None) {
+    PyErr_Format(PyExc_TypeError, "__init__() should return None, not '%.200s'", Py_TYPE(res.as_obj())->tp_name);
+    res.decref();
+    Py_DECREF(obj);
+    return false;
+  }
+  res.decref();
+  STORE_REG(dst, obj);
+  return true;
+}
+
+// Calls a builtin function with the positional arguments in registers
+// arg_regs[0..na), without ceval: METH_NOARGS and METH_O functions are
+// called with their argument straight from its register, and only
+// METH_VARARGS ones get an argument tuple.  Returns -1, leaving the call
+// to CPython, for other conventions and for argument counts CPython
+// rejects; otherwise whether the call succeeded.
+static inline f_inline int call_cfunction(PyObject* fn, Register* registers, const RegisterOffset* arg_regs, int na,
+                                   int dst) {
+  PyCFunction meth = PyCFunction_GET_FUNCTION(fn);
+  PyObject* self = PyCFunction_GET_SELF(fn);
+  PyObject* res;
+  switch (PyCFunction_GET_FLAGS(fn) & ~(METH_CLASS | METH_STATIC | METH_COEXIST)) {
+  case METH_NOARGS:
+    if (na != 0) {
+      return -1;
+    }
+    res = meth(self, NULL);
+    break;
+  case METH_O:
+    if (na != 1) {
+      return -1;
+    }
+    res = meth(self, LOAD_OBJ(arg_regs[0]));
+    break;
+  case METH_VARARGS:
+  case METH_VARARGS | METH_KEYWORDS: {
+    PyObject* args = PyTuple_New(na);
+    if (args == NULL) {
+      return false;
+    }
+    for (int i = 0; i < na; ++i) {
+      PyObject* v = LOAD_OBJ(arg_regs[i]);
+      Py_INCREF(v);
+      PyTuple_SET_ITEM(args, i, v);
+    }
+    if (PyCFunction_GET_FLAGS(fn) & METH_KEYWORDS) {
+      res = ((PyCFunctionWithKeywords) meth)(self, args, NULL);
+    } else {
+      res = meth(self, args);
+    }
+    Py_DECREF(args);
+    break;
+  }
+  default:
+    return -1;
+  }
+  if (res == NULL) {
+    return false;
+  }
+  STORE_REG(dst, res);
+  return true;
+}
+
 template<bool HasVarArgs, bool HasKwDict>
 struct CallFunction : public VarArgsOpImpl<CallFunction<HasVarArgs, HasKwDict> > {
-    static f_inline void _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
+    static f_inline bool _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
         int na = op->arg & 0xff;
         int nk = (op->arg >> 8) & 0xff;
         int n = nk * 2 + na;
@@ -1480,6 +2723,43 @@ struct CallFunction : public VarArgsOpImpl<CallFunction<HasVarArgs, HasKwDict> >
 
         Reg_AssertEq(n + 2, op->num_registers);
 
+        if (!HasVarArgs && !HasKwDict && nk == 0 && PyCFunction_Check(fn)) {
+            int res = call_cfunction(fn, registers, &op->reg[1], na, dst);
+            if (res >= 0) {
+                return res;
+            }
+        }
+
+        RegisterCode* code = direct_callee(eval, fn);
+        if (code != NULL) {
+            const RegisterOffset* arg_regs = &op->reg[1];
+            if (!HasVarArgs && !HasKwDict && nk == 0) {
+                CallerArgs args = { registers, arg_regs };
+                return call_direct(eval, code, fn, args, na, NoKeywords(), registers, dst);
+            }
+            if (!HasVarArgs && !HasKwDict && op->hint_pos != kInvalidHint &&
+                frame->code->call_caches[op->hint_pos].constant_keywords) {
+                return call_keywords(eval, frame->code->call_caches[op->hint_pos], code, fn,
+                                     registers, arg_regs, na, nk, dst);
+            }
+            int res = call_unpacked<HasVarArgs, HasKwDict>(eval, code, fn, registers, arg_regs, na, nk, dst);
+            if (res >= 0) {
+                return res;
+            }
+        } else if (!HasVarArgs && !HasKwDict && PyType_Check(fn) && op->hint_pos != kInvalidHint) {
+            int res = call_class(eval, frame->code->call_caches[op->hint_pos], fn, registers, &op->reg[1], na, nk, dst);
+            if (res >= 0) {
+                return res;
+            }
+        }
+
+        return call_generic(fn, op, registers, na, nk, dst);
+    }
+
+    // The call through ceval, which takes a fake value stack holding fn
+    // and its arguments.  Out of line, so that the stack array only takes
+    // up C stack during these calls, and not in every Evaluator::eval.
+    static n_inline bool call_generic(PyObject* fn, VarRegOp *op, Register* registers, int na, int nk, int dst) {
         PyObject *stack[1024];
         PyObject **stack_pointer = stack;
         Py_INCREF(fn);
@@ -1509,8 +2789,16 @@ struct CallFunction : public VarArgsOpImpl<CallFunction<HasVarArgs, HasKwDict> >
             *stack_pointer++ = kwdict;
         }
         *stack_pointer = (PyObject *)op->arg;
-        auto result = PyEval_EvalFrameDefault((PyFrameObject *)stack_pointer, op->code);
+        // op->code may already be mapped to a handler address, so pass the
+        // opcode through explicitly.
+        const int opcode = HasVarArgs ? (HasKwDict ? CALL_FUNCTION_VAR_KW : CALL_FUNCTION_VAR)
+                                      : (HasKwDict ? CALL_FUNCTION_KW : CALL_FUNCTION);
+        auto result = PyEval_EvalFrameDefault((PyFrameObject *)stack_pointer, opcode);
+        if (result == NULL) {
+            return false;
+        }
         STORE_REG(dst, result);
+        return true;
     }
 };
 
@@ -1519,15 +2807,99 @@ typedef CallFunction<true, false> CallFunctionVar;
 typedef CallFunction<false, true> CallFunctionKw;
 typedef CallFunction<true, true> CallFunctionVarKw;
 
+// CALL_FUNCTION on the result of a LOAD_METHOD.  The registers are the
+// callable, the object it was looked up on, then the arguments as for
+// CALL_FUNCTION.
+struct CallMethod : public VarArgsOpImpl<CallMethod> {
+    static f_inline bool _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
+        int na = op->arg & 0xff;
+        int nk = (op->arg >> 8) & 0xff;
+        int n = nk * 2 + na;
+
+        int dst = op->reg[n + 2];
+
+        Reg_AssertEq(n + 3, op->num_registers);
+
+        PyObject* fn = LOAD_OBJ(op->reg[0]);
+        bool unbound = frame->is_unbound_method(op->reg[0]);
+
+        // Builtin methods come bound, as LOAD_METHOD only leaves
+        // functions defined in Python unbound.
+        if (nk == 0 && !unbound && PyCFunction_Check(fn)) {
+            int res = call_cfunction(fn, registers, &op->reg[2], na, dst);
+            if (res >= 0) {
+                return res;
+            }
+        }
+
+        // An unbound method takes self as its first argument, and self's
+        // register comes just before the arguments'.
+        RegisterCode* code = direct_callee(eval, fn);
+        if (code != NULL) {
+            const RegisterOffset* arg_regs = &op->reg[2 - unbound];
+            if (nk == 0) {
+                CallerArgs args = { registers, arg_regs };
+                return call_direct(eval, code, fn, args, na + unbound, NoKeywords(), registers, dst);
+            }
+            if (op->hint_pos != kInvalidHint && frame->code->call_caches[op->hint_pos].constant_keywords) {
+                return call_keywords(eval, frame->code->call_caches[op->hint_pos], code, fn,
+                                     registers, arg_regs, na + unbound, nk, dst);
+            }
+            int res = call_unpacked<false, false>(eval, code, fn, registers, arg_regs, na + unbound, nk, dst);
+            if (res >= 0) {
+                return res;
+            }
+        } else if (!unbound && PyType_Check(fn) && op->hint_pos != kInvalidHint) {
+            // A class looked up on a module.
+            int res = call_class(eval, frame->code->call_caches[op->hint_pos], fn, registers, &op->reg[2], na, nk, dst);
+            if (res >= 0) {
+                return res;
+            }
+        }
+
+        return call_generic(fn, op, registers, n, unbound, dst);
+    }
+
+    // As CallFunction::call_generic.
+    static n_inline bool call_generic(PyObject* fn, VarRegOp *op, Register* registers, int n, bool unbound, int dst) {
+        PyObject* self = LOAD_OBJ(op->reg[1]);
+
+        PyObject *stack[1024];
+        PyObject **stack_pointer = stack;
+        Py_INCREF(fn);
+        *stack_pointer++ = fn;
+        if (unbound) {
+            Py_INCREF(self);
+            *stack_pointer++ = self;
+        }
+        for (int i = 2; i < n + 2; i++) {
+            auto a = LOAD_OBJ(op->reg[i]);
+            Py_INCREF(a);
+            *stack_pointer++ = a;
+        }
+        *stack_pointer = (PyObject *)(intptr_t)(op->arg + unbound);
+        auto result = PyEval_EvalFrameDefault((PyFrameObject *)stack_pointer, CALL_FUNCTION);
+        if (result == NULL) {
+            return false;
+        }
+        STORE_REG(dst, result);
+        return true;
+    }
+};
+
 struct GetIter: public RegOpImpl<RegOp<2>, GetIter> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
     PyObject* res = PyObject_GetIter(LOAD_OBJ(op.reg[0]));
+    if (res == NULL) {
+      return false;
+    }
     STORE_REG(op.reg[1], res);
+    return true;
   }
 };
 
 struct ForIter: public BranchOpImpl<BranchOp<2>, ForIter> {
-  static f_inline void _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<2>& op, const char **pc,
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<2>& op, const char **pc,
                              Register* registers) {
     CHECK_VALID(LOAD_OBJ(op.reg[0]));
     PyObject* iter = PyIter_Next(LOAD_OBJ(op.reg[0]));
@@ -1535,52 +2907,90 @@ struct ForIter: public BranchOpImpl<BranchOp<2>, ForIter> {
       STORE_REG(op.reg[1], iter);
       *pc += sizeof(BranchOp<2> );
     } else {
+      if (PyErr_Occurred()) {
+        if (!PyErr_ExceptionMatches(PyExc_StopIteration)) {
+          return false;
+        }
+        PyErr_Clear();
+        clear_traceback();
+      }
       *pc = frame->instructions() + op.label;
     }
+    return true;
 
   }
 };
 
 struct JumpIfFalseOrPop: public BranchOpImpl<BranchOp<1>, JumpIfFalseOrPop> {
-  static f_inline void _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<1>& op, const char **pc,
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<1>& op, const char **pc,
                              Register* registers) {
     PyObject *r1 = LOAD_OBJ(op.reg[0]);
-    if (r1 == Py_False || (PyObject_IsTrue(r1) == 0)) {
+    int truth = r1 == Py_False ? 0 : PyObject_IsTrue(r1);
+    if (truth < 0) {
+      return false;
+    }
+    if (truth == 0) {
 //      EVAL_LOG("Jumping: %s -> %d", obj_to_str(r1), op.label);
         *pc = frame->instructions() + op.label;
       } else {
         *pc += sizeof(BranchOp<1>);
       }
+    return true;
 
     }
   };
 
 struct JumpIfTrueOrPop: public BranchOpImpl<BranchOp<1>, JumpIfTrueOrPop> {
-  static f_inline void _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<1>& op, const char **pc,
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<1>& op, const char **pc,
                              Register* registers) {
     PyObject* r1 = LOAD_OBJ(op.reg[0]);
-    if (r1 == Py_True || (PyObject_IsTrue(r1) == 1)) {
+    int truth = r1 == Py_True ? 1 : PyObject_IsTrue(r1);
+    if (truth < 0) {
+      return false;
+    }
+    if (truth == 1) {
       *pc = frame->instructions() + op.label;
     } else {
       *pc += sizeof(BranchOp<1>);
     }
+    return true;
 
   }
 };
 
 struct JumpAbsolute: public BranchOpImpl<BranchOp<0>, JumpAbsolute> {
-  static f_inline void _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<0>& op, const char **pc,
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<0>& op, const char **pc,
                              Register* registers) {
     EVAL_LOG("Jumping to: %d", op.label);
     *pc = frame->instructions() + op.label;
+    return true;
+  }
+};
+
+// Continue into the inlined body only while the callable is the function
+// inlined there, running the same code it was inlined with, and with our
+// globals if the body reads them.  Builtins have no code to compare.
+struct GuardFunction: public BranchOpImpl<BranchOp<1>, GuardFunction> {
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<1>& op, const char **pc,
+                             Register* registers) {
+    const InlineGuard& guard = frame->code->inline_guards[op.arg];
+    PyObject* fn = LOAD_OBJ(op.reg[0]);
+    if (fn == guard.function && (guard.code == NULL || PyFunction_GET_CODE(fn) == guard.code) &&
+        (!guard.same_globals || PyFunction_GET_GLOBALS(fn) == frame->globals())) {
+      *pc += sizeof(BranchOp<1>);
+    } else {
+      *pc = frame->instructions() + op.label;
+    }
+    return true;
   }
 };
 
 struct BreakLoop: public BranchOpImpl<BranchOp<0>, BreakLoop> {
-  static f_inline void _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<0>& op, const char **pc,
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<0>& op, const char **pc,
                              Register* registers) {
     EVAL_LOG("Jumping to: %d", op.label);
     *pc = frame->instructions() + op.label;
+    return true;
   }
 };
 
@@ -1604,14 +3014,37 @@ struct ReturnValue {
   }
 };
 
+// Leaves eval with the value of reg[0], suspending the generator frame
+// at this instruction.  The generator stores the value sent in reg[1]
+// before resuming after it (see gen_send).
+struct YieldValue {
+  template<bool DISASM>
+  static f_inline Register* eval(Evaluator* eval, RegisterFrame* frame, const char* pc, Register* registers) {
+    RegOp<2>& op = *((RegOp<2>*) pc);
+    if (!DISASM) log_operation(frame, (RegOp<2>*)pc, registers, pc);
+    if (DISASM) {
+      WRITEOP_DISASM();
+      return NULL;
+    }
+    frame->yield_pc_ = pc;
+    if (frame->saved_exc_type_ != NULL) {
+      frame->reset_exc_info();
+    }
+    Register& r = registers[op.reg[0]];
+    r.incref();
+    return &r;
+  }
+};
+
 struct Nop: public RegOpImpl<RegOp<0>, Nop> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<0>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<0>& op, Register* registers) {
+    return true;
 
   }
 };
 
 struct BuildTuple: public VarArgsOpImpl<BuildTuple> {
-  static f_inline void _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
     register int count = op->arg;
     PyObject* t = PyTuple_New(count);
     for (register int i = 0; i < count; ++i) {
@@ -1620,11 +3053,12 @@ struct BuildTuple: public VarArgsOpImpl<BuildTuple> {
       PyTuple_SET_ITEM(t, i, v);
     }
     STORE_REG(op->reg[count], t);
+    return true;
   }
 };
 
 struct BuildList: public VarArgsOpImpl<BuildList> {
-  static f_inline void _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame* frame, VarRegOp *op, Register* registers) {
     register int count = op->arg;
     PyObject* t = PyList_New(count);
     for (register int i = 0; i < count; ++i) {
@@ -1633,29 +3067,36 @@ struct BuildList: public VarArgsOpImpl<BuildList> {
       PyList_SET_ITEM(t, i, v);
     }
     STORE_REG(op->reg[count], t);
+    return true;
   }
 };
 
 struct BuildMap: public RegOpImpl<RegOp<1>, BuildMap> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
     // for now ignore the size hint in the op arg
     PyObject* dict = PyDict_New();
     STORE_REG(op.reg[0], dict);
+    return true;
   }
 };
 
 struct BuildSlice: public RegOpImpl<RegOp<4>, BuildSlice> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<4>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<4>& op, Register* registers) {
     PyObject* w = LOAD_OBJ(op.reg[0]);
     PyObject* v = LOAD_OBJ(op.reg[1]);
     PyObject* u = LOAD_OBJ(op.reg[2]);
 
-    STORE_REG(op.reg[3], PySlice_New(u, v, w))
+    PyObject* slice = PySlice_New(u, v, w);
+    if (slice == NULL) {
+      return false;
+    }
+    STORE_REG(op.reg[3], slice);
+    return true;
   }
 };
 
 struct BuildClass: public RegOpImpl<RegOp<4>, BuildClass> {
-  static void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<4>& op, Register* registers) {
+  static bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<4>& op, Register* registers) {
     PyObject* methods = LOAD_OBJ(op.reg[0]);
     PyObject* bases = LOAD_OBJ(op.reg[1]);
     PyObject* name = LOAD_OBJ(op.reg[2]);
@@ -1711,28 +3152,33 @@ struct BuildClass: public RegOpImpl<RegOp<4>, BuildClass> {
           }
 
           PyErr_Restore(ptype, pvalue, ptraceback);
-          throw RException();
+          return false;
+        }
+        if (result == NULL) {
+          return false;
         }
 
         // End: build_class()
         STORE_REG(op.reg[3], result);
+    return true;
       }
     };
 
 struct StoreMap: public RegOpImpl<RegOp<3>, StoreMap> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* key = LOAD_OBJ(op.reg[0]);
     PyObject* value = LOAD_OBJ(op.reg[1]);
     PyObject* dict = LOAD_OBJ(op.reg[2]);
 
     if (PyDict_SetItem(dict, key, value) != 0) {
-      throw RException();
+      return false;
     }
+    return true;
   }
 };
 
 struct PrintItem: public RegOpImpl<RegOp<2>, PrintItem> {
-  static void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+  static bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
     PyObject* v = LOAD_OBJ(op.reg[0]);
     PyObject* w = op.reg[1] != kInvalidRegister ? LOAD_OBJ(op.reg[1]) : PySys_GetObject((char*) "stdout");
 
@@ -1761,22 +3207,27 @@ struct PrintItem: public RegOpImpl<RegOp<2>, PrintItem> {
       }
 
       if (err != 0) {
-        throw RException();
+        return false;
       }
+    return true;
     }
   };
 
 struct PrintNewline: public RegOpImpl<RegOp<1>, PrintNewline> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
     PyObject* w = op.reg[0] != kInvalidRegister ? LOAD_OBJ(op.reg[0]): PySys_GetObject((char*) "stdout");
     int err = PyFile_WriteString("\n", w);
-    if (err == 0) PyFile_SoftSpace(w, 0);
+    if (err != 0) {
+      return false;
+    }
+    PyFile_SoftSpace(w, 0);
+    return true;
   }
 };
 
 struct ListAppend: public RegOpImpl<RegOp<2>, ListAppend> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
-    PyList_Append(LOAD_OBJ(op.reg[0]), LOAD_OBJ(op.reg[1]));
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+    return PyList_Append(LOAD_OBJ(op.reg[0]), LOAD_OBJ(op.reg[1])) == 0;
   }
 };
 
@@ -1802,35 +3253,28 @@ static PyObject * apply_slice(PyObject *u, PyObject *v, PyObject *w) {
 }
 
 struct Slice: public RegOpImpl<RegOp<4>, Slice> {
-  static f_inline void _eval(Evaluator *eval, RegisterFrame* frame, RegOp<4>& op, Register* registers) {
+  static f_inline bool _eval(Evaluator *eval, RegisterFrame* frame, RegOp<4>& op, Register* registers) {
     PyObject* list = LOAD_OBJ(op.reg[0]);
     PyObject* left = op.reg[1] != kInvalidRegister ? LOAD_OBJ(op.reg[1]) : NULL;
     PyObject* right = op.reg[2] != kInvalidRegister ? LOAD_OBJ(op.reg[2]) : NULL;
     PyObject* result = apply_slice(list, left, right);
     if (!result) {
-      throw RException();
+      return false;
     }
     STORE_REG(op.reg[3], result);
-  }
-};
-
-template<int Opcode>
-struct BadOp {
-  template<bool DISASM>
-  static n_inline void eval(Evaluator *eval, RegisterFrame* frame, Register* registers) {
-    const char* name = OpUtil::name(Opcode);
-    throw RException(PyExc_SystemError, "Bad opcode %s", name);
+    return true;
   }
 };
 
 // Imports
 
 struct ImportName: public RegOpImpl<RegOp<3>, ImportName> {
-  static void _eval(Evaluator* eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+  static bool _eval(Evaluator* eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* name = PyTuple_GET_ITEM(frame->names(), op.arg) ;
     PyObject* import = PyDict_GetItemString(frame->builtins(), "__import__");
     if (import == NULL) {
-      throw RException(PyExc_ImportError, "__import__ not found in builtins.");
+      PyErr_Format(PyExc_ImportError, "__import__ not found in builtins.");
+      return false;
     }
 
     PyObject* args = NULL;
@@ -1845,18 +3289,17 @@ struct ImportName: public RegOpImpl<RegOp<3>, ImportName> {
 
     PyObject* res = PyEval_CallObject(import, args);
     if (res == NULL) {
-      PyErr_Print();
-      throw RException(PyExc_ImportError, "Failed to import name %s",
-          PyString_AsString(name));
+      return false;
     }
     // band-aid to prevent segfaults, not sure why this incref makes things work
         Py_IncRef(res);
         STORE_REG(op.reg[2], res);
+    return true;
       }
     };
 
 struct ImportStar: public RegOpImpl<RegOp<1>, ImportStar> {
-  static void _eval(Evaluator* eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
+  static bool _eval(Evaluator* eval, RegisterFrame* frame, RegOp<1>& op, Register* registers) {
     PyObject* module = LOAD_OBJ(op.reg[0]);
     PyObject *all = PyObject_GetAttrString(module, "__all__");
     bool skip_leading_underscores = (all == NULL);
@@ -1865,7 +3308,8 @@ struct ImportStar: public RegOpImpl<RegOp<1>, ImportStar> {
       all = PyMapping_Keys(dict);
     }
 
-    for (int pos = 0, err = 0;; pos++) {
+    int err = 0;
+    for (int pos = 0;; pos++) {
       PyObject* name = PySequence_GetItem(all, pos);
       if (name == NULL) {
         if (!PyErr_ExceptionMatches(PyExc_IndexError)) err = -1;
@@ -1886,98 +3330,364 @@ struct ImportStar: public RegOpImpl<RegOp<1>, ImportStar> {
       Py_XDECREF(value);
       if (err != 0) break;
     }
+    return err == 0;
   }
 };
 
 struct ImportFrom: public RegOpImpl<RegOp<2>, ImportFrom> {
-  static void _eval(Evaluator* eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
+  static bool _eval(Evaluator* eval, RegisterFrame* frame, RegOp<2>& op, Register* registers) {
     PyObject* name = PyTuple_GetItem(frame->names(), op.arg);
     PyObject* module = LOAD_OBJ(op.reg[0]);
     Py_XDECREF(LOAD_OBJ(op.reg[1]));
     PyObject* val = PyObject_GetAttr(module, name);
     if (val == NULL) {
       if (PyErr_ExceptionMatches(PyExc_AttributeError)) {
-        throw RException(PyExc_ImportError, "cannot import name %.230s", PyString_AsString(name));
+        PyErr_Format(PyExc_ImportError, "cannot import name %.230s", PyString_AsString(name));
+      return false;
       } else {
-        throw RException();
+        return false;
       }
     }
 
     STORE_REG(op.reg[1], val);
+    return true;
   }
 };
 
-struct SetupExcept: public BranchOpImpl<BranchOp<0>, SetupExcept> {
-  static f_inline void _eval(Evaluator* eval, RegisterFrame *frame, BranchOp<0>& op, const char **pc,
-                             Register* registers) {
-    EVAL_LOG("Pushing handler: %d", op.label);
-    frame->exc_handlers_.push_back(op.label);
-    *pc += sizeof(BranchOp<0> );
+// A frame an exception left, and the instruction it left from.  Only one
+// of pyframe, for frames entered through the eval_frame hook, and code is
+// set.
+struct PendingFrame {
+  PyObject* pyframe;
+  PyObject* code;
+  PyObject* globals;
+  PyObject* locals;
+  int lasti;
+  int line;
+};
+
+// The frames the current exception of this thread has left, innermost
+// first.  Entries of a traceback need Python frames, which are only made
+// once the exception returns to the interpreter or enters an except
+// clause (see flush_traceback); until then leaving a frame just keeps a
+// few references.
+struct PendingTraceback {
+  // The exception the frames belong to, held so that frames left by an
+  // exception since cleared aren't added to a new one.
+  PyObject* type;
+  PyObject* value;
+  std::vector<PendingFrame> frames;
+
+  PendingTraceback() : type(NULL), value(NULL) {}
+
+  static PendingTraceback* current() {
+    static thread_local PendingTraceback pending;
+    return &pending;
+  }
+
+  void clear() {
+    for (PendingFrame& f : frames) {
+      Py_XDECREF(f.pyframe);
+      Py_XDECREF(f.code);
+      Py_XDECREF(f.globals);
+      Py_XDECREF(f.locals);
+    }
+    frames.clear();
+    Py_CLEAR(type);
+    Py_CLEAR(value);
+  }
+
+  void swap(PendingTraceback& other) {
+    std::swap(type, other.type);
+    std::swap(value, other.value);
+    frames.swap(other.frames);
   }
 };
 
-typedef SetupExcept SetupFinally;
+// Where frame is at pc, which is NULL if unknown.  References are
+// borrowed.
+static PendingFrame frame_position(RegisterFrame* frame, const char* pc) {
+  PendingFrame f = { frame->pyframe_, NULL, NULL, NULL, -1, frame->code->code()->co_firstlineno };
+  if (f.pyframe == NULL) {
+    // PyFrame_New makes the locals of function frames itself.
+    f.code = (PyObject*) frame->code->code();
+    f.globals = frame->globals();
+    f.locals = frame->locals_;
+  }
+  if (pc != NULL) {
+    const LineEntry& entry = frame->code->find_line(frame->offset(pc));
+    f.lasti = entry.py_offset;
+    f.line = entry.line;
+  }
+  return f;
+}
 
-struct RaiseVarArgs: public RegOpImpl<RegOp<3>, RaiseVarArgs> {
-  static void _eval(Evaluator* eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
-//    Log_Info("Raising exception: %d %d %d", op.reg[0], op.reg[1], op.reg[2]);
+static void add_traceback_entry(PyThreadState* tstate, const PendingFrame& f) {
+  PyFrameObject* py_frame = (PyFrameObject*) f.pyframe;
+  if (py_frame != NULL) {
+    Py_INCREF(py_frame);
+  } else {
+    py_frame = PyFrame_New(tstate, (PyCodeObject*) f.code, f.globals, f.locals);
+    if (py_frame == NULL) {
+      return;
+    }
+  }
+  // Tracebacks take their line from f_lasti.
+  py_frame->f_lasti = f.lasti;
+  py_frame->f_lineno = f.line;
+  PyTraceBack_Here(py_frame);
+  Py_DECREF(py_frame);
+}
+
+// Add the frames the current exception has left to its traceback.  Called
+// wherever Python code could see the traceback.
+static void flush_traceback() {
+  PendingTraceback* pending = PendingTraceback::current();
+  if (pending->frames.empty()) {
+    return;
+  }
+  PyThreadState* tstate = PyThreadState_GET();
+  if (tstate->curexc_type == pending->type && tstate->curexc_value == pending->value) {
+    for (const PendingFrame& f : pending->frames) {
+      add_traceback_entry(tstate, f);
+    }
+  }
+  pending->clear();
+}
+
+// Drop the frames left by an exception which was cleared without Python
+// code seeing it.  PendingTraceback only notices a new exception by its
+// type and value, so they would otherwise join the traceback of the same
+// exception object raised again.
+static void clear_traceback() {
+  PendingTraceback::current()->clear();
+}
+
+// The first operation of an except clause, reached through the
+// exception table when an instruction in its try block raises.  Stores
+// the exception type, value and traceback, and makes the exception the
+// one reported by sys.exc_info(), as ceval does on entering a handler.
+struct LoadException: public RegOpImpl<RegOp<3>, LoadException> {
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
     PyObject* type;
     PyObject* value;
     PyObject* tb;
-    // Jump to the nearest exception handler.
-    type = LOAD_OBJ(op.reg[0]);
-    if (op.reg[1] != kInvalidRegister) {
-      value = LOAD_OBJ(op.reg[1]);
+    // As in ceval, the traceback includes this frame, at the instruction
+    // which raised, unless it was re-raising.
+    flush_traceback();
+    if (frame->reraised_) {
+      frame->reraised_ = false;
     } else {
+      add_traceback_entry(PyThreadState_GET(), frame_position(frame, frame->error_pc_));
+    }
+    PyErr_Fetch(&type, &value, &tb);
+    if (value == NULL) {
       value = Py_None;
+      Py_INCREF(value);
     }
-
-    if (op.reg[2] != kInvalidRegister) {
-      tb = LOAD_OBJ(op.reg[2]);
-    } else {
+    PyErr_NormalizeException(&type, &value, &tb);
+    if (tb == NULL) {
       tb = Py_None;
+      Py_INCREF(tb);
     }
+    frame->set_exc_info(type, value, tb);
+    { STORE_REG(op.reg[0], type); }
+    { STORE_REG(op.reg[1], value); }
+    { STORE_REG(op.reg[2], tb); }
+    return true;
+  }
+};
 
-    throw RException(type, value, tb);
+// Reached when none of the except clauses matched: raise the exception
+// stored by LOAD_EXCEPTION again.
+struct EndFinally: public RegOpImpl<RegOp<3>, EndFinally> {
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+    PyObject* type = LOAD_OBJ(op.reg[0]);
+    PyObject* value = LOAD_OBJ(op.reg[1]);
+    PyObject* tb = LOAD_OBJ(op.reg[2]);
+    Py_INCREF(type);
+    Py_INCREF(value);
+    if (tb == Py_None) {
+      tb = NULL;
+    }
+    Py_XINCREF(tb);
+    frame->reraised_ = tb != NULL;
+    PyErr_Restore(type, value, tb);
+    return false;
   }
 };
 
-#define DISPATCH_HEADER\
-  dispatch_header: try {
+// A generator expression ends when its body raises StopIteration, so the
+// loop it was fused into does too; other errors go on to our caller.
+struct CatchStopIteration: public RegOpImpl<RegOp<0>, CatchStopIteration> {
+  static f_inline bool _eval(Evaluator* eval, RegisterFrame* frame, RegOp<0>& op, Register* registers) {
+    if (!PyErr_ExceptionMatches(PyExc_StopIteration)) {
+      return false;
+    }
+    PyErr_Clear();
+    clear_traceback();
+    return true;
+  }
+};
 
-#define CONCAT(...) __VA_ARGS__
+// Set the exception for a raise statement; copied from ceval's do_raise.
+// A NULL type re-raises the exception being handled.  Steals references
+// to its arguments.  Returns false if they were invalid, leaving a
+// TypeError set instead.
+static bool do_raise(PyObject* type, PyObject* value, PyObject* tb) {
+  if (type == NULL) {
+    PyThreadState* tstate = PyThreadState_GET();
+    type = tstate->exc_type == NULL ? Py_None : tstate->exc_type;
+    value = tstate->exc_value;
+    tb = tstate->exc_traceback;
+    Py_XINCREF(type);
+    Py_XINCREF(value);
+    Py_XINCREF(tb);
+  }
 
-#if USE_THREADED_DISPATCH == 0
+  if (tb == Py_None) {
+    Py_DECREF(tb);
+    tb = NULL;
+  } else if (tb != NULL && !PyTraceBack_Check(tb)) {
+    PyErr_SetString(PyExc_TypeError, "raise: arg 3 must be a traceback or None");
+    goto raise_error;
+  }
 
-#define JUMP_TO_NEXT goto dispatch_header;
+  if (value == NULL) {
+    value = Py_None;
+    Py_INCREF(value);
+  }
 
-#define START_DISPATCH switch (((OpHeader*)pc)->code) {
-#define END_DISPATCH } JUMP_TO_NEXT
+  // A tuple raises its first item.
+  while (PyTuple_Check(type) && PyTuple_Size(type) > 0) {
+    PyObject* tmp = type;
+    type = PyTuple_GET_ITEM(type, 0);
+    Py_INCREF(type);
+    Py_DECREF(tmp);
+  }
 
-#define FALLTHROUGH(opname) case opname:
-#define START_OP(opname) case opname: {
-#define END_OP(opname) break; }
+  if (PyExceptionClass_Check(type)) {
+    PyErr_NormalizeException(&type, &value, &tb);
+    if (!PyExceptionInstance_Check(value)) {
+      PyErr_Format(PyExc_TypeError,
+                   "calling %s() should have returned an instance of BaseException, not '%s'",
+                   ((PyTypeObject*) type)->tp_name, Py_TYPE(value)->tp_name);
+      goto raise_error;
+    }
+  } else if (PyExceptionInstance_Check(type)) {
+    if (value != Py_None) {
+      PyErr_SetString(PyExc_TypeError, "instance exception may not have a separate value");
+      goto raise_error;
+    }
+    Py_DECREF(value);
+    value = type;
+    type = PyExceptionInstance_Class(type);
+    Py_INCREF(type);
+  } else {
+    PyErr_Format(PyExc_TypeError,
+                 "exceptions must be old-style classes or derived from BaseException, not %s",
+                 type->ob_type->tp_name);
+    goto raise_error;
+  }
 
-#else
-#define JUMP_TO_NEXT goto *labels[((OpHeader*)pc)->code]
+  PyErr_Restore(type, value, tb);
+  return true;
 
-#define START_DISPATCH JUMP_TO_NEXT;
-#define END_DISPATCH
+raise_error:
+  Py_XDECREF(value);
+  Py_XDECREF(type);
+  Py_XDECREF(tb);
+  return false;
+}
+
+struct RaiseVarArgs: public RegOpImpl<RegOp<3>, RaiseVarArgs> {
+  static bool _eval(Evaluator* eval, RegisterFrame* frame, RegOp<3>& op, Register* registers) {
+    PyObject* type = NULL;
+    PyObject* value = NULL;
+    PyObject* tb = NULL;
+    if (op.reg[0] != kInvalidRegister) {
+      type = LOAD_OBJ(op.reg[0]);
+      Py_INCREF(type);
+    }
+    if (op.reg[1] != kInvalidRegister) {
+      value = LOAD_OBJ(op.reg[1]);
+      Py_INCREF(value);
+    }
+    if (op.reg[2] != kInvalidRegister) {
+      tb = LOAD_OBJ(op.reg[2]);
+      Py_INCREF(tb);
+    }
+    if (do_raise(type, value, tb)) {
+      frame->reraised_ = PyThreadState_GET()->curexc_traceback != NULL;
+    }
+    return false;
+  }
+};
 
-#define _FALLTHROUGH(opname) op_ ## opname:
-#define FALLTHROUGH(opname) _FALLTHROUGH(opname)
+template<int Opcode>
+struct BadOp {
+  static n_inline void eval(Evaluator *eval, RegisterFrame* frame, Register* registers) {
+    PyErr_Format(PyExc_SystemError, "Bad opcode %s", OpUtil::name(Opcode));
+  }
+};
 
-#define _START_OP(opname) op_##opname: {
-#define START_OP(opname) _START_OP(opname)
-#define END_OP(opname) JUMP_TO_NEXT; }
+// Record that the exception is leaving frame from the instruction at pc,
+// for its traceback.
+static n_inline void set_frame_error(RegisterFrame* frame, const char* pc) {
+  Log_Info("ERROR: Leaving frame: %s", frame->str().c_str());
+  if (frame->reraised_) {
+    frame->reraised_ = false;
+    return;
+  }
 
-#define _OFFSET(opname) &&op_##opname
-#define OFFSET(opname) _OFFSET(opname)
+  PendingTraceback* pending = PendingTraceback::current();
+  PyThreadState* tstate = PyThreadState_GET();
+  if (pending->type != tstate->curexc_type || pending->value != tstate->curexc_value) {
+    pending->clear();
+    pending->type = tstate->curexc_type;
+    pending->value = tstate->curexc_value;
+    Py_XINCREF(pending->type);
+    Py_XINCREF(pending->value);
+  }
+  PendingFrame f = frame_position(frame, pc);
+  Py_XINCREF(f.pyframe);
+  Py_XINCREF(f.code);
+  Py_XINCREF(f.globals);
+  Py_XINCREF(f.locals);
+  pending->frames.push_back(f);
+}
 
-#endif
+// The pc of the handler for an error raised by the instruction at pc, or
+// NULL if the error leaves the frame.
+static n_inline const char* find_handler(RegisterFrame* frame, const char* pc) {
+  int handler = frame->code->find_handler(frame->offset(pc));
+  return handler == -1 ? NULL : frame->instructions() + handler;
+}
+
+// Residual C++ exceptions, from code outside of the operations, leave the
+// frame directly without consulting its exception table.
+static n_inline void set_frame_error(RegisterFrame* frame, const char* pc, const RException& error) {
+  if (error.exception != NULL && !PyErr_Occurred()) {
+    PyErr_SetObject(error.exception, error.value);
+  }
+  set_frame_error(frame, pc);
+}
+
+#define DISPATCH_HEADER\
+  dispatch_header: try {
+
+#define CONCAT(...) __VA_ARGS__
+
+// Run one operation, leaving pc at the operation if it raised.  Variadic,
+// as an implementation type may hold commas.
+#define RUN_OP(...) {\
+      const char* next_pc__ = __VA_ARGS__::eval<DISASM>(EVALUATOR, frame, pc, registers);\
+      if (!DISASM && next_pc__ == NULL) ON_ERROR;\
+      pc = next_pc__;\
+    }
 
 #define _DEFINE_OP(opname, impl)\
-      pc = impl::eval<DISASM>(this, frame, pc, registers);\
+      RUN_OP(impl)
 
 #define DEFINE_OP(opname, impl)\
     START_OP(opname)\
@@ -1986,12 +3696,13 @@ struct RaiseVarArgs: public RegOpImpl<RegOp<3>, RaiseVarArgs> {
 
 #define BAD_OP(opname)\
     START_OP(opname)\
-      BadOp<opname>::eval<DISASM>(this, frame, registers);\
+      BadOp<opname>::eval(EVALUATOR, frame, registers);\
+      ON_ERROR;\
     END_OP(opname)
 
-#define BINARY_OP3(opname, objfn, intfn, can_overflow)\
+#define BINARY_OP3(opname, objfn, intfn, overflowed)\
     START_OP(opname)\
-    _DEFINE_OP(opname, BinaryOpWithSpecialization<CONCAT(opname, objfn, intfn, can_overflow)>)\
+    _DEFINE_OP(opname, BinaryOpWithSpecialization<CONCAT(opname, objfn, intfn, overflowed)>)\
     END_OP(opname)
 
 #define BINARY_OP2(opname, objfn)\
@@ -1999,189 +3710,195 @@ struct RaiseVarArgs: public RegOpImpl<RegOp<3>, RaiseVarArgs> {
     _DEFINE_OP(opname, BinaryOp<CONCAT(opname, objfn)>)\
     END_OP(opname)
 
+#define BINARY_OP_IMM(opname, objfn, intfn, overflowfn)\
+    START_OP(opname)\
+    _DEFINE_OP(opname, BinaryOpImm<CONCAT(opname, objfn, intfn, overflowfn)>)\
+    END_OP(opname)
+
+#define BINARY_OP_FLOAT(opname, generic, objfn, floatfn)\
+    START_OP(opname)\
+    _DEFINE_OP(opname, BinaryFloatOp<CONCAT(opname, generic, objfn, floatfn)>)\
+    END_OP(opname)
+
 #define UNARY_OP2(opname, objfn)\
     START_OP(opname)\
     _DEFINE_OP(opname, UnaryOp<CONCAT(opname, objfn)>)\
     END_OP(opname)
 
+// A superinstruction runs the handlers of each of its operations in turn,
+// without dispatching in between.
+#define SUPER_OP2(opname, impl1, impl2)\
+    START_OP(opname)\
+      RUN_OP(impl1)\
+      RUN_OP(impl2)\
+    END_OP(opname)
+
+#define SUPER_OP3(opname, impl1, impl2, impl3)\
+    START_OP(opname)\
+      RUN_OP(impl1)\
+      RUN_OP(impl2)\
+      RUN_OP(impl3)\
+    END_OP(opname)
+
+#define SUPER_OFFSET2(opname, a, b) OFFSET(opname),
+#define SUPER_OFFSET3(opname, a, b, c) OFFSET(opname),
+
+#if USE_TAILCALL_DISPATCH
+#if f_musttail_unsupported && (!defined(__OPTIMIZE__) || defined(FALCON_DEBUG))
+#error "USE_TAILCALL_DISPATCH requires [[musttail]] or an optimized build"
+#endif
+
+// Each handler is a function which runs its operation and then tail-calls
+// the handler of the next instruction, keeping the interpreter state in
+// argument registers.  The code field of each instruction holds the
+// address of its handler (see RegisterCode::map_labels).
+typedef Register (f_tailcc *TailHandler)(Evaluator* eval, RegisterFrame* frame, const char* pc, Register* registers);
+
+#define _TAIL_HANDLER(opname)\
+    static f_tailcc Register tail_op_##opname(Evaluator* eval, RegisterFrame* frame, const char* pc, Register* registers)
+#define TAIL_HANDLER(opname) _TAIL_HANDLER(opname)
+
+#define TAIL_CALL_NEXT\
+    f_musttail return ((TailHandler) ((OpHeader*)pc)->code)(eval, frame, pc, registers)
+
+// Continue at the handler for the error raised by the instruction at pc,
+// or leave the frame.
+static f_tailcc Register tail_error(Evaluator* eval, RegisterFrame* frame, const char* pc, Register* registers);
+
+#define ON_ERROR f_musttail return tail_error(eval, frame, pc, registers)
+#define EVALUATOR eval
+// Only the dispatch loop in eval disassembles; not every handler asks.
+static const bool DISASM = false;
+#define START_OP(opname) TAIL_HANDLER(opname) {
+#define END_OP(opname) TAIL_CALL_NEXT; }
+
+#include "reval_handlers.h"
+
+TAIL_HANDLER(RETURN_VALUE) {
+  return *ReturnValue::eval<false>(eval, frame, pc, registers);
+}
+
+TAIL_HANDLER(YIELD_VALUE) {
+  return *YieldValue::eval<false>(eval, frame, pc, registers);
+}
+
+TAIL_HANDLER(STOP_CODE) {
+  EVAL_LOG("Jump to invalid opcode.");
+  PyErr_SetString(PyExc_SystemError, "Invalid jump.");
+  ON_ERROR;
+}
+
+static f_tailcc Register tail_error(Evaluator* eval, RegisterFrame* frame, const char* pc, Register* registers) {
+  const char* handler = find_handler(frame, pc);
+  if (handler != NULL) {
+    EVAL_LOG("Jumping to handler: %d", frame->offset(handler));
+    frame->error_pc_ = pc;
+    pc = handler;
+    TAIL_CALL_NEXT;
+  }
+  set_frame_error(frame, pc);
+  return Register((PyObject*) NULL);
+}
+
+#define _OFFSET(opname) (const void*) &tail_op_##opname
+#define OFFSET(opname) _OFFSET(opname)
+
+static const void* tail_handlers[] = {
+#include "reval_targets.h"
+};
+
+#undef ON_ERROR
+#undef EVALUATOR
+#undef START_OP
+#undef END_OP
+#undef _OFFSET
+#undef OFFSET
+
+static Register eval_tailcall(Evaluator* eval, RegisterFrame* frame) {
+  if (!frame->code->mapped_labels) {
+    frame->code->map_labels(tail_handlers);
+  }
+
+  const char* pc = frame->start_pc_;
+  try {
+    return ((TailHandler) ((OpHeader*)pc)->code)(eval, frame, pc, frame->registers);
+  } catch (const RException &error) {
+    // The raising instruction is unknown here.
+    set_frame_error(frame, NULL, error);
+    return Register((PyObject*) NULL);
+  }
+}
+#endif
+
+#define EVALUATOR this
+#define ON_ERROR goto op_error
+
+#if USE_THREADED_DISPATCH == 0
+
+#define JUMP_TO_NEXT goto dispatch_header;
+
+#define START_DISPATCH switch (((OpHeader*)pc)->code) {
+#define END_DISPATCH } JUMP_TO_NEXT
+
+#define START_OP(opname) case opname: {
+#define END_OP(opname) break; }
+
+#elif USE_DIRECT_THREADING
+// The code field already holds the handler address.  Disassembly runs
+// through the opcode side-table, since the stream may have been mapped
+// by an earlier evaluation.
+#define JUMP_TO_NEXT goto *(DISASM ? labels[frame->code->opcode(pc)] : (const void*) ((OpHeader*)pc)->code)
+#else
+#define JUMP_TO_NEXT goto *labels[((OpHeader*)pc)->code]
+#endif
+
+#if USE_THREADED_DISPATCH
+
+#define START_DISPATCH JUMP_TO_NEXT;
+#define END_DISPATCH
+
+#define _START_OP(opname) op_##opname: {
+#define START_OP(opname) _START_OP(opname)
+#define END_OP(opname) JUMP_TO_NEXT; }
+
+#define _OFFSET(opname) &&op_##opname
+#define OFFSET(opname) _OFFSET(opname)
+
+#endif
+
+
 template<bool DISASM>
 Register Evaluator::eval(RegisterFrame* f) {
+#if USE_TAILCALL_DISPATCH
+  if (!DISASM) {
+    return eval_tailcall(this, f);
+  }
+#endif
+
   register RegisterFrame* frame = f;
 #ifndef _MSC_VER
   register Register* registers asm("r15") = frame->registers;
-  register const char* pc asm("r14") = frame->instructions();
+  register const char* pc asm("r14") = frame->start_pc_;
 #else
   register Register* registers = frame->registers;
-  register const char* pc = frame->instructions();
+  register const char* pc = frame->start_pc_;
 #endif
 
   Reg_Assert(frame != NULL, "NULL frame object.");
   Register* result;
 
-  // The index of each offset MUST correspond to the opcode number!
 #if USE_THREADED_DISPATCH == 1
   static const void* labels[] = {
-    OFFSET(STOP_CODE),
-    OFFSET(POP_TOP),
-    OFFSET(ROT_TWO),
-    OFFSET(ROT_THREE),
-    OFFSET(DUP_TOP),
-    OFFSET(ROT_FOUR),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(NOP),
-    OFFSET(UNARY_POSITIVE),
-    OFFSET(UNARY_NEGATIVE),
-    OFFSET(UNARY_NOT),
-    OFFSET(UNARY_CONVERT),
-    OFFSET(STOP_CODE),
-    OFFSET(UNARY_INVERT),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(BINARY_POWER),
-    OFFSET(BINARY_MULTIPLY),
-    OFFSET(BINARY_DIVIDE),
-    OFFSET(BINARY_MODULO),
-    OFFSET(BINARY_ADD),
-    OFFSET(BINARY_SUBTRACT),
-    OFFSET(BINARY_SUBSCR),
-    OFFSET(BINARY_FLOOR_DIVIDE),
-    OFFSET(BINARY_TRUE_DIVIDE),
-    OFFSET(INPLACE_FLOOR_DIVIDE),
-    OFFSET(INPLACE_TRUE_DIVIDE),
-    OFFSET(SLICE),
-    OFFSET(SLICE),
-    OFFSET(SLICE),
-    OFFSET(SLICE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STORE_SLICE),
-    OFFSET(STORE_SLICE),
-    OFFSET(STORE_SLICE),
-    OFFSET(STORE_SLICE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(DELETE_SLICE),
-    OFFSET(DELETE_SLICE),
-    OFFSET(DELETE_SLICE),
-    OFFSET(DELETE_SLICE),
-    OFFSET(STORE_MAP),
-    OFFSET(INPLACE_ADD),
-    OFFSET(INPLACE_SUBTRACT),
-    OFFSET(INPLACE_MULTIPLY),
-    OFFSET(INPLACE_DIVIDE),
-    OFFSET(INPLACE_MODULO),
-    OFFSET(STORE_SUBSCR),
-    OFFSET(DELETE_SUBSCR),
-    OFFSET(BINARY_LSHIFT),
-    OFFSET(BINARY_RSHIFT),
-    OFFSET(BINARY_AND),
-    OFFSET(BINARY_XOR),
-    OFFSET(BINARY_OR),
-    OFFSET(INPLACE_POWER),
-    OFFSET(GET_ITER),
-    OFFSET(STOP_CODE),
-    OFFSET(PRINT_EXPR),
-    OFFSET(PRINT_ITEM),
-    OFFSET(PRINT_NEWLINE),
-    OFFSET(PRINT_ITEM_TO),
-    OFFSET(PRINT_NEWLINE_TO),
-    OFFSET(INPLACE_LSHIFT),
-    OFFSET(INPLACE_RSHIFT),
-    OFFSET(INPLACE_AND),
-    OFFSET(INPLACE_XOR),
-    OFFSET(INPLACE_OR),
-    OFFSET(BREAK_LOOP),
-    OFFSET(WITH_CLEANUP),
-    OFFSET(LOAD_LOCALS),
-    OFFSET(RETURN_VALUE),
-    OFFSET(IMPORT_STAR),
-    OFFSET(EXEC_STMT),
-    OFFSET(YIELD_VALUE),
-    OFFSET(POP_BLOCK),
-    OFFSET(END_FINALLY),
-    OFFSET(BUILD_CLASS),
-    OFFSET(STORE_NAME),
-    OFFSET(DELETE_NAME),
-    OFFSET(UNPACK_SEQUENCE),
-    OFFSET(FOR_ITER),
-    OFFSET(LIST_APPEND),
-    OFFSET(STORE_ATTR),
-    OFFSET(DELETE_ATTR),
-    OFFSET(STORE_GLOBAL),
-    OFFSET(DELETE_GLOBAL),
-    OFFSET(DUP_TOPX),
-    OFFSET(LOAD_CONST),
-    OFFSET(LOAD_NAME),
-    OFFSET(BUILD_TUPLE),
-    OFFSET(BUILD_LIST),
-    OFFSET(BUILD_SET),
-    OFFSET(BUILD_MAP),
-    OFFSET(LOAD_ATTR),
-    OFFSET(COMPARE_OP),
-    OFFSET(IMPORT_NAME),
-    OFFSET(IMPORT_FROM),
-    OFFSET(JUMP_FORWARD),
-    OFFSET(JUMP_IF_FALSE_OR_POP),
-    OFFSET(JUMP_IF_TRUE_OR_POP),
-    OFFSET(JUMP_ABSOLUTE),
-    OFFSET(POP_JUMP_IF_FALSE),
-    OFFSET(POP_JUMP_IF_TRUE),
-    OFFSET(LOAD_GLOBAL),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(CONTINUE_LOOP),
-    OFFSET(SETUP_LOOP),
-    OFFSET(SETUP_EXCEPT),
-    OFFSET(SETUP_FINALLY),
-    OFFSET(STOP_CODE),
-    OFFSET(LOAD_FAST),
-    OFFSET(STORE_FAST),
-    OFFSET(DELETE_FAST),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(RAISE_VARARGS),
-    OFFSET(CALL_FUNCTION),
-    OFFSET(MAKE_FUNCTION),
-    OFFSET(BUILD_SLICE),
-    OFFSET(MAKE_CLOSURE),
-    OFFSET(LOAD_CLOSURE),
-    OFFSET(LOAD_DEREF),
-    OFFSET(STORE_DEREF),
-    OFFSET(STOP_CODE),
-    OFFSET(STOP_CODE),
-    OFFSET(CALL_FUNCTION_VAR),
-    OFFSET(CALL_FUNCTION_KW),
-    OFFSET(CALL_FUNCTION_VAR_KW),
-    OFFSET(SETUP_WITH),
-    OFFSET(STOP_CODE),
-    OFFSET(EXTENDED_ARG),
-    OFFSET(SET_ADD),
-    OFFSET(MAP_ADD),
-    OFFSET(INCREF),
-    OFFSET(DECREF),
-    OFFSET(CONST_INDEX),
-    OFFSET(BINARY_SUBSCR_LIST),
-    OFFSET(BINARY_SUBSCR_DICT),
-    OFFSET(STORE_SUBSCR_LIST),
-    OFFSET(STORE_SUBSCR_DICT),
-    OFFSET(DICT_CONTAINS),
-    OFFSET(DICT_GET),
-    OFFSET(DICT_GET_DEFAULT),
+#include "reval_targets.h"
   };
 #endif
 
+#if USE_DIRECT_THREADING
+  if (!DISASM && !frame->code->mapped_labels) {
+    frame->code->map_labels(labels);
+  }
+#endif
+
   DISPATCH_HEADER
   START_DISPATCH
 
@@ -2194,179 +3911,40 @@ Register Evaluator::eval(RegisterFrame* f) {
   goto done;\
   END_OP(RETURN_VALUE)
 
+  START_OP(YIELD_VALUE)
+  result = YieldValue::eval<DISASM>(this, frame, pc, registers);
+  if (!DISASM) {
+    goto done;
+  }
+  pc += sizeof(RegOp<2>);
+  END_OP(YIELD_VALUE)
+
   START_OP(STOP_CODE)
   EVAL_LOG("Jump to invalid opcode.");
-  throw RException(PyExc_SystemError, "Invalid jump.");
+  PyErr_SetString(PyExc_SystemError, "Invalid jump.");
+  ON_ERROR;
   END_OP(STOP_CODE)
 
-  BINARY_OP3(BINARY_MULTIPLY, PyNumber_Multiply, IntegerOps::mul, true);
-  BINARY_OP3(BINARY_DIVIDE, PyNumber_Divide, IntegerOps::div, true);
-  BINARY_OP3(BINARY_ADD, PyNumber_Add, IntegerOps::add, true);
-  BINARY_OP3(BINARY_SUBTRACT, PyNumber_Subtract, IntegerOps::sub, true);
-  BINARY_OP3(BINARY_OR, PyNumber_Or, IntegerOps::Or, false);
-  BINARY_OP3(BINARY_XOR, PyNumber_Xor, IntegerOps::Xor, false);
-  BINARY_OP3(BINARY_AND, PyNumber_And, IntegerOps::And, false);
-  BINARY_OP3(BINARY_RSHIFT, PyNumber_Rshift, IntegerOps::Rshift, false);
-  BINARY_OP3(BINARY_LSHIFT, PyNumber_Lshift, IntegerOps::Lshift, false);
-  BINARY_OP2(BINARY_TRUE_DIVIDE, PyNumber_TrueDivide);
-  BINARY_OP2(BINARY_FLOOR_DIVIDE, PyNumber_FloorDivide);
-
-  DEFINE_OP(BINARY_POWER, BinaryPower);
-  DEFINE_OP(BINARY_MODULO, BinaryModulo);
-
-  DEFINE_OP(BINARY_SUBSCR, BinarySubscr);
-  DEFINE_OP(BINARY_SUBSCR_LIST, BinarySubscrList);
-  DEFINE_OP(BINARY_SUBSCR_DICT, BinarySubscrDict);
-  DEFINE_OP(CONST_INDEX, ConstIndex);
-
-  BINARY_OP3(INPLACE_MULTIPLY, PyNumber_InPlaceMultiply, IntegerOps::mul, true);
-  BINARY_OP3(INPLACE_DIVIDE, PyNumber_InPlaceDivide, IntegerOps::div, true);
-  BINARY_OP3(INPLACE_ADD, PyNumber_InPlaceAdd, IntegerOps::add, true);
-  BINARY_OP3(INPLACE_SUBTRACT, PyNumber_InPlaceSubtract, IntegerOps::sub, true);
-  BINARY_OP3(INPLACE_MODULO, PyNumber_InPlaceRemainder, IntegerOps::mod, true);
-
-  BINARY_OP2(INPLACE_OR, PyNumber_InPlaceOr);
-  BINARY_OP2(INPLACE_XOR, PyNumber_InPlaceXor);
-  BINARY_OP2(INPLACE_AND, PyNumber_InPlaceAnd);
-  BINARY_OP2(INPLACE_RSHIFT, PyNumber_InPlaceRshift);
-  BINARY_OP2(INPLACE_LSHIFT, PyNumber_InPlaceLshift);
-  BINARY_OP2(INPLACE_TRUE_DIVIDE, PyNumber_InPlaceTrueDivide);
-  BINARY_OP2(INPLACE_FLOOR_DIVIDE, PyNumber_InPlaceFloorDivide);
-  DEFINE_OP(INPLACE_POWER, InplacePower);
-
-  UNARY_OP2(UNARY_INVERT, PyNumber_Invert);
-  UNARY_OP2(UNARY_CONVERT, PyObject_Repr);
-  UNARY_OP2(UNARY_NEGATIVE, PyNumber_Negative);
-  UNARY_OP2(UNARY_POSITIVE, PyNumber_Positive);
-
-  DEFINE_OP(UNARY_NOT, UnaryNot);
-
-  DEFINE_OP(LOAD_FAST, LoadFast);
-  DEFINE_OP(LOAD_LOCALS, LoadLocals);
-  DEFINE_OP(LOAD_NAME, LoadName);
-  DEFINE_OP(LOAD_ATTR, LoadAttr);
-
-  DEFINE_OP(STORE_NAME, StoreName);
-  DEFINE_OP(STORE_ATTR, StoreAttr);
-
-  DEFINE_OP(STORE_SUBSCR, StoreSubscr);
-  DEFINE_OP(STORE_SUBSCR_LIST, StoreSubscrList);
-  DEFINE_OP(STORE_SUBSCR_DICT, StoreSubscrDict);
-
-  DEFINE_OP(STORE_FAST, StoreFast);
-  DEFINE_OP(STORE_SLICE, StoreSlice);
-
-  DEFINE_OP(LOAD_GLOBAL, LoadGlobal);
-  DEFINE_OP(STORE_GLOBAL, StoreGlobal);
-  DEFINE_OP(DELETE_GLOBAL, DeleteGlobal);
-  DEFINE_OP(DELETE_NAME, DeleteName);
-
-  DEFINE_OP(LOAD_CLOSURE, LoadClosure);
-  DEFINE_OP(LOAD_DEREF, LoadDeref);
-  DEFINE_OP(STORE_DEREF, StoreDeref);
-
-  DEFINE_OP(GET_ITER, GetIter);
-  DEFINE_OP(FOR_ITER, ForIter);
-  DEFINE_OP(BREAK_LOOP, BreakLoop);
-
-  DEFINE_OP(BUILD_TUPLE, BuildTuple);
-  DEFINE_OP(BUILD_LIST, BuildList);
-  DEFINE_OP(BUILD_MAP, BuildMap);
-  DEFINE_OP(BUILD_SLICE, BuildSlice);
-
-  DEFINE_OP(STORE_MAP, StoreMap);
-
-  DEFINE_OP(PRINT_NEWLINE, PrintNewline);
-  DEFINE_OP(PRINT_NEWLINE_TO, PrintNewline);
-  DEFINE_OP(PRINT_ITEM, PrintItem);
-  DEFINE_OP(PRINT_ITEM_TO, PrintItem);
-
-  DEFINE_OP(CALL_FUNCTION, CallFunctionSimple);
-  DEFINE_OP(CALL_FUNCTION_VAR, CallFunctionVar);
-  DEFINE_OP(CALL_FUNCTION_KW, CallFunctionKw);
-  DEFINE_OP(CALL_FUNCTION_VAR_KW, CallFunctionVarKw);
-
-  FALLTHROUGH(POP_JUMP_IF_FALSE);
-  DEFINE_OP(JUMP_IF_FALSE_OR_POP, JumpIfFalseOrPop);
-
-  FALLTHROUGH(POP_JUMP_IF_TRUE);
-  DEFINE_OP(JUMP_IF_TRUE_OR_POP, JumpIfTrueOrPop);
-
-  DEFINE_OP(JUMP_ABSOLUTE, JumpAbsolute);
-  DEFINE_OP(COMPARE_OP, CompareOp);
-  DEFINE_OP(INCREF, IncRef);
-  DEFINE_OP(DECREF, DecRef);
-
-  DEFINE_OP(LIST_APPEND, ListAppend);
-
-  DEFINE_OP(DICT_CONTAINS, DictContains);
-  DEFINE_OP(DICT_GET, DictGet);
-  DEFINE_OP(DICT_GET_DEFAULT, DictGetDefault);
-
-  DEFINE_OP(SLICE, Slice);
-
-  DEFINE_OP(IMPORT_STAR, ImportStar);
-  DEFINE_OP(IMPORT_FROM, ImportFrom);
-  DEFINE_OP(IMPORT_NAME, ImportName);
-
-  DEFINE_OP(MAKE_FUNCTION, MakeFunction);
-  DEFINE_OP(MAKE_CLOSURE, MakeClosure);
-  DEFINE_OP(BUILD_CLASS, BuildClass);
-
-  DEFINE_OP(SETUP_EXCEPT, SetupExcept);
-  DEFINE_OP(SETUP_FINALLY, SetupFinally);
-  DEFINE_OP(RAISE_VARARGS, RaiseVarArgs);
-
-  BAD_OP(SETUP_LOOP);
-  BAD_OP(POP_BLOCK);
-  BAD_OP(LOAD_CONST);
-  BAD_OP(JUMP_FORWARD);
-  BAD_OP(MAP_ADD);
-  BAD_OP(SET_ADD);
-  BAD_OP(EXTENDED_ARG);
-  BAD_OP(SETUP_WITH);
-  BAD_OP(DELETE_FAST);
-  BAD_OP(CONTINUE_LOOP);
-  BAD_OP(BUILD_SET);
-  BAD_OP(DUP_TOPX);
-  BAD_OP(DELETE_ATTR);
-  BAD_OP(UNPACK_SEQUENCE);
-  BAD_OP(END_FINALLY);
-  BAD_OP(YIELD_VALUE);
-  BAD_OP(EXEC_STMT);
-  BAD_OP(WITH_CLEANUP);
-  BAD_OP(PRINT_EXPR);
-  BAD_OP(DELETE_SUBSCR);
-  BAD_OP(DELETE_SLICE);
-  BAD_OP(NOP);
-  BAD_OP(ROT_FOUR);
-  BAD_OP(DUP_TOP);
-  BAD_OP(ROT_THREE);
-  BAD_OP(ROT_TWO);
-  BAD_OP(POP_TOP);
+#include "reval_handlers.h"
 
   END_DISPATCH
 
-} catch (const RException &error) {
-  if (!frame->exc_handlers_.empty()) {
-    int handler_offset = frame->exc_handlers_.pop();
-    EVAL_LOG("Jumping to handler: %d", handler_offset);
-    pc = frame->instructions() + handler_offset;
-    JUMP_TO_NEXT;
-  }
-  Log_Info("ERROR: Leaving frame: %s", frame->str().c_str());
-
-  if (error.exception != NULL && !PyErr_Occurred()) {
-    PyErr_SetObject(error.exception, error.value);
+op_error:
+  {
+    const char* handler = find_handler(frame, pc);
+    if (handler != NULL) {
+      EVAL_LOG("Jumping to handler: %d", frame->offset(handler));
+      frame->error_pc_ = pc;
+      pc = handler;
+      JUMP_TO_NEXT;
+    }
   }
+  set_frame_error(frame, pc);
+  return Register((PyObject*) NULL);
 
-  PyFrameObject* py_frame = PyFrame_New(PyThreadState_GET(),
-      frame->code->code(),
-      frame->globals(),
-      frame->locals());
-  py_frame->f_lineno = 0;
-  PyTraceBack_Here(py_frame);
-  throw RException();
+} catch (const RException &error) {
+  set_frame_error(frame, pc, error);
+  return Register((PyObject*) NULL);
 }
   done: {
 //    EVAL_LOG("SUCCESS: Leaving frame: %s; result %s",
@@ -2374,3 +3952,304 @@ Register Evaluator::eval(RegisterFrame* f) {
     return *result;
   }
 }
+
+// A generator whose frame is run by Falcon.  The frame and its registers
+// live on the heap; YIELD_VALUE leaves Evaluator::eval with the frame
+// suspended, and each resumption enters eval again after it.
+struct FalconGenerator {
+  PyObject_HEAD
+  Evaluator* eval;
+  // NULL once the generator has finished.
+  RegisterFrame* frame;
+  PyObject* code;
+  int running;
+  // The Python frame gi_frame last showed, if any.
+  PyObject* pyframe;
+  PyObject* weakreflist;
+};
+
+static void gen_finish(FalconGenerator* gen) {
+  RegisterFrame* frame = gen->frame;
+  gen->frame = NULL;
+  delete frame;
+  Py_CLEAR(gen->pyframe);
+}
+
+// Resume gen, sending it arg, or with exc raising the current error at
+// the YIELD_VALUE it is suspended at.  Returns the next value yielded, or
+// NULL once the generator finishes: with an error set if it raised, or
+// with StopIteration if it returned and arg isn't NULL, as for next().
+static PyObject* gen_send(FalconGenerator* gen, PyObject* arg, bool exc) {
+  RegisterFrame* frame = gen->frame;
+  if (gen->running) {
+    PyErr_SetString(PyExc_ValueError, "generator already executing");
+    return NULL;
+  }
+  if (frame == NULL) {
+    if (arg != NULL && !exc) {
+      PyErr_SetNone(PyExc_StopIteration);
+    }
+    return NULL;
+  }
+
+  const char* yield_pc = frame->yield_pc_;
+  if (yield_pc == NULL) {
+    if (exc) {
+      // Raised before the first instruction, so nothing can catch it.
+      set_frame_error(frame, NULL);
+      gen_finish(gen);
+      flush_traceback();
+      return NULL;
+    }
+    if (arg != NULL && arg != Py_None) {
+      PyErr_SetString(PyExc_TypeError, "can't send non-None value to a just-started generator");
+      return NULL;
+    }
+  } else if (exc) {
+    const char* handler = find_handler(frame, yield_pc);
+    if (handler == NULL) {
+      set_frame_error(frame, yield_pc);
+      gen_finish(gen);
+      flush_traceback();
+      return NULL;
+    }
+    frame->error_pc_ = yield_pc;
+    frame->start_pc_ = handler;
+  } else {
+    RegOp<2>* op = (RegOp<2>*) yield_pc;
+    PyObject* sent = arg != NULL ? arg : Py_None;
+    Py_INCREF(sent);
+    Register* registers = frame->registers;
+    STORE_REG(op->reg[1], sent);
+    frame->start_pc_ = yield_pc + op->size();
+  }
+
+  if (Py_EnterRecursiveCall((char*) "")) {
+    return NULL;
+  }
+  gen->running = 1;
+  frame->yield_pc_ = NULL;
+  Register result = gen->eval->eval(frame);
+  gen->running = 0;
+  Py_LeaveRecursiveCall();
+
+  if (frame->yield_pc_ != NULL) {
+    return result.as_obj();
+  }
+  gen_finish(gen);
+  if (result.is_null()) {
+    flush_traceback();
+    return NULL;
+  }
+  // Generators return None.
+  result.decref();
+  if (arg != NULL) {
+    PyErr_SetNone(PyExc_StopIteration);
+  }
+  return NULL;
+}
+
+static PyObject* gen_iternext(FalconGenerator* gen) {
+  return gen_send(gen, NULL, false);
+}
+
+static PyObject* gen_send_method(FalconGenerator* gen, PyObject* arg) {
+  return gen_send(gen, arg, false);
+}
+
+static PyObject* gen_throw(FalconGenerator* gen, PyObject* args) {
+  PyObject* type;
+  PyObject* value = NULL;
+  PyObject* tb = NULL;
+  if (!PyArg_UnpackTuple(args, "throw", 1, 3, &type, &value, &tb)) {
+    return NULL;
+  }
+  Py_INCREF(type);
+  Py_XINCREF(value);
+  Py_XINCREF(tb);
+  // As in CPython, invalid arguments are the caller's error, and leave
+  // the generator as it was.
+  if (!do_raise(type, value, tb)) {
+    return NULL;
+  }
+  return gen_send(gen, Py_None, true);
+}
+
+// As CPython's gen_close: raise GeneratorExit where gen is suspended,
+// which must either finish it or leave it by raising.
+static PyObject* gen_close(FalconGenerator* gen, PyObject* unused) {
+  PyErr_SetNone(PyExc_GeneratorExit);
+  PyObject* result = gen_send(gen, Py_None, true);
+  if (result != NULL) {
+    Py_DECREF(result);
+    PyErr_SetString(PyExc_RuntimeError, "generator ignored GeneratorExit");
+    return NULL;
+  }
+  if (PyErr_ExceptionMatches(PyExc_StopIteration) || PyErr_ExceptionMatches(PyExc_GeneratorExit)) {
+    PyErr_Clear();
+    Py_RETURN_NONE;
+  }
+  return NULL;
+}
+
+static void gen_dealloc(FalconGenerator* gen) {
+  PyObject_GC_UnTrack(gen);
+  if (gen->weakreflist != NULL) {
+    PyObject_ClearWeakRefs((PyObject*) gen);
+  }
+  // Only a try block could run code on the way out, so other frames are
+  // just dropped.  Nothing else can reach gen, which needn't be revived
+  // as CPython's are.
+  RegisterFrame* frame = gen->frame;
+  if (frame != NULL && frame->yield_pc_ != NULL && find_handler(frame, frame->yield_pc_) != NULL) {
+    // gen may be dropped by a frame an exception is leaving, whose
+    // pending frames are set aside with it.
+    PyObject* type;
+    PyObject* value;
+    PyObject* tb;
+    PendingTraceback pending;
+    PyErr_Fetch(&type, &value, &tb);
+    pending.swap(*PendingTraceback::current());
+    PyObject* result = gen_close(gen, NULL);
+    if (result == NULL) {
+      PyErr_WriteUnraisable(gen->code);
+    } else {
+      Py_DECREF(result);
+    }
+    clear_traceback();
+    pending.swap(*PendingTraceback::current());
+    PyErr_Restore(type, value, tb);
+  }
+  gen_finish(gen);
+  Py_DECREF(gen->code);
+  PyObject_GC_Del(gen);
+}
+
+static int gen_traverse(FalconGenerator* gen, visitproc visit, void* arg) {
+  RegisterFrame* frame = gen->frame;
+  if (frame == NULL) {
+    return 0;
+  }
+  // The constants are borrowed from the code.
+  for (int i = frame->code->num_consts(); i < frame->code->num_registers; ++i) {
+    Register& r = frame->registers[i];
+    if (r.is_obj() && !r.is_null()) {
+      Py_VISIT(r.as_obj());
+    }
+  }
+  for (int i = 0; i < frame->code->num_cells; ++i) {
+    Py_VISIT(frame->freevars[i]);
+  }
+  Py_VISIT(gen->pyframe);
+  return 0;
+}
+
+static int gen_clear(FalconGenerator* gen) {
+  gen_finish(gen);
+  return 0;
+}
+
+static PyObject* gen_repr(FalconGenerator* gen) {
+  return PyString_FromFormat("<generator object %.200s at %p>",
+                             PyString_AsString(((PyCodeObject*) gen->code)->co_name), gen);
+}
+
+// A Python frame standing in for that of gen, at the yield it is
+// suspended at, or None once it has finished.  Unless gen was made with a
+// frame of its own, the frame doesn't show its locals.
+static PyObject* gen_get_frame(FalconGenerator* gen, void* unused) {
+  RegisterFrame* frame = gen->frame;
+  if (frame == NULL) {
+    Py_RETURN_NONE;
+  }
+  PendingFrame f = frame_position(frame, frame->yield_pc_);
+  PyFrameObject* py_frame = (PyFrameObject*) f.pyframe;
+  if (py_frame == NULL) {
+    if (gen->pyframe == NULL) {
+      py_frame = PyFrame_New(PyThreadState_GET(), (PyCodeObject*) f.code, f.globals, f.locals);
+      if (py_frame == NULL) {
+        return NULL;
+      }
+      // A suspended generator has no caller.
+      Py_CLEAR(py_frame->f_back);
+      gen->pyframe = (PyObject*) py_frame;
+    }
+    py_frame = (PyFrameObject*) gen->pyframe;
+  }
+  py_frame->f_lasti = f.lasti;
+  py_frame->f_lineno = f.line;
+  Py_INCREF(py_frame);
+  return (PyObject*) py_frame;
+}
+
+static PyGetSetDef gen_getset[] = {
+  { (char*) "gi_frame", (getter) gen_get_frame, NULL, NULL, NULL },
+  { NULL } /* sentinel */
+};
+
+static PyMethodDef gen_methods[] = {
+  { "send", (PyCFunction) gen_send_method, METH_O, NULL },
+  { "throw", (PyCFunction) gen_throw, METH_VARARGS, NULL },
+  { "close", (PyCFunction) gen_close, METH_NOARGS, NULL },
+  { NULL, NULL } /* sentinel */
+};
+
+static PyMemberDef gen_members[] = {
+  { (char*) "gi_running", T_INT, offsetof(FalconGenerator, running), READONLY, NULL },
+  { (char*) "gi_code", T_OBJECT, offsetof(FalconGenerator, code), READONLY, NULL },
+  { NULL } /* sentinel */
+};
+
+static PyTypeObject FalconGenerator_Type = {
+  PyVarObject_HEAD_INIT(&PyType_Type, 0) "generator", sizeof(FalconGenerator),
+  0,
+  (destructor)gen_dealloc, /* tp_dealloc */
+  0, /* tp_print */
+  0, /* tp_getattr */
+  0, /* tp_setattr */
+  0, /* tp_compare */
+  (reprfunc)gen_repr, /* tp_repr */
+  0, /* tp_as_number */
+  0, /* tp_as_sequence */
+  0, /* tp_as_mapping */
+  0, /* tp_hash */
+  0, /* tp_call */
+  0, /* tp_str */
+  PyObject_GenericGetAttr, /* tp_getattro */
+  0, /* tp_setattro */
+  0, /* tp_as_buffer */
+  Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC, /* tp_flags */
+  0, /* tp_doc */
+  (traverseproc)gen_traverse, /* tp_traverse */
+  (inquiry)gen_clear, /* tp_clear */
+  0, /* tp_richcompare */
+  offsetof(FalconGenerator, weakreflist), /* tp_weaklistoffset */
+  PyObject_SelfIter, /* tp_iter */
+  (iternextfunc)gen_iternext, /* tp_iternext */
+  gen_methods, /* tp_methods */
+  gen_members, /* tp_members */
+  gen_getset, /* tp_getset */
+};
+
+// Makes a generator running frame, a heap frame (see
+// RegisterFrame::move_registers_to_heap) which it takes over.
+static PyObject* new_generator(Evaluator* eval, RegisterFrame* frame) {
+  if (!(FalconGenerator_Type.tp_flags & Py_TPFLAGS_READY) && PyType_Ready(&FalconGenerator_Type) < 0) {
+    delete frame;
+    return NULL;
+  }
+  FalconGenerator* gen = PyObject_GC_New(FalconGenerator, &FalconGenerator_Type);
+  if (gen == NULL) {
+    delete frame;
+    return NULL;
+  }
+  gen->eval = eval;
+  gen->frame = frame;
+  gen->code = (PyObject*) frame->code->code();
+  Py_INCREF(gen->code);
+  gen->running = 0;
+  gen->pyframe = NULL;
+  gen->weakreflist = NULL;
+  PyObject_GC_Track(gen);
+  return (PyObject*) gen;
+}
@@ -93,15 +93,31 @@ struct SmallVector {
 
 typedef SmallVector<Register> ObjVector;
 
-struct Hint {
-  union {
-    PyObject* obj;
-    int dict_size;
-  } guard;
-
-  PyObject* key;
-  PyObject* value;
-  unsigned int version;
+// Keyword arguments, as given to a call by name.  Names and values are
+// borrowed.
+struct Keywords {
+  SmallVector<PyObject*> names;
+  ObjVector values;
+
+  int size() const {
+    return names.size();
+  }
+
+  PyObject* name(int i) const {
+    return names[i];
+  }
+
+  Register& value(int i) const {
+    return values[i];
+  }
+
+  // The parameter of code this keyword names, or -1.
+  int param(RegisterCode* code, int i) const;
+
+  void push_back(PyObject* name, const Register& value) {
+    names.push_back(name);
+    values.push_back(value);
+  }
 };
 
 class Noncopyable {
@@ -113,16 +129,62 @@ private:
   Noncopyable& operator=(const Noncopyable&);
 };
 
+// The registers of the running frames, as a stack of windows each just
+// the size a frame's code needs, so that calls neither take a frame's
+// worth of C stack nor touch more memory than they use.  Windows are
+// released in the reverse order to which they were taken.  Each thread
+// has its own, as the GIL can pass to another thread mid-frame.
+class RegisterFile: private Noncopyable {
+public:
+  static const int kSize = 1 << 18;
+
+  RegisterFile() {
+    base_ = new Register[kSize];
+    top_ = base_;
+    limit_ = base_ + kSize;
+  }
+
+  ~RegisterFile() {
+    delete[] base_;
+  }
+
+  // A window of n registers, or NULL if the file is full.
+  f_inline Register* push(int n) {
+    if (limit_ - top_ < n) {
+      return NULL;
+    }
+    Register* window = top_;
+    top_ += n;
+    return window;
+  }
+
+  // Releases window and any taken after it; false if it isn't ours.
+  f_inline bool pop(Register* window) {
+    if (window < base_ || window >= limit_) {
+      return false;
+    }
+    assert(window <= top_);
+    top_ = window;
+    return true;
+  }
+
+  static RegisterFile* current();
+
+private:
+  Register* base_;
+  Register* top_;
+  Register* limit_;
+};
+
 struct RegisterFrame: private Noncopyable {
 public:
+  Register* registers;
 #if STACK_ALLOC_REGISTERS
-  Register registers[kMaxRegisters];
-  PyObject* freevars[8];
+  PyObject* freevars[kMaxCells];
 #else
-  Register* registers;
   PyObject** freevars;
 #endif
-  const RegisterCode* code;
+  RegisterCode* code;
 
   PyObject* pyframe_;
   PyObject* builtins_;
@@ -131,9 +193,61 @@ public:
   PyObject* consts_;
   PyObject* names_;
 
-  SmallVector<int> exc_handlers_;
   const char* instructions_;
 
+  // Where Evaluator::eval starts: the first instruction, unless a
+  // generator is resuming the frame.
+  const char* start_pc_;
+
+  // The YIELD_VALUE a generator frame last left eval at, or NULL if it
+  // returned or raised.
+  const char* yield_pc_;
+
+  // The exception being handled when this frame first entered an except
+  // clause, restored when the frame exits.  NULL until then.
+  PyObject* saved_exc_type_;
+  PyObject* saved_exc_value_;
+  PyObject* saved_exc_tb_;
+
+  // The instruction which raised the error being handled, set on jumping
+  // to its except clause.
+  const char* error_pc_;
+
+  // Set by an instruction re-raising an exception along with its
+  // traceback, which then gains no entry for the instruction, as with
+  // ceval's WHY_RERAISE.  Cleared by the error's handler or on leaving.
+  bool reraised_;
+
+  // Make (type, value, tb) the exception being handled, as ceval does on
+  // entering an except clause.
+  void set_exc_info(PyObject* type, PyObject* value, PyObject* tb);
+
+  // Restore the exception saved by set_exc_info, as ceval does when a
+  // frame exits or yields.
+  void reset_exc_info();
+
+  // Move the registers off the thread's register file, for a frame which
+  // outlives the call that made it.
+  void move_registers_to_heap();
+
+  // One bit per register, set when LOAD_METHOD left an unbound function
+  // there.  Only read by the CALL_METHOD following each LOAD_METHOD, so
+  // it needs no initialization.
+  uint64_t unbound_methods_[(kMaxRegisters + 63) / 64];
+
+  f_inline void set_unbound_method(int reg, bool unbound) {
+    uint64_t bit = uint64_t(1) << (reg % 64);
+    if (unbound) {
+      unbound_methods_[reg / 64] |= bit;
+    } else {
+      unbound_methods_[reg / 64] &= ~bit;
+    }
+  }
+
+  f_inline bool is_unbound_method(int reg) const {
+    return (unbound_methods_[reg / 64] >> (reg % 64)) & 1;
+  }
+
 
   f_inline const char* instructions() {
     return instructions_;
@@ -179,22 +293,23 @@ public:
     return w.str();
   }
 
-  RegisterFrame(RegisterCode* func, PyObject* obj, const ObjVector& args, const ObjVector& kw, PyObject* globals = NULL, PyObject* locals = NULL);
+  // A frame for a call of obj with the positional arguments
+  // args[0..num_args) and the keyword arguments kw.  The argument lists
+  // are any of the kinds defined in reval.cc, where frames are made.
+  // Throws a TypeError if the arguments don't match the code's.
+  template<class ArgList, class KwList>
+  RegisterFrame(RegisterCode* func, PyObject* obj, const ArgList& args, int num_args, const KwList& kw,
+                PyObject* globals = NULL, PyObject* locals = NULL);
   RegisterFrame(RegisterCode* rcode, PyFrameObject* f);
   ~RegisterFrame();
 };
 
 class Evaluator {
-public:
-  Hint hints[kMaxHints + 1];
 private:
   void collect_info(int opcode);
   int32_t op_counts_[256];
   int64_t op_times_[256];
 
-  int64_t hint_hits_;
-  int64_t hint_misses_;
-
   int32_t total_count_;
   int64_t last_clock_;
 
@@ -0,0 +1,180 @@
+// The operation handlers of the evaluator, other than RETURN_VALUE,
+// YIELD_VALUE and STOP_CODE, as invocations of the *_OP macros in
+// reval.cc.  Included into the body of Evaluator::eval, and with
+// USE_TAILCALL_DISPATCH also at namespace scope, where each expands to a
+// function.
+BINARY_OP3(BINARY_MULTIPLY, PyNumber_Multiply, IntegerOps::mul, IntegerOps::mul_overflowed);
+BINARY_OP3(BINARY_DIVIDE, PyNumber_Divide, IntegerOps::floor_div, IntegerOps::div_overflowed);
+BINARY_OP3(BINARY_ADD, PyNumber_Add, IntegerOps::add, IntegerOps::add_overflowed);
+BINARY_OP3(BINARY_SUBTRACT, PyNumber_Subtract, IntegerOps::sub, IntegerOps::sub_overflowed);
+BINARY_OP3(BINARY_OR, PyNumber_Or, IntegerOps::Or, IntegerOps::never_overflows);
+BINARY_OP3(BINARY_XOR, PyNumber_Xor, IntegerOps::Xor, IntegerOps::never_overflows);
+BINARY_OP3(BINARY_AND, PyNumber_And, IntegerOps::And, IntegerOps::never_overflows);
+BINARY_OP3(BINARY_RSHIFT, PyNumber_Rshift, IntegerOps::Rshift, IntegerOps::shift_overflowed);
+BINARY_OP3(BINARY_LSHIFT, PyNumber_Lshift, IntegerOps::Lshift, IntegerOps::lshift_overflowed);
+BINARY_OP2(BINARY_TRUE_DIVIDE, PyNumber_TrueDivide);
+BINARY_OP2(BINARY_FLOOR_DIVIDE, PyNumber_FloorDivide);
+
+BINARY_OP_IMM(BINARY_ADD_IMM, PyNumber_Add, IntegerOps::add, IntegerOps::add_overflowed);
+BINARY_OP_IMM(BINARY_SUBTRACT_IMM, PyNumber_Subtract, IntegerOps::sub, IntegerOps::sub_overflowed);
+BINARY_OP_IMM(BINARY_LSHIFT_IMM, PyNumber_Lshift, IntegerOps::Lshift, IntegerOps::lshift_overflowed);
+BINARY_OP_IMM(BINARY_RSHIFT_IMM, PyNumber_Rshift, IntegerOps::arith_rshift, IntegerOps::never_overflows);
+BINARY_OP_IMM(BINARY_AND_IMM, PyNumber_And, IntegerOps::And, IntegerOps::never_overflows);
+BINARY_OP_IMM(BINARY_OR_IMM, PyNumber_Or, IntegerOps::Or, IntegerOps::never_overflows);
+BINARY_OP_IMM(BINARY_XOR_IMM, PyNumber_Xor, IntegerOps::Xor, IntegerOps::never_overflows);
+BINARY_OP_IMM(INPLACE_ADD_IMM, PyNumber_InPlaceAdd, IntegerOps::add, IntegerOps::add_overflowed);
+BINARY_OP_IMM(INPLACE_SUBTRACT_IMM, PyNumber_InPlaceSubtract, IntegerOps::sub, IntegerOps::sub_overflowed);
+
+BINARY_OP_FLOAT(BINARY_ADD_FLOAT, BINARY_ADD, PyNumber_Add, FloatOps::add);
+BINARY_OP_FLOAT(BINARY_SUBTRACT_FLOAT, BINARY_SUBTRACT, PyNumber_Subtract, FloatOps::sub);
+BINARY_OP_FLOAT(BINARY_MULTIPLY_FLOAT, BINARY_MULTIPLY, PyNumber_Multiply, FloatOps::mul);
+BINARY_OP_FLOAT(INPLACE_ADD_FLOAT, INPLACE_ADD, PyNumber_InPlaceAdd, FloatOps::add);
+BINARY_OP_FLOAT(INPLACE_SUBTRACT_FLOAT, INPLACE_SUBTRACT, PyNumber_InPlaceSubtract, FloatOps::sub);
+BINARY_OP_FLOAT(INPLACE_MULTIPLY_FLOAT, INPLACE_MULTIPLY, PyNumber_InPlaceMultiply, FloatOps::mul);
+
+DEFINE_OP(BINARY_POWER, BinaryPower);
+DEFINE_OP(BINARY_MODULO, BinaryModulo);
+
+DEFINE_OP(BINARY_SUBSCR, BinarySubscr);
+DEFINE_OP(BINARY_SUBSCR_LIST, BinarySubscrList);
+DEFINE_OP(BINARY_SUBSCR_DICT, BinarySubscrDict);
+DEFINE_OP(CONST_INDEX, ConstIndex);
+
+BINARY_OP3(INPLACE_MULTIPLY, PyNumber_InPlaceMultiply, IntegerOps::mul, IntegerOps::mul_overflowed);
+BINARY_OP3(INPLACE_DIVIDE, PyNumber_InPlaceDivide, IntegerOps::floor_div, IntegerOps::div_overflowed);
+BINARY_OP3(INPLACE_ADD, PyNumber_InPlaceAdd, IntegerOps::add, IntegerOps::add_overflowed);
+BINARY_OP3(INPLACE_SUBTRACT, PyNumber_InPlaceSubtract, IntegerOps::sub, IntegerOps::sub_overflowed);
+BINARY_OP3(INPLACE_MODULO, PyNumber_InPlaceRemainder, IntegerOps::floor_mod, IntegerOps::div_overflowed);
+
+BINARY_OP2(INPLACE_OR, PyNumber_InPlaceOr);
+BINARY_OP2(INPLACE_XOR, PyNumber_InPlaceXor);
+BINARY_OP2(INPLACE_AND, PyNumber_InPlaceAnd);
+BINARY_OP2(INPLACE_RSHIFT, PyNumber_InPlaceRshift);
+BINARY_OP2(INPLACE_LSHIFT, PyNumber_InPlaceLshift);
+BINARY_OP2(INPLACE_TRUE_DIVIDE, PyNumber_InPlaceTrueDivide);
+BINARY_OP2(INPLACE_FLOOR_DIVIDE, PyNumber_InPlaceFloorDivide);
+DEFINE_OP(INPLACE_POWER, InplacePower);
+
+UNARY_OP2(UNARY_INVERT, PyNumber_Invert);
+UNARY_OP2(UNARY_CONVERT, PyObject_Repr);
+UNARY_OP2(UNARY_NEGATIVE, PyNumber_Negative);
+UNARY_OP2(UNARY_POSITIVE, PyNumber_Positive);
+
+DEFINE_OP(UNARY_NOT, UnaryNot);
+
+DEFINE_OP(LOAD_FAST, LoadFast);
+DEFINE_OP(LOAD_LOCALS, LoadLocals);
+DEFINE_OP(LOAD_NAME, LoadName);
+DEFINE_OP(LOAD_ATTR, LoadAttr);
+DEFINE_OP(LOAD_ATTR_MODULE, LoadAttrModule);
+DEFINE_OP(LOAD_METHOD, LoadMethod);
+
+DEFINE_OP(STORE_NAME, StoreName);
+DEFINE_OP(STORE_ATTR, StoreAttr);
+
+DEFINE_OP(STORE_SUBSCR, StoreSubscr);
+DEFINE_OP(STORE_SUBSCR_LIST, StoreSubscrList);
+DEFINE_OP(STORE_SUBSCR_DICT, StoreSubscrDict);
+
+DEFINE_OP(STORE_FAST, StoreFast);
+DEFINE_OP(STORE_SLICE, StoreSlice);
+
+DEFINE_OP(LOAD_GLOBAL, LoadGlobal);
+DEFINE_OP(STORE_GLOBAL, StoreGlobal);
+DEFINE_OP(DELETE_GLOBAL, DeleteGlobal);
+DEFINE_OP(DELETE_NAME, DeleteName);
+
+DEFINE_OP(LOAD_CLOSURE, LoadClosure);
+DEFINE_OP(LOAD_DEREF, LoadDeref);
+DEFINE_OP(STORE_DEREF, StoreDeref);
+
+DEFINE_OP(GET_ITER, GetIter);
+DEFINE_OP(FOR_ITER, ForIter);
+DEFINE_OP(BREAK_LOOP, BreakLoop);
+
+DEFINE_OP(BUILD_TUPLE, BuildTuple);
+DEFINE_OP(BUILD_LIST, BuildList);
+DEFINE_OP(BUILD_MAP, BuildMap);
+DEFINE_OP(BUILD_SLICE, BuildSlice);
+
+DEFINE_OP(STORE_MAP, StoreMap);
+
+DEFINE_OP(PRINT_NEWLINE, PrintNewline);
+DEFINE_OP(PRINT_NEWLINE_TO, PrintNewline);
+DEFINE_OP(PRINT_ITEM, PrintItem);
+DEFINE_OP(PRINT_ITEM_TO, PrintItem);
+
+DEFINE_OP(CALL_FUNCTION, CallFunctionSimple);
+DEFINE_OP(CALL_FUNCTION_VAR, CallFunctionVar);
+DEFINE_OP(CALL_FUNCTION_KW, CallFunctionKw);
+DEFINE_OP(CALL_FUNCTION_VAR_KW, CallFunctionVarKw);
+DEFINE_OP(CALL_METHOD, CallMethod);
+
+DEFINE_OP(POP_JUMP_IF_FALSE, JumpIfFalseOrPop);
+DEFINE_OP(JUMP_IF_FALSE_OR_POP, JumpIfFalseOrPop);
+
+DEFINE_OP(POP_JUMP_IF_TRUE, JumpIfTrueOrPop);
+DEFINE_OP(JUMP_IF_TRUE_OR_POP, JumpIfTrueOrPop);
+
+DEFINE_OP(JUMP_ABSOLUTE, JumpAbsolute);
+DEFINE_OP(GUARD_FUNCTION, GuardFunction);
+DEFINE_OP(COMPARE_OP, CompareOp);
+DEFINE_OP(COMPARE_AND_BRANCH_IF_FALSE, CompareAndBranch<false>);
+DEFINE_OP(COMPARE_AND_BRANCH_IF_TRUE, CompareAndBranch<true>);
+DEFINE_OP(COMPARE_OP_FLOAT, CompareOpFloat);
+DEFINE_OP(COMPARE_OP_IMM, CompareOpImm);
+DEFINE_OP(COMPARE_AND_BRANCH_IF_FALSE_IMM, CompareAndBranchImm<false>);
+DEFINE_OP(COMPARE_AND_BRANCH_IF_TRUE_IMM, CompareAndBranchImm<true>);
+DEFINE_OP(INCREF, IncRef);
+DEFINE_OP(DECREF, DecRef);
+
+DEFINE_OP(LIST_APPEND, ListAppend);
+
+DEFINE_OP(DICT_CONTAINS, DictContains);
+DEFINE_OP(DICT_GET, DictGet);
+DEFINE_OP(DICT_GET_DEFAULT, DictGetDefault);
+
+SUPERINSTRUCTION_HANDLERS(SUPER_OP2, SUPER_OP3)
+
+DEFINE_OP(SLICE, Slice);
+
+DEFINE_OP(IMPORT_STAR, ImportStar);
+DEFINE_OP(IMPORT_FROM, ImportFrom);
+DEFINE_OP(IMPORT_NAME, ImportName);
+
+DEFINE_OP(MAKE_FUNCTION, MakeFunction);
+DEFINE_OP(MAKE_CLOSURE, MakeClosure);
+DEFINE_OP(BUILD_CLASS, BuildClass);
+
+DEFINE_OP(RAISE_VARARGS, RaiseVarArgs);
+DEFINE_OP(LOAD_EXCEPTION, LoadException);
+DEFINE_OP(END_FINALLY, EndFinally);
+DEFINE_OP(CATCH_STOP_ITERATION, CatchStopIteration);
+
+BAD_OP(SETUP_LOOP);
+BAD_OP(POP_BLOCK);
+BAD_OP(LOAD_CONST);
+BAD_OP(JUMP_FORWARD);
+BAD_OP(MAP_ADD);
+BAD_OP(SET_ADD);
+BAD_OP(EXTENDED_ARG);
+BAD_OP(SETUP_WITH);
+BAD_OP(DELETE_FAST);
+BAD_OP(CONTINUE_LOOP);
+BAD_OP(BUILD_SET);
+BAD_OP(DUP_TOPX);
+BAD_OP(DELETE_ATTR);
+BAD_OP(UNPACK_SEQUENCE);
+BAD_OP(SETUP_EXCEPT);
+BAD_OP(SETUP_FINALLY);
+BAD_OP(EXEC_STMT);
+BAD_OP(WITH_CLEANUP);
+BAD_OP(PRINT_EXPR);
+BAD_OP(DELETE_SUBSCR);
+BAD_OP(DELETE_SLICE);
+BAD_OP(NOP);
+BAD_OP(ROT_FOUR);
+BAD_OP(DUP_TOP);
+BAD_OP(ROT_THREE);
+BAD_OP(ROT_TWO);
+BAD_OP(POP_TOP);
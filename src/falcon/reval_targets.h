@@ -0,0 +1,191 @@
+// The handler for each opcode, in opcode order, for the threaded
+// evaluators.  Included into an array initializer with OFFSET(opname)
+// defined as the address of the handler for opname.
+//
+// The index of each offset MUST correspond to the opcode number!
+OFFSET(STOP_CODE),
+OFFSET(POP_TOP),
+OFFSET(ROT_TWO),
+OFFSET(ROT_THREE),
+OFFSET(DUP_TOP),
+OFFSET(ROT_FOUR),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(NOP),
+OFFSET(UNARY_POSITIVE),
+OFFSET(UNARY_NEGATIVE),
+OFFSET(UNARY_NOT),
+OFFSET(UNARY_CONVERT),
+OFFSET(STOP_CODE),
+OFFSET(UNARY_INVERT),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(BINARY_POWER),
+OFFSET(BINARY_MULTIPLY),
+OFFSET(BINARY_DIVIDE),
+OFFSET(BINARY_MODULO),
+OFFSET(BINARY_ADD),
+OFFSET(BINARY_SUBTRACT),
+OFFSET(BINARY_SUBSCR),
+OFFSET(BINARY_FLOOR_DIVIDE),
+OFFSET(BINARY_TRUE_DIVIDE),
+OFFSET(INPLACE_FLOOR_DIVIDE),
+OFFSET(INPLACE_TRUE_DIVIDE),
+OFFSET(SLICE),
+OFFSET(SLICE),
+OFFSET(SLICE),
+OFFSET(SLICE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STORE_SLICE),
+OFFSET(STORE_SLICE),
+OFFSET(STORE_SLICE),
+OFFSET(STORE_SLICE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(DELETE_SLICE),
+OFFSET(DELETE_SLICE),
+OFFSET(DELETE_SLICE),
+OFFSET(DELETE_SLICE),
+OFFSET(STORE_MAP),
+OFFSET(INPLACE_ADD),
+OFFSET(INPLACE_SUBTRACT),
+OFFSET(INPLACE_MULTIPLY),
+OFFSET(INPLACE_DIVIDE),
+OFFSET(INPLACE_MODULO),
+OFFSET(STORE_SUBSCR),
+OFFSET(DELETE_SUBSCR),
+OFFSET(BINARY_LSHIFT),
+OFFSET(BINARY_RSHIFT),
+OFFSET(BINARY_AND),
+OFFSET(BINARY_XOR),
+OFFSET(BINARY_OR),
+OFFSET(INPLACE_POWER),
+OFFSET(GET_ITER),
+OFFSET(STOP_CODE),
+OFFSET(PRINT_EXPR),
+OFFSET(PRINT_ITEM),
+OFFSET(PRINT_NEWLINE),
+OFFSET(PRINT_ITEM_TO),
+OFFSET(PRINT_NEWLINE_TO),
+OFFSET(INPLACE_LSHIFT),
+OFFSET(INPLACE_RSHIFT),
+OFFSET(INPLACE_AND),
+OFFSET(INPLACE_XOR),
+OFFSET(INPLACE_OR),
+OFFSET(BREAK_LOOP),
+OFFSET(WITH_CLEANUP),
+OFFSET(LOAD_LOCALS),
+OFFSET(RETURN_VALUE),
+OFFSET(IMPORT_STAR),
+OFFSET(EXEC_STMT),
+OFFSET(YIELD_VALUE),
+OFFSET(POP_BLOCK),
+OFFSET(END_FINALLY),
+OFFSET(BUILD_CLASS),
+OFFSET(STORE_NAME),
+OFFSET(DELETE_NAME),
+OFFSET(UNPACK_SEQUENCE),
+OFFSET(FOR_ITER),
+OFFSET(LIST_APPEND),
+OFFSET(STORE_ATTR),
+OFFSET(DELETE_ATTR),
+OFFSET(STORE_GLOBAL),
+OFFSET(DELETE_GLOBAL),
+OFFSET(DUP_TOPX),
+OFFSET(LOAD_CONST),
+OFFSET(LOAD_NAME),
+OFFSET(BUILD_TUPLE),
+OFFSET(BUILD_LIST),
+OFFSET(BUILD_SET),
+OFFSET(BUILD_MAP),
+OFFSET(LOAD_ATTR),
+OFFSET(COMPARE_OP),
+OFFSET(IMPORT_NAME),
+OFFSET(IMPORT_FROM),
+OFFSET(JUMP_FORWARD),
+OFFSET(JUMP_IF_FALSE_OR_POP),
+OFFSET(JUMP_IF_TRUE_OR_POP),
+OFFSET(JUMP_ABSOLUTE),
+OFFSET(POP_JUMP_IF_FALSE),
+OFFSET(POP_JUMP_IF_TRUE),
+OFFSET(LOAD_GLOBAL),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(CONTINUE_LOOP),
+OFFSET(SETUP_LOOP),
+OFFSET(SETUP_EXCEPT),
+OFFSET(SETUP_FINALLY),
+OFFSET(STOP_CODE),
+OFFSET(LOAD_FAST),
+OFFSET(STORE_FAST),
+OFFSET(DELETE_FAST),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(RAISE_VARARGS),
+OFFSET(CALL_FUNCTION),
+OFFSET(MAKE_FUNCTION),
+OFFSET(BUILD_SLICE),
+OFFSET(MAKE_CLOSURE),
+OFFSET(LOAD_CLOSURE),
+OFFSET(LOAD_DEREF),
+OFFSET(STORE_DEREF),
+OFFSET(STOP_CODE),
+OFFSET(STOP_CODE),
+OFFSET(CALL_FUNCTION_VAR),
+OFFSET(CALL_FUNCTION_KW),
+OFFSET(CALL_FUNCTION_VAR_KW),
+OFFSET(SETUP_WITH),
+OFFSET(STOP_CODE),
+OFFSET(EXTENDED_ARG),
+OFFSET(SET_ADD),
+OFFSET(MAP_ADD),
+OFFSET(INCREF),
+OFFSET(DECREF),
+OFFSET(CONST_INDEX),
+OFFSET(BINARY_SUBSCR_LIST),
+OFFSET(BINARY_SUBSCR_DICT),
+OFFSET(STORE_SUBSCR_LIST),
+OFFSET(STORE_SUBSCR_DICT),
+OFFSET(DICT_CONTAINS),
+OFFSET(DICT_GET),
+OFFSET(DICT_GET_DEFAULT),
+OFFSET(COMPARE_AND_BRANCH_IF_FALSE),
+OFFSET(COMPARE_AND_BRANCH_IF_TRUE),
+OFFSET(BINARY_ADD_IMM),
+OFFSET(BINARY_SUBTRACT_IMM),
+OFFSET(BINARY_LSHIFT_IMM),
+OFFSET(BINARY_RSHIFT_IMM),
+OFFSET(BINARY_AND_IMM),
+OFFSET(BINARY_OR_IMM),
+OFFSET(BINARY_XOR_IMM),
+OFFSET(INPLACE_ADD_IMM),
+OFFSET(INPLACE_SUBTRACT_IMM),
+OFFSET(COMPARE_OP_IMM),
+OFFSET(COMPARE_AND_BRANCH_IF_FALSE_IMM),
+OFFSET(COMPARE_AND_BRANCH_IF_TRUE_IMM),
+OFFSET(BINARY_ADD_FLOAT),
+OFFSET(BINARY_SUBTRACT_FLOAT),
+OFFSET(BINARY_MULTIPLY_FLOAT),
+OFFSET(INPLACE_ADD_FLOAT),
+OFFSET(INPLACE_SUBTRACT_FLOAT),
+OFFSET(INPLACE_MULTIPLY_FLOAT),
+OFFSET(COMPARE_OP_FLOAT),
+OFFSET(LOAD_ATTR_MODULE),
+OFFSET(LOAD_METHOD),
+OFFSET(CALL_METHOD),
+OFFSET(LOAD_EXCEPTION),
+OFFSET(GUARD_FUNCTION),
+OFFSET(CATCH_STOP_ITERATION),
+SUPERINSTRUCTIONS(SUPER_OFFSET2, SUPER_OFFSET3)
@@ -1,5 +1,7 @@
 #include "rinst.h"
 
+#include <algorithm>
+
 static bool objstr_enabled() {
   static bool _enabled = getenv("WITH_OBJSTR") != NULL;
   return _enabled;
@@ -19,10 +21,58 @@ static void print_register(Writer& w, Register* registers, int reg_num) {
   }
 }
 
+void RegisterCode::map_labels(const void* const* labels) {
+#if USE_DIRECT_THREADING
+  for (size_t i = 0; i < op_offsets.size(); ++i) {
+    OpHeader* op = (OpHeader*) &instructions[op_offsets[i]];
+    op->code = (OpCode) labels[(uint8_t) opcodes[op_offsets[i]]];
+  }
+#endif
+  this->labels = labels;
+  mapped_labels = 1;
+}
+
+void RegisterCode::set_opcode(size_t offset, int opcode) {
+  OpHeader* op = (OpHeader*) &instructions[offset];
+  opcodes[offset] = (char) opcode;
+#if USE_DIRECT_THREADING
+  if (mapped_labels) {
+    op->code = (OpCode) labels[opcode];
+    return;
+  }
+#endif
+  op->code = opcode;
+}
+
+void RegisterCode::deoptimize(const char* pc, int generic) {
+  size_t offset = pc - instructions.data();
+  if ((uint8_t) deopts[offset] < kMaxDeopts) {
+    ++deopts[offset];
+  }
+  set_opcode(offset, generic);
+}
+
+int RegisterCode::find_handler(JumpLoc offset) const {
+  auto iter = std::upper_bound(exception_handlers.begin(), exception_handlers.end(), offset,
+                               [](JumpLoc o, const ExceptionHandler& h) { return o < h.start; });
+  if (iter == exception_handlers.begin()) {
+    return -1;
+  }
+  --iter;
+  return offset < iter->end ? iter->handler : -1;
+}
+
+const LineEntry& RegisterCode::find_line(JumpLoc offset) const {
+  auto iter = std::upper_bound(line_table.begin(), line_table.end(), offset,
+                               [](JumpLoc o, const LineEntry& e) { return o < e.start; });
+  assert(iter != line_table.begin());
+  return *(iter - 1);
+}
+
 template<int num_registers>
-std::string RegOp<num_registers>::str(Register* registers) const {
+std::string RegOp<num_registers>::str(int opcode, Register* registers) const {
   StringWriter w;
-  w.printf("%s.%d (", OpUtil::name(code), arg);
+  w.printf("%s.%d (", OpUtil::name(opcode), arg);
   for (int i = 0; i < num_registers; ++i) {
     print_register(w, registers, reg[i]);
   }
@@ -30,9 +80,9 @@ std::string RegOp<num_registers>::str(Register* registers) const {
   return w.str();
 }
 
-std::string VarRegOp::str(Register* registers) const {
+std::string VarRegOp::str(int opcode, Register* registers) const {
   StringWriter w;
-  w.printf("%s.%d (", OpUtil::name(code), arg);
+  w.printf("%s.%d (", OpUtil::name(opcode), arg);
   for (int i = 0; i < num_registers; ++i) {
     print_register(w, registers, reg[i]);
   }
@@ -41,9 +91,13 @@ std::string VarRegOp::str(Register* registers) const {
 }
 
 template<int num_registers>
-std::string BranchOp<num_registers>::str(Register* registers) const {
+std::string BranchOp<num_registers>::str(int opcode, Register* registers) const {
   StringWriter w;
-  w.printf("%s (", OpUtil::name(code));
+  if (OpUtil::has_arg(opcode)) {
+    w.printf("%s.%d (", OpUtil::name(opcode), arg);
+  } else {
+    w.printf("%s (", OpUtil::name(opcode));
+  }
   for (int i = 0; i < num_registers; ++i) {
     print_register(w, registers, reg[i]);
   }
@@ -52,6 +106,26 @@ std::string BranchOp<num_registers>::str(Register* registers) const {
   return w.str();
 }
 
+std::string ImmRegOp::str(int opcode, Register* registers) const {
+  StringWriter w;
+  w.printf("%s.%d (", OpUtil::name(opcode), arg);
+  for (int i = 0; i < 3; ++i) {
+    print_register(w, registers, reg[i]);
+  }
+  w.printf(") #%d", imm);
+  return w.str();
+}
+
+std::string ImmBranchOp::str(int opcode, Register* registers) const {
+  StringWriter w;
+  w.printf("%s.%d (", OpUtil::name(opcode), arg);
+  for (int i = 0; i < 2; ++i) {
+    print_register(w, registers, reg[i]);
+  }
+  w.printf(") #%d -> [%d]", imm, label);
+  return w.str();
+}
+
 template struct RegOp<0> ;
 template struct RegOp<1> ;
 template struct RegOp<2> ;
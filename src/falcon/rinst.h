@@ -10,6 +10,7 @@
 #include "register.h"
 
 #include <string>
+#include <vector>
 
 #pragma warning(disable: 4200)
 
@@ -67,6 +68,9 @@ struct RefHelper {
 
 
 static const int kMaxRegisters = MAX_REGISTERS;
+// Cell and free variables held in a frame; functions with more are left
+// to CPython.
+static const int kMaxCells = 8;
 #if MAX_REGISTERS <= 256
   typedef uint8_t RegisterOffset;
 #else
@@ -78,20 +82,123 @@ static const RegisterOffset kInvalidRegister = (RegisterOffset) -1;
 typedef uint16_t JumpLoc;
 typedef void* JumpAddr;
 
+#if USE_DIRECT_THREADING
+// The opcode field of an instruction is rewritten with the address of its
+// handler at load time (see RegisterCode::map_labels).
+typedef uintptr_t OpCode;
+#else
+typedef uint8_t OpCode;
+#endif
+
+// Each LOAD_ATTR and STORE_ATTR in a function gets its own slot in
+// RegisterCode::attr_caches, and each LOAD_GLOBAL one in global_caches, up
+// to kMaxHints of each.  The rest are left with kInvalidHint and always
+// take the generic path.
 typedef uint8_t HintOffset;
-static const uint8_t kMaxHints = 223;
+static const uint8_t kMaxHints = 255;
 static const uint8_t kInvalidHint = kMaxHints;
 
-static inline size_t hint_offset(void* obj, void* name) {
-  return ((size_t(obj) ^ size_t(name)) >> 4) % kMaxHints;
-}
+// One entry of an attribute inline cache.  Entries are keyed on the type of
+// the object and its tp_version_tag, which CPython invalidates whenever the
+// type or one of its bases is modified.
+struct AttrCacheEntry {
+  PyTypeObject* type;
+  unsigned int version;
+
+  // The attribute as found on the type (NULL if it isn't), and its
+  // tp_descr_get.  Borrowed: the type keeps them alive for as long as the
+  // version matches.
+  PyObject* descr;
+  descrgetfunc getter;
+
+  // Data descriptors take precedence over the instance dictionary.
+  bool data_descr;
+
+  // Where the attribute was last found in the instance dictionary's table.
+  Py_ssize_t dict_index;
+};
+
+static const int kAttrCacheEntries = 4;
+
+// Inline cache for a LOAD_GLOBAL: where the name was last found, in the
+// globals or the builtins.  Python 2 dictionaries have no version, so this
+// is revalidated on each use: the same dictionary must still have the same
+// table, with the name at the same index.
+struct GlobalCache {
+  PyDictObject* dict;
+  PyDictEntry* table;
+  Py_ssize_t index;
+};
+
+// Inline cache for a CALL_FUNCTION or CALL_METHOD.
+//
+// A call with keyword arguments whose names are constants, up to
+// kMaxCachedKeywords of them, keeps the code it last bound to and the
+// parameter each keyword names in it (-1 for one left to **kwargs).
+// Other keyword calls resolve the names on each call.
+//
+// A call of a class keeps the class, keyed on its tp_version_tag, and
+// the __init__ it runs, or NULL if its instances can't be made
+// directly.  Borrowed: the class keeps it alive for as long as the
+// version matches.
+static const int kMaxCachedKeywords = 8;
+
+struct RegisterCode;
+
+struct CallCache {
+  bool constant_keywords;
+  RegisterCode* keyword_code;
+  int16_t params[kMaxCachedKeywords];
+
+  PyTypeObject* type;
+  unsigned int version;
+  PyObject* init;
+};
+
+// A polymorphic inline cache: one entry per type seen, replaced round-robin.
+struct AttrCache {
+  AttrCacheEntry entries[kAttrCacheEntries];
+  int next;
+};
+
+// The function inlined at a call site, which GUARD_FUNCTION compares the
+// callable against.  Both are owned: the inlined body borrows the
+// function's constants and globals.  For the builtin consuming a fused
+// generator expression, code is NULL.  Bodies which may read the globals
+// they were inlined with also need the frame to have the same ones, as
+// code can be shared by functions with different globals.
+struct InlineGuard {
+  PyObject* function;
+  PyObject* code;
+  bool same_globals;
+};
+
+// An entry of the exception table: errors raised by the instructions in
+// [start, end) continue at handler, the LOAD_EXCEPTION which begins the
+// except clause.
+struct ExceptionHandler {
+  JumpLoc start;
+  JumpLoc end;
+  JumpLoc handler;
+};
+
+// An entry of the line table: the instructions from start up to the next
+// entry were translated from Python bytecode on line, the first of it at
+// py_offset.
+struct LineEntry {
+  JumpLoc start;
+  int py_offset;
+  int line;
+};
 
 struct RegisterCode {
   int16_t num_registers;
   int16_t version;
   int16_t mapped_labels :1;
   int16_t mapped_registers :1;
-  int16_t reserved :14;
+  // Calls make a FalconGenerator running the frame (see reval.cc).
+  int16_t generator :1;
+  int16_t reserved :13;
 
   // The Python function object this code object was built from (NULL if
   // compiled directly from a code object).
@@ -103,12 +210,29 @@ struct RegisterCode {
   int16_t num_cellvars;
   int16_t num_cells;
 
+  // How a call binds to a frame, worked out when the code is compiled.
+  // The num_args arguments (a bound method's self first) fill the
+  // registers after the constants, followed by the *args tuple and
+  // **kwargs dictionary if the code takes them: num_arg_registers in
+  // all.  cell_args[i] is the argument cellvar i starts out holding, or
+  // -1 if it starts empty.  Defaults are left out: they belong to the
+  // function object, which can differ between functions sharing this
+  // code and can be reassigned.
+  int16_t num_args;
+  int16_t num_arg_registers;
+  std::vector<int16_t> cell_args;
+
   PyCodeObject* code() const {
     return (PyCodeObject*) code_;
   }
 
+  // The code object's names and constants, followed by those of any
+  // functions inlined into it.
+  PyObject* names_;
+  PyObject* consts_;
+
   PyObject* names() const {
-    return code()->co_names;
+    return names_;
   }
 
   PyObject* varnames() const {
@@ -116,10 +240,96 @@ struct RegisterCode {
   }
 
   PyObject* consts() const {
-    return code()->co_consts;
+    return consts_;
+  }
+
+  // The registers a frame starts with at [0, num_consts): borrowed
+  // references to the constants, copied into each frame as they are.
+  // Frames neither incref them on entry nor decref them on exit, so
+  // nothing may store into a constant's register.
+  std::vector<Register> const_pool;
+
+  int num_consts() const {
+    return const_pool.size();
   }
 
   std::string instructions;
+
+  // Inline caches, indexed by the hint_pos of LOAD_ATTR and STORE_ATTR
+  // instructions.
+  std::vector<AttrCache> attr_caches;
+
+  // Inline caches, indexed by the hint_pos of LOAD_GLOBAL instructions.
+  std::vector<GlobalCache> global_caches;
+
+  // Inline caches, indexed by the hint_pos of CALL_FUNCTION and
+  // CALL_METHOD instructions.
+  std::vector<CallCache> call_caches;
+
+  // Indexed by the arg of GUARD_FUNCTION instructions.
+  std::vector<InlineGuard> inline_guards;
+
+  // Opcode side-table, parallel to instructions: opcodes[i] is the opcode
+  // of the instruction starting at offset i.  Once labels are mapped, the
+  // instruction stream only holds handler addresses, so anything that needs
+  // the opcode (disassembly, logging) must come here.
+  std::string opcodes;
+
+  // Offsets of each instruction in the stream, in order.
+  std::vector<JumpLoc> op_offsets;
+
+  // The innermost except clause of each instruction in a try block, as
+  // ranges sorted by start.  Instructions outside of any try block have no
+  // entry, so entering a try block costs nothing at runtime.
+  std::vector<ExceptionHandler> exception_handlers;
+
+  // The offset of the handler for an error raised by the instruction at
+  // offset, or -1 if the error leaves the frame.
+  int find_handler(JumpLoc offset) const;
+
+  // Runs of instructions by source line, sorted by start.  Only read when
+  // an error leaves the frame or enters an except clause.
+  std::vector<LineEntry> line_table;
+
+  // The line table entry of the instruction at offset.
+  const LineEntry& find_line(JumpLoc offset) const;
+
+  f_inline int opcode(const char* pc) const {
+    return (uint8_t) opcodes[pc - instructions.data()];
+  }
+
+  // Replace the opcode of each instruction with labels[opcode].
+  void map_labels(const void* const* labels);
+
+  // The handler table passed to map_labels, used to rewrite instructions
+  // after they have been mapped.
+  const void* const* labels;
+
+  // Number of times the instruction at each offset has been deoptimized.
+  // Parallel to instructions, like the opcode side-table.
+  std::string deopts;
+
+  // Rewrite the instruction at pc from its generic form to a form
+  // specialized for the operand types just seen.  Instructions that have
+  // been fused into a superinstruction, or that keep failing their guards,
+  // are left alone.
+  f_inline void quicken(const char* pc, int generic, int specialized) {
+#if USE_QUICKENING
+    size_t offset = pc - instructions.data();
+    if ((uint8_t) opcodes[offset] == generic && (uint8_t) deopts[offset] < kMaxDeopts) {
+      set_opcode(offset, specialized);
+    }
+#endif
+  }
+
+  // Called by a specialized instruction whose guard failed: rewrite it
+  // back to its generic form.
+  void deoptimize(const char* pc, int generic);
+
+private:
+  static const uint8_t kMaxDeopts = 4;
+
+  void set_opcode(size_t offset, int opcode);
 };
 
 #if PACK_INSTRUCTIONS
@@ -127,18 +337,18 @@ struct RegisterCode {
 #endif
 
 struct OpHeader {
-  uint8_t code;
+  OpCode code;
   uint16_t arg;
 };
 
 template<int kNumRegisters>
 struct BranchOp {
-  uint8_t code;
+  OpCode code;
   uint16_t arg;
   JumpLoc label;
   RegisterOffset reg[kNumRegisters];
 
-  std::string str(Register* registers = NULL) const;
+  std::string str(int opcode, Register* registers = NULL) const;
 
   inline size_t size() const {
     return sizeof(*this);
@@ -147,18 +357,49 @@ struct BranchOp {
 
 template<int kNumRegisters>
 struct RegOp {
-  uint8_t code;
+  OpCode code;
   uint16_t arg;
 
 #if GETATTR_HINTS
   // The hint field is used by certain operations to cache information
-  // at runtime.  It is default initialized to kInvalidHint;
+  // at runtime; for LOAD_ATTR, STORE_ATTR and LOAD_GLOBAL it is the index
+  // of the instruction's inline cache.  It is default initialized to kInvalidHint.
   HintOffset hint_pos;
 #endif
 
   RegisterOffset reg[kNumRegisters];
 
-  std::string str(Register* registers = NULL) const;
+  std::string str(int opcode, Register* registers = NULL) const;
+
+  inline size_t size() const {
+    return sizeof(*this);
+  }
+};
+
+// Variants of RegOp<3> and BranchOp<2> whose second operand is a small
+// integer constant stored in the instruction.  reg[1] still names the
+// constant's register, for the generic path.
+struct ImmRegOp {
+  OpCode code;
+  uint16_t arg;
+  int32_t imm;
+  RegisterOffset reg[3];
+
+  std::string str(int opcode, Register* registers = NULL) const;
+
+  inline size_t size() const {
+    return sizeof(*this);
+  }
+};
+
+struct ImmBranchOp {
+  OpCode code;
+  uint16_t arg;
+  JumpLoc label;
+  int32_t imm;
+  RegisterOffset reg[2];
+
+  std::string str(int opcode, Register* registers = NULL) const;
 
   inline size_t size() const {
     return sizeof(*this);
@@ -168,15 +409,18 @@ struct RegOp {
 // A variable size instruction can contain any number of registers off the end
 // of the structure.
 struct VarRegOp {
-  uint8_t code;
+  OpCode code;
   // arg has to be larger than uint8_t because
   // Python uses a weird encoding for keyword arg
   // function calls
   uint16_t arg;
   uint8_t num_registers;
+  // For CALL_FUNCTION and CALL_METHOD, the index of the call's
+  // CallCache; kInvalidHint otherwise.
+  HintOffset hint_pos;
   RegisterOffset reg[0];
 
-  std::string str(Register* registers = NULL) const;
+  std::string str(int opcode, Register* registers = NULL) const;
 
   inline size_t size() const {
     return sizeof(VarRegOp) + num_registers * sizeof(RegisterOffset);
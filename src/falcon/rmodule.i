@@ -11,7 +11,10 @@
   try {
     $function
   } catch (RException& e) {
-    PyErr_SetObject(e.exception, e.value);
+    // A bare RException propagates the Python error already set.
+    if (e.exception != NULL) {
+      PyErr_SetObject(e.exception, e.value);
+    }
     return NULL;
   }
 }
@@ -0,0 +1,97 @@
+// Generated by tools/gen_superinstructions.py -- do not edit.
+//
+// Each superinstruction fuses a common opcode sequence into a single
+// dispatch.  Only the opcode of the first instruction is rewritten; the
+// remaining instructions keep their encoding and are run in line by the
+// fused handler.
+//
+// Profiled workloads: count_threshold.py, crypto.py, decision_tree.py, fannkuch.py, fasta.py, matmult_float.py, mergesort.py, meteor.py, midi_msg.py, pystone.py, quicksort.py, wordcount.py
+
+#ifndef FALCON_SUPERINSTRUCTIONS_H
+#define FALCON_SUPERINSTRUCTIONS_H
+
+#if FIRST_SUPERINSTRUCTION != 185
+#error "superinstructions.h is out of date; rerun tools/gen_superinstructions.py"
+#endif
+
+#define SUPER_BINARY_ADD_IMM__STORE_SUBSCR_DICT 185
+#define SUPER_BINARY_MULTIPLY__INPLACE_ADD 186
+#define SUPER_BINARY_SUBSCR__BINARY_MULTIPLY 187
+#define SUPER_BINARY_SUBSCR__BINARY_SUBSCR 188
+#define SUPER_CALL_FUNCTION__COMPARE_AND_BRANCH_IF_FALSE 189
+#define SUPER_DICT_GET_DEFAULT__BINARY_ADD_IMM 190
+#define SUPER_INPLACE_ADD__JUMP_ABSOLUTE 191
+#define SUPER_LIST_APPEND__JUMP_ABSOLUTE 192
+#define SUPER_LOAD_ATTR__COMPARE_AND_BRANCH_IF_FALSE 193
+#define SUPER_LOAD_GLOBAL__CALL_FUNCTION 194
+#define SUPER_LOAD_METHOD__CALL_METHOD 195
+#define SUPER_STORE_FAST__COMPARE_AND_BRANCH_IF_FALSE 196
+#define SUPER_STORE_NAME__LIST_APPEND 197
+#define SUPER_STORE_SUBSCR_DICT__JUMP_ABSOLUTE 198
+#define SUPER_BINARY_ADD_IMM__STORE_SUBSCR_DICT__JUMP_ABSOLUTE 199
+#define SUPER_BINARY_MULTIPLY__INPLACE_ADD__JUMP_ABSOLUTE 200
+#define SUPER_BINARY_SUBSCR__BINARY_MULTIPLY__INPLACE_ADD 201
+#define SUPER_BINARY_SUBSCR__BINARY_SUBSCR__BINARY_MULTIPLY 202
+#define SUPER_BINARY_SUBSCR__LOAD_ATTR__COMPARE_AND_BRANCH_IF_FALSE 203
+#define SUPER_CALL_FUNCTION__LIST_APPEND__JUMP_ABSOLUTE 204
+#define SUPER_DICT_GET_DEFAULT__BINARY_ADD_IMM__STORE_SUBSCR_DICT 205
+#define SUPER_LOAD_GLOBAL__CALL_FUNCTION__COMPARE_AND_BRANCH_IF_FALSE 206
+#define SUPER_LOAD_GLOBAL__CALL_FUNCTION__LIST_APPEND 207
+#define SUPER_STORE_NAME__LIST_APPEND__JUMP_ABSOLUTE 208
+#define NUM_SUPERINSTRUCTIONS 24
+
+// X2(super, op1, op2) and X3(super, op1, op2, op3), in opcode order.
+#define SUPERINSTRUCTIONS(X2, X3) \
+  X2(SUPER_BINARY_ADD_IMM__STORE_SUBSCR_DICT, BINARY_ADD_IMM, STORE_SUBSCR_DICT) \
+  X2(SUPER_BINARY_MULTIPLY__INPLACE_ADD, BINARY_MULTIPLY, INPLACE_ADD) \
+  X2(SUPER_BINARY_SUBSCR__BINARY_MULTIPLY, BINARY_SUBSCR, BINARY_MULTIPLY) \
+  X2(SUPER_BINARY_SUBSCR__BINARY_SUBSCR, BINARY_SUBSCR, BINARY_SUBSCR) \
+  X2(SUPER_CALL_FUNCTION__COMPARE_AND_BRANCH_IF_FALSE, CALL_FUNCTION, COMPARE_AND_BRANCH_IF_FALSE) \
+  X2(SUPER_DICT_GET_DEFAULT__BINARY_ADD_IMM, DICT_GET_DEFAULT, BINARY_ADD_IMM) \
+  X2(SUPER_INPLACE_ADD__JUMP_ABSOLUTE, INPLACE_ADD, JUMP_ABSOLUTE) \
+  X2(SUPER_LIST_APPEND__JUMP_ABSOLUTE, LIST_APPEND, JUMP_ABSOLUTE) \
+  X2(SUPER_LOAD_ATTR__COMPARE_AND_BRANCH_IF_FALSE, LOAD_ATTR, COMPARE_AND_BRANCH_IF_FALSE) \
+  X2(SUPER_LOAD_GLOBAL__CALL_FUNCTION, LOAD_GLOBAL, CALL_FUNCTION) \
+  X2(SUPER_LOAD_METHOD__CALL_METHOD, LOAD_METHOD, CALL_METHOD) \
+  X2(SUPER_STORE_FAST__COMPARE_AND_BRANCH_IF_FALSE, STORE_FAST, COMPARE_AND_BRANCH_IF_FALSE) \
+  X2(SUPER_STORE_NAME__LIST_APPEND, STORE_NAME, LIST_APPEND) \
+  X2(SUPER_STORE_SUBSCR_DICT__JUMP_ABSOLUTE, STORE_SUBSCR_DICT, JUMP_ABSOLUTE) \
+  X3(SUPER_BINARY_ADD_IMM__STORE_SUBSCR_DICT__JUMP_ABSOLUTE, BINARY_ADD_IMM, STORE_SUBSCR_DICT, JUMP_ABSOLUTE) \
+  X3(SUPER_BINARY_MULTIPLY__INPLACE_ADD__JUMP_ABSOLUTE, BINARY_MULTIPLY, INPLACE_ADD, JUMP_ABSOLUTE) \
+  X3(SUPER_BINARY_SUBSCR__BINARY_MULTIPLY__INPLACE_ADD, BINARY_SUBSCR, BINARY_MULTIPLY, INPLACE_ADD) \
+  X3(SUPER_BINARY_SUBSCR__BINARY_SUBSCR__BINARY_MULTIPLY, BINARY_SUBSCR, BINARY_SUBSCR, BINARY_MULTIPLY) \
+  X3(SUPER_BINARY_SUBSCR__LOAD_ATTR__COMPARE_AND_BRANCH_IF_FALSE, BINARY_SUBSCR, LOAD_ATTR, COMPARE_AND_BRANCH_IF_FALSE) \
+  X3(SUPER_CALL_FUNCTION__LIST_APPEND__JUMP_ABSOLUTE, CALL_FUNCTION, LIST_APPEND, JUMP_ABSOLUTE) \
+  X3(SUPER_DICT_GET_DEFAULT__BINARY_ADD_IMM__STORE_SUBSCR_DICT, DICT_GET_DEFAULT, BINARY_ADD_IMM, STORE_SUBSCR_DICT) \
+  X3(SUPER_LOAD_GLOBAL__CALL_FUNCTION__COMPARE_AND_BRANCH_IF_FALSE, LOAD_GLOBAL, CALL_FUNCTION, COMPARE_AND_BRANCH_IF_FALSE) \
+  X3(SUPER_LOAD_GLOBAL__CALL_FUNCTION__LIST_APPEND, LOAD_GLOBAL, CALL_FUNCTION, LIST_APPEND) \
+  X3(SUPER_STORE_NAME__LIST_APPEND__JUMP_ABSOLUTE, STORE_NAME, LIST_APPEND, JUMP_ABSOLUTE)
+
+// The same list, naming the evaluator handler for each operation.
+#define SUPERINSTRUCTION_HANDLERS(X2, X3) \
+  X2(SUPER_BINARY_ADD_IMM__STORE_SUBSCR_DICT, BinaryOpImm<CONCAT(BINARY_ADD_IMM, PyNumber_Add, IntegerOps::add, IntegerOps::add_overflowed)>, StoreSubscrDict) \
+  X2(SUPER_BINARY_MULTIPLY__INPLACE_ADD, BinaryOpWithSpecialization<CONCAT(BINARY_MULTIPLY, PyNumber_Multiply, IntegerOps::mul, IntegerOps::mul_overflowed)>, BinaryOpWithSpecialization<CONCAT(INPLACE_ADD, PyNumber_InPlaceAdd, IntegerOps::add, IntegerOps::add_overflowed)>) \
+  X2(SUPER_BINARY_SUBSCR__BINARY_MULTIPLY, BinarySubscr, BinaryOpWithSpecialization<CONCAT(BINARY_MULTIPLY, PyNumber_Multiply, IntegerOps::mul, IntegerOps::mul_overflowed)>) \
+  X2(SUPER_BINARY_SUBSCR__BINARY_SUBSCR, BinarySubscr, BinarySubscr) \
+  X2(SUPER_CALL_FUNCTION__COMPARE_AND_BRANCH_IF_FALSE, CallFunctionSimple, CompareAndBranch<false>) \
+  X2(SUPER_DICT_GET_DEFAULT__BINARY_ADD_IMM, DictGetDefault, BinaryOpImm<CONCAT(BINARY_ADD_IMM, PyNumber_Add, IntegerOps::add, IntegerOps::add_overflowed)>) \
+  X2(SUPER_INPLACE_ADD__JUMP_ABSOLUTE, BinaryOpWithSpecialization<CONCAT(INPLACE_ADD, PyNumber_InPlaceAdd, IntegerOps::add, IntegerOps::add_overflowed)>, JumpAbsolute) \
+  X2(SUPER_LIST_APPEND__JUMP_ABSOLUTE, ListAppend, JumpAbsolute) \
+  X2(SUPER_LOAD_ATTR__COMPARE_AND_BRANCH_IF_FALSE, LoadAttr, CompareAndBranch<false>) \
+  X2(SUPER_LOAD_GLOBAL__CALL_FUNCTION, LoadGlobal, CallFunctionSimple) \
+  X2(SUPER_LOAD_METHOD__CALL_METHOD, LoadMethod, CallMethod) \
+  X2(SUPER_STORE_FAST__COMPARE_AND_BRANCH_IF_FALSE, StoreFast, CompareAndBranch<false>) \
+  X2(SUPER_STORE_NAME__LIST_APPEND, StoreName, ListAppend) \
+  X2(SUPER_STORE_SUBSCR_DICT__JUMP_ABSOLUTE, StoreSubscrDict, JumpAbsolute) \
+  X3(SUPER_BINARY_ADD_IMM__STORE_SUBSCR_DICT__JUMP_ABSOLUTE, BinaryOpImm<CONCAT(BINARY_ADD_IMM, PyNumber_Add, IntegerOps::add, IntegerOps::add_overflowed)>, StoreSubscrDict, JumpAbsolute) \
+  X3(SUPER_BINARY_MULTIPLY__INPLACE_ADD__JUMP_ABSOLUTE, BinaryOpWithSpecialization<CONCAT(BINARY_MULTIPLY, PyNumber_Multiply, IntegerOps::mul, IntegerOps::mul_overflowed)>, BinaryOpWithSpecialization<CONCAT(INPLACE_ADD, PyNumber_InPlaceAdd, IntegerOps::add, IntegerOps::add_overflowed)>, JumpAbsolute) \
+  X3(SUPER_BINARY_SUBSCR__BINARY_MULTIPLY__INPLACE_ADD, BinarySubscr, BinaryOpWithSpecialization<CONCAT(BINARY_MULTIPLY, PyNumber_Multiply, IntegerOps::mul, IntegerOps::mul_overflowed)>, BinaryOpWithSpecialization<CONCAT(INPLACE_ADD, PyNumber_InPlaceAdd, IntegerOps::add, IntegerOps::add_overflowed)>) \
+  X3(SUPER_BINARY_SUBSCR__BINARY_SUBSCR__BINARY_MULTIPLY, BinarySubscr, BinarySubscr, BinaryOpWithSpecialization<CONCAT(BINARY_MULTIPLY, PyNumber_Multiply, IntegerOps::mul, IntegerOps::mul_overflowed)>) \
+  X3(SUPER_BINARY_SUBSCR__LOAD_ATTR__COMPARE_AND_BRANCH_IF_FALSE, BinarySubscr, LoadAttr, CompareAndBranch<false>) \
+  X3(SUPER_CALL_FUNCTION__LIST_APPEND__JUMP_ABSOLUTE, CallFunctionSimple, ListAppend, JumpAbsolute) \
+  X3(SUPER_DICT_GET_DEFAULT__BINARY_ADD_IMM__STORE_SUBSCR_DICT, DictGetDefault, BinaryOpImm<CONCAT(BINARY_ADD_IMM, PyNumber_Add, IntegerOps::add, IntegerOps::add_overflowed)>, StoreSubscrDict) \
+  X3(SUPER_LOAD_GLOBAL__CALL_FUNCTION__COMPARE_AND_BRANCH_IF_FALSE, LoadGlobal, CallFunctionSimple, CompareAndBranch<false>) \
+  X3(SUPER_LOAD_GLOBAL__CALL_FUNCTION__LIST_APPEND, LoadGlobal, CallFunctionSimple, ListAppend) \
+  X3(SUPER_STORE_NAME__LIST_APPEND__JUMP_ABSOLUTE, StoreName, ListAppend, JumpAbsolute)
+
+#endif /* FALCON_SUPERINSTRUCTIONS_H */
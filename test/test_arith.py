@@ -1,4 +1,6 @@
 from testing_helpers import wrap 
+import falcon
+import sys
 
 @wrap 
 def add(a, b):
@@ -31,4 +33,73 @@ def inplace_add(x):
 def test_inplace_add():
   a = [0]
   inplace_add(a) 
-  
\ No newline at end of file
+  
+@wrap
+def const_ops(a):
+  b = a + 3
+  b -= 2
+  c = a - 9
+  d = a > 10
+  if a < 0:
+    d = not d
+  return b, c, d
+
+@wrap
+def const_bit_ops(a):
+  return (a << 3) + (a >> 1) + (a & 7) + (a | 8) + (a ^ 5)
+
+def test_const_ops():
+  for v in (0, 37, -37, sys.maxint, -sys.maxint - 1, sys.maxint >> 2, True, 10 ** 20):
+    const_ops(v)
+    const_bit_ops(v)
+  const_ops(2.5)
+
+@wrap
+def int_edges(a, b):
+  r = [a * b, a + b, a - b, a << 3, a >> 2]
+  if b:
+    r.append(a / b)
+    r.append(a % b)
+  return r
+
+def test_int_edges():
+  big = 2 ** 62
+  for a in (0, 7, -7, big - 1, -big, big, sys.maxint, -sys.maxint - 1):
+    for b in (0, 1, -1, 3, -3, big - 1, -big):
+      int_edges(a, b)
+
+@wrap
+def shifts(a, n):
+  return a << n, a >> n
+
+def test_shifts():
+  for n in (0, 1, 62, 63, 64, 100):
+    shifts(1, n)
+    shifts(-5, n)
+
+@wrap
+def store_index(l, i, v):
+  l[i] = v
+  l[-1] = v
+  return l
+
+def test_store_index():
+  store_index([1, 2, 3], 0, 'x')
+  store_index([1, 2, 3], -2, 2 ** 62)
+  store_index({}, 5, None)
+
+@wrap
+def float_ops(a, b):
+  c = a * b + a - b
+  c += 0.5 * a
+  c -= b * 2
+  return c, a < b, a <= b, a == b, a != b, a > b, a >= b, [a * b, a + b]
+
+def test_float_ops():
+  for a in (0.0, -0.0, 1.5, -2.25, 1e308, 3, 2 ** 62):
+    for b in (0.0, -1.0, 2.5, 1e-308, 7, -(2 ** 62)):
+      float_ops(a, b)
+  float_ops(float('inf'), 1.0)
+  # NaN never compares equal, so check the results by hand.
+  r = falcon.wrap(float_ops.python_fn)(float('nan'), 1.0)
+  assert r[0] != r[0] and r[1:7] == (False, False, False, True, False, False)
@@ -29,3 +29,88 @@ def store_load_attr(a,b):
 def test_store_load_attr():
   store_load_attr(0, 10)
 
+
+class Slotted(object):
+  __slots__ = ['a']
+  def __init__(self):
+    self.a = 1
+
+class WithProperty(object):
+  @property
+  def a(self):
+    return 2
+
+class Shadowed(object):
+  a = 3
+
+@wrap
+def load_a(x):
+  return x.a
+
+def test_load_attr_polymorphic():
+  objs = [Foo(), Slotted(), WithProperty(), Shadowed(), Foo(), Slotted()]
+  for i in range(3):
+    for o in objs:
+      load_a(o)
+
+def test_load_attr_type_modified():
+  o = Shadowed()
+  load_a(o)
+  Shadowed.a = 4
+  load_a(o)
+  o.a = 5
+  load_a(o)
+  del o.a
+  load_a(o)
+  Shadowed.a = property(lambda self: 6)
+  load_a(o)
+  Shadowed.a = 3
+
+def test_load_attr_error():
+  load_a(Foo())
+  try:
+    load_a.falcon_fn(Slotted.__new__(Slotted))
+    assert False, 'Expected AttributeError'
+  except AttributeError:
+    pass
+
+class WithSetter(object):
+  def __init__(self):
+    self._a = 0
+
+  def get_a(self):
+    return self._a
+
+  def set_a(self, v):
+    self._a = v * 2
+
+  a = property(get_a, set_a)
+
+@wrap
+def store_a(x, v):
+  x.a = v
+  x.a = x.a + v
+  return x.a
+
+def test_store_attr_polymorphic():
+  objs = [Foo(), Slotted(), WithSetter(), Shadowed(), Foo(), Slotted()]
+  for i in range(3):
+    for o in objs:
+      store_a(o, i)
+
+def test_store_attr_type_modified():
+  o = Shadowed()
+  store_a(o, 1)
+  Shadowed.a = property(lambda self: 6, lambda self, v: None)
+  store_a(o, 2)
+  del Shadowed.a
+  store_a(o, 3)
+  Shadowed.a = 3
+
+def test_store_attr_error():
+  store_a(Foo(), 1)
+  try:
+    store_a.falcon_fn(WithProperty(), 1)
+    assert False, 'Expected AttributeError'
+  except AttributeError:
+    pass
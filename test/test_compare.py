@@ -25,4 +25,31 @@ def test_compare_tuples():
 def test_compare_strings():
   compare("hello", "hello")
   compare("hello", "hello2")
-  compare("hello", "hell")
\ No newline at end of file
+  compare("hello", "hell")
+
+class Fuzzy(object):
+  def __init__(self, v):
+    self.v = v
+  def __lt__(self, other):
+    # Not a bool: the branch must test the truth value.
+    return [1] if self.v < other.v else []
+
+@wrap
+def count_below(a, b, n):
+  count = 0
+  i = 0
+  while i < n:
+    if a < b:
+      count += 1
+    if not (b < a):
+      count += 10
+    i += 1
+  return count
+
+def test_compare_and_branch():
+  count_below(1, 2, 3)
+  count_below(2.5, 1.5, 3)
+  count_below(1, 1.5, 3)
+  count_below("a", "b", 3)
+  count_below(Fuzzy(1), Fuzzy(2), 3)
+  count_below(Fuzzy(2), Fuzzy(1), 3)
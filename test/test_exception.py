@@ -1,4 +1,7 @@
 from testing_helpers import wrap
+import falcon
+import sys
+import traceback
 import unittest
 
 def throws(x):
@@ -23,6 +26,171 @@ def test_simple_throw():
     raise a
   except:
     return 1
+
+@wrap
+def lookup(d, k):
+  try:
+    return d[k]
+  except KeyError:
+    return -1
+
+def test_key_error():
+  lookup({1: 2}, 1)
+  lookup({1: 2}, 3)
+
+@wrap
+def catch_as(x):
+  try:
+    a(x)
+  except IndexError as e:
+    return str(e)
+  except TypeError as e:
+    return 'type: %s' % e
+  return 'none'
+
+def test_catch_as():
+  catch_as([])
+  catch_as(None)
+  catch_as({})
+
+@wrap
+def nested(x):
+  n = 0
+  try:
+    try:
+      n += 1
+      a(x)
+    except KeyError:
+      n += 10
+    n += 100
+  except IndexError:
+    n += 1000
+  return n
+
+def test_nested():
+  nested({})
+  nested([])
+  try:
+    nested.falcon_fn(None)
+    assert False, 'Expected TypeError'
+  except TypeError:
+    pass
+
+@wrap
+def reraise(x):
+  try:
+    a(x)
+  except IndexError:
+    raise
+  return 0
+
+@wrap
+def catch_reraise(x):
+  try:
+    return reraise.falcon_fn(x)
+  except IndexError:
+    return 1
+
+def test_reraise():
+  catch_reraise([])
+  catch_reraise({})
+
+@wrap
+def loop(xs):
+  total = 0
+  for x in xs:
+    try:
+      if x == 'stop':
+        break
+      if x is None:
+        continue
+      total += x
+    except TypeError:
+      total += 100
+      continue
+  return total
+
+def test_loop():
+  loop([1, None, 'a', 2, 'stop', 3])
+  loop(range(10))
+
+@wrap
+def exc_info(x):
+  try:
+    a(x)
+  except IndexError:
+    return sys.exc_info()[0]
+  return None
+
+def test_exc_info():
+  before = sys.exc_info()
+  exc_info([])
+  assert sys.exc_info() == before
+ 
+def fail(x):
+  y = x + 1
+  raise ValueError(y)
+
+def call_fail(x):
+  z = x * 2
+  return fail(z)
+
+def tb_lines(tb):
+  return [(name, line) for _, line, name, _ in traceback.extract_tb(tb)]
+
+@wrap
+def traceback_lines(x):
+  try:
+    call_fail(x)
+  except ValueError:
+    return tb_lines(sys.exc_info()[2])
+
+def test_traceback_lines():
+  traceback_lines(1)
+  # Leaving Falcon for the interpreter.
+  lines = []
+  for f in (call_fail, falcon.wrap(call_fail)):
+    try:
+      f(1)
+    except ValueError:
+      lines.append(tb_lines(sys.exc_info()[2])[-2:])
+  assert lines[0] == lines[1], lines
+
+@wrap
+def traceback_builtin(x):
+  # Errors raised by C code still give the catching frame an entry.
+  try:
+    int(x)
+  except ValueError:
+    return tb_lines(sys.exc_info()[2])
+
+def test_traceback_builtin():
+  traceback_builtin('x')
+
+def reraise_lines(f, x):
+  try:
+    f(x)
+  except ValueError:
+    lines = tb_lines(sys.exc_info()[2])
+    return lines[[name for name, _ in lines].index(f.__name__):]
+
+def unmatched(x):
+  try:
+    call_fail(x)
+  except KeyError:
+    pass
+
+def reraise_fail(x):
+  try:
+    int(x)
+  except ValueError:
+    raise
+
+def test_traceback_reraise():
+  # Re-raising doesn't add the frame again.
+  for f, x in ((unmatched, 1), (reraise_fail, 'x')):
+    lines = [reraise_lines(f, x), reraise_lines(falcon.wrap(f), x)]
+    assert lines[0] == lines[1], lines
  
 if __name__ == '__main__':
   #test_simple_throw()
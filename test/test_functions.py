@@ -1,3 +1,4 @@
+import falcon
 from testing_helpers import wrap 
 
 @wrap 
@@ -32,6 +33,186 @@ def nested_closure_repeat():
 def test_nested_closure_repeat():
   nested_closure_repeat()
   
+def fib(n):
+  if n < 2:
+    return n
+  return fib(n - 1) + fib(n - 2)
+
+def scaled(x, k=3):
+  return x * k
+
+def make_adder(n):
+  def add(x):
+    return x + n
+  return add
+
+class Counter(object):
+  def __init__(self):
+    self.n = 0
+
+  def bump(self, k=1):
+    self.n += k
+    return self.n
+
+  def captured(self, v):
+    def get():
+      return v + self.n
+    return get()
+
+@wrap
+def direct_calls(n):
+  a = make_adder(1)
+  b = make_adder(10)
+  c = Counter()
+  c.bump()
+  return fib(n), scaled(n), scaled(n, 2), a(n), b(n), c.bump(5), c.captured(n)
+
+def test_direct_calls():
+  # Calls from Falcon code only go straight to callees that are compiled.
+  falcon.wrap(fib)(1)
+  falcon.wrap(scaled)(1)
+  falcon.wrap(make_adder(0))(1)
+  falcon.wrap(Counter.__dict__['bump'])(Counter())
+  falcon.wrap(Counter.__dict__['captured'])(Counter(), 1)
+  direct_calls(15)
+  direct_calls(2.5)
+
+@wrap
+def captured_args(a, b, c=5):
+  d = a * 2
+  def get():
+    return c, a, d
+  return get()
+
+def test_captured_args():
+  # Cells for arguments start out holding the argument, defaults included.
+  captured_args(1, 2)
+  captured_args(1, 2, 3)
+  captured_args('x', None, [1])
+
+def keywords(a, b=2, c=3):
+  return a, b, c
+
+def packed(a, *args, **kw):
+  return a, args, sorted(kw.items())
+
+def many(a=0, b=0, c=0, d=0, e=0, f=0, g=0, h=0, i=0):
+  return a + b + c + d + e + f + g + h + i
+
+class Scaler(object):
+  def scale(self, x, k=1):
+    return x * k
+
+@wrap
+def keyword_calls(n):
+  s = Scaler()
+  args = (n, 1)
+  kw = {'c': n}
+  out = []
+  for i in range(3):
+    out.append(keywords(n, c=i))
+    out.append(keywords(c=i, a=n))
+    out.append(keywords(*args))
+    out.append(keywords(n, **kw))
+    out.append(keywords(*[n], **kw))
+    out.append(packed(n, 1, 2, x=i))
+    out.append(packed(*args, **{'y': i}))
+    out.append(many(a=1, b=2, c=3, d=4, e=5, f=6, g=7, h=8, i=i))
+    out.append(s.scale(n, k=i))
+    out.append(Scaler.scale(s, x=n))
+    try:
+      keywords(n, d=i)
+    except TypeError, e:
+      out.append(str(e))
+    try:
+      keywords(n, a=i)
+    except TypeError, e:
+      out.append(str(e))
+    try:
+      keywords(b=i)
+    except TypeError, e:
+      out.append(str(e))
+  return out
+
+def test_keyword_calls():
+  for f in (keywords, packed, many, Scaler.__dict__['scale']):
+    falcon.wrap(f)(1, 1)
+  keyword_calls(4)
+  keyword_calls(2.5)
+  keyword_calls(n='x')
+
+class Point(object):
+  def __init__(self, x, y=0):
+    self.x = x
+    self.y = y
+
+  def __eq__(self, other):
+    return (self.x, self.y) == (other.x, other.y)
+
+class Point3(Point):
+  def __init__(self, x, y, z):
+    Point.__init__(self, x, y)
+    self.z = z
+
+class BadInit(object):
+  def __init__(self):
+    return 1
+
+class Interned(object):
+  def __new__(cls, x):
+    return 'new'
+
+  def __init__(self, x):
+    pass
+
+class NoInit(object):
+  pass
+
+@wrap
+def instantiate(n, m):
+  out = [Point(n), Point(n, 2), Point(y=n, x=1), Point3(n, n, n).z, m.Point(n),
+         Interned(n), type(NoInit()) is NoInit]
+  try:
+    BadInit()
+  except TypeError, e:
+    out.append(str(e))
+  try:
+    Point()
+  except TypeError, e:
+    out.append(str(e))
+  return out
+
+def test_instantiate():
+  import types
+  m = types.ModuleType('m')
+  m.Point = Point
+  for cls, args in ((Point, (1,)), (Point3, (1, 2, 3)), (BadInit, ()), (Interned, (1,))):
+    falcon.wrap(cls.__dict__['__init__'])(object.__new__(cls), *args)
+  for n in (1, 'x'):
+    instantiate(n, m)
+    instantiate(n, m)
+  # Calls must notice the class changing.
+  def init(self, x, y=5):
+    self.x = x
+    self.y = -y
+  old = Point.__init__
+  Point.__init__ = init
+  try:
+    instantiate(1, m)
+  finally:
+    Point.__init__ = old
+
+def recurse(n):
+  return recurse(n + 1)
+
+def test_direct_recursion_limit():
+  f = falcon.wrap(recurse)
+  try:
+    f(0)
+  except RuntimeError:
+    pass
+  else:
+    assert False, "expected RuntimeError"
 
 if __name__ == '__main__':
   import nose 
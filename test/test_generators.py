@@ -1,9 +1,258 @@
-from testing_helpers import wrap 
+from testing_helpers import wrap
+import falcon
+import sys
+import traceback
+import types
+import weakref
 
 
-@wrap 
+@wrap
 def count_threshold_generator(limit, threshold):
   return sum(item > threshold for item in xrange(limit))
 
-#def test_count_threshold_generator():
-#  count_threshold_generator(1000,490)
\ No newline at end of file
+def test_count_threshold_generator():
+  count_threshold_generator(1000,490)
+
+def squares(n):
+  for i in range(n):
+    yield i * i
+
+def pairs(items):
+  prev = None
+  for item in items:
+    if prev is not None:
+      yield prev, item
+    prev = item
+
+@wrap
+def pipeline(n, k):
+  evens = (x for x in squares(n) if x % 2 == 0)
+  return list(pairs(x + k for x in evens))
+
+def test_pipeline():
+  pipeline(10, 3)
+  pipeline(1, 3)
+
+def failing(n):
+  for i in range(n):
+    yield 10 / (n - i - 1)
+
+@wrap
+def collect_failing(n):
+  try:
+    return list(failing(n))
+  except ZeroDivisionError:
+    return 'caught'
+
+def test_errors():
+  collect_failing(3)
+
+def echo(log):
+  try:
+    while True:
+      try:
+        value = yield len(log)
+        log.append(value)
+      except KeyError as e:
+        log.append('caught %s' % e)
+  except GeneratorExit:
+    log.append('closed')
+    raise
+
+def falcon_echo(log):
+  g = falcon.wrap(echo)(log)
+  assert not isinstance(g, types.GeneratorType), 'Expected a Falcon generator'
+  return g
+
+def drive_echo(make):
+  log = []
+  g = make(log)
+  out = [g.next(), g.send('a'), g.throw(KeyError('k')), g.send('b')]
+  g.close()
+  try:
+    g.next()
+    out.append('not stopped')
+  except StopIteration:
+    out.append('stopped')
+  return out, log
+
+def test_send_throw_close():
+  assert drive_echo(echo) == drive_echo(falcon_echo)
+
+def test_dropped():
+  # Dropping a generator suspended in a try block closes it.
+  for make in (echo, falcon_echo):
+    log = []
+    g = make(log)
+    g.next()
+    del g
+    assert log == ['closed'], log
+
+def fail(x):
+  raise ValueError(x)
+
+def hold_echo(x):
+  g = echo([])
+  g.next()
+  fail(x)
+
+@wrap
+def dropped_while_raising(x):
+  try:
+    hold_echo(x)
+  except ValueError:
+    return [name for _, _, name, _ in traceback.extract_tb(sys.exc_info()[2])]
+
+def test_dropped_while_raising():
+  # Closing the generator doesn't lose the frames the error has left.
+  try:
+    falcon.wrap(hold_echo)(1)
+  except ValueError:
+    pass
+  dropped_while_raising(1)
+
+# Generator expressions passed straight to a builtin we know run as a loop
+# in the caller's frame.
+
+@wrap
+def consume(xs, k):
+  return (sum(x * k for x in xs if x),
+          any(x > k for x in xs), all(x > k for x in xs),
+          list(x + 1 for x in xs), tuple(x for x in xs if x % 2),
+          min(x - k for x in xs), max(abs(x - k) for x in xs),
+          ','.join(str(x) for x in xs),
+          sum(x * y for x in xs for y in xs if y > x),
+          list(sum(y for y in xs if y < x) for x in xs))
+
+def test_fused():
+  consume([3, 1, 4, 1, 5], 2)
+  consume([0.5, 2, 7L], 1)
+  consume([4], 4)
+
+@wrap
+def consume_empty(xs):
+  return sum(x for x in xs), any(x for x in xs), all(x for x in xs), list(x for x in xs), ''.join(x for x in xs)
+
+def test_fused_empty():
+  consume_empty([])
+
+@wrap
+def stop_early(xs):
+  # StopIteration from the body ends the generator, and so the loop.
+  it = iter(xs)
+  return sum(next(it) for x in range(10)), list(it)
+
+@wrap
+def fused_errors(xs):
+  out = []
+  try:
+    out.append(sum(1 / x for x in xs))
+  except ZeroDivisionError:
+    out.append('body')
+  try:
+    out.append(sum(str(x) for x in xs))
+  except TypeError:
+    out.append('consumer')
+  return out
+
+def test_fused_errors():
+  stop_early([1, 2, 3])
+  stop_early(range(20))
+  fused_errors([1, 0])
+  fused_errors([])
+
+@wrap
+def call_sum(xs):
+  return sum(x for x in xs)
+
+class Logged(object):
+  def __init__(self, x, log):
+    self.x = x
+    self.log = log
+
+  def __lt__(self, other):
+    self.log.append(('lt', self.x, other.x))
+    return self.x < other.x
+
+  def __gt__(self, other):
+    self.log.append(('gt', self.x, other.x))
+    return self.x > other.x
+
+@wrap
+def min_max_order(xs):
+  # Items are compared as they come, between running the body for each.
+  log = []
+  lo = min(Logged(x, log) for x in xs if not log.append(x)).x
+  hi = max(Logged(x, log) for x in xs if not log.append(x)).x
+  return lo, hi, log
+
+def test_min_max_order():
+  min_max_order([3, 1, 2])
+
+STOP = StopIteration()
+
+def stop(x):
+  raise STOP
+
+def raise_stop():
+  raise STOP
+
+@wrap
+def stop_again(n):
+  # The frames the first STOP left don't join the traceback of the second.
+  total = sum(stop(x) if x == n else x for x in range(10))
+  try:
+    raise_stop()
+  except StopIteration:
+    return total, [name for _, _, name, _ in traceback.extract_tb(sys.exc_info()[2])]
+
+def test_stop_again():
+  for f in (stop, raise_stop):
+    try:
+      falcon.wrap(f)(0)
+    except (StopIteration, TypeError):
+      pass
+  stop_again(3)
+
+def test_fused_rebound():
+  global sum
+  call_sum([1, 2, 3])
+  sum = lambda items: list(items)
+  try:
+    call_sum([1, 2, 3])
+  except:
+    del sum
+    raise
+  del sum
+  call_sum([1, 2, 3])
+
+def test_bad_throw():
+  # Invalid arguments to throw are raised to the caller, and the generator
+  # carries on.
+  for make in (echo, falcon_echo):
+    log = []
+    g = make(log)
+    g.next()
+    for args in ((42,), (KeyError('k'), 'value')):
+      try:
+        g.throw(*args)
+        assert False, 'Expected TypeError'
+      except TypeError:
+        pass
+    assert g.send('a') == 1 and log == ['a'], log
+    g.close()
+
+def test_introspection():
+  for make in (echo, falcon_echo):
+    g = make([])
+    ref = weakref.ref(g)
+    assert ref() is g
+    assert g.gi_code is echo.func_code
+    assert g.gi_frame.f_code is echo.func_code
+    assert not g.gi_running
+    g.next()
+    assert g.gi_frame.f_lineno == echo.func_code.co_firstlineno + 4, g.gi_frame.f_lineno
+    g.close()
+    assert g.gi_frame is None
+    del g
+    assert ref() is None
@@ -0,0 +1,50 @@
+import falcon
+from testing_helpers import wrap
+
+counter = 1
+
+@wrap
+def read_globals(x):
+  return len(x) + counter
+
+def test_load_global():
+  for i in range(10):
+    read_globals([1, 2, 3])
+
+def test_global_reassigned():
+  global counter
+  read_globals([1])
+  counter = 5
+  read_globals([1])
+  counter = 1
+
+def test_builtin_shadowed():
+  global len
+  read_globals([1])
+  len = lambda x: 42
+  try:
+    read_globals([1])
+  finally:
+    del len
+  read_globals([1])
+
+def test_globals_resized():
+  read_globals([1])
+  for i in range(100):
+    globals()['filler_%d' % i] = i
+  read_globals([1])
+  for i in range(100):
+    del globals()['filler_%d' % i]
+  read_globals([1])
+
+def test_global_deleted():
+  global counter
+  read_globals([1])
+  del counter
+  try:
+    falcon.wrap(read_globals.python_fn)([1])
+    assert False, 'Expected NameError'
+  except NameError:
+    pass
+  finally:
+    counter = 1
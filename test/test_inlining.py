@@ -0,0 +1,132 @@
+import types
+from testing_helpers import wrap
+
+# Small helpers which make no calls of their own are inlined into their
+# callers.  Rebinding a helper must take its callers back to a real call.
+
+SCALE = 10
+
+def scale(a, b):
+  t = a + b
+  return t * SCALE
+
+def pick(a, b):
+  x = a
+  if x != b:
+    return 'differ'
+  else:
+    return 'same'
+
+def clamp(v, hi):
+  if v > hi:
+    v = hi
+  return v
+
+def div(a, b):
+  return a / b
+
+class Box(object):
+  pass
+
+def fill(box, v):
+  box.value = v
+  box.items = [v, v + 1]
+
+counter = 0
+
+def bump(n):
+  global counter
+  counter = counter + n
+
+@wrap
+def call_helpers(n):
+  total = 0
+  picked = []
+  for i in range(n):
+    total = total + scale(i, 2) + clamp(i, 3)
+    picked.append(pick(i, 3))
+  return total, picked
+
+@wrap
+def call_div(a, b):
+  try:
+    return div(a, b)
+  except ZeroDivisionError:
+    return 'caught'
+
+@wrap
+def call_fill(v):
+  box = Box()
+  fill(box, v)
+  return box.value, box.items, v
+
+@wrap
+def call_bump(n):
+  for i in range(n):
+    bump(i)
+  return n
+
+def test_inlined():
+  call_helpers(10)
+  call_fill(3)
+
+def test_errors():
+  call_div(6, 3)
+  call_div(1, 0)
+  wrapped = wrap(div)
+  try:
+    wrapped(1, 0)
+    assert False, 'Expected ZeroDivisionError'
+  except ZeroDivisionError:
+    pass
+
+def test_store_global():
+  global counter
+  counter = 0
+  call_bump(5)
+  # Both the Python and Falcon calls added to it.
+  assert counter == 20, counter
+
+def test_rebound():
+  global scale
+  original = scale
+  call_helpers(5)
+  try:
+    scale = lambda a, b: a - b
+    call_helpers(5)
+    scale = original
+    call_helpers(5)
+  finally:
+    scale = original
+
+def test_code_replaced():
+  original = pick.func_code
+  call_helpers(5)
+  try:
+    pick.func_code = (lambda a, b: a * b).func_code
+    call_helpers(5)
+  finally:
+    pick.func_code = original
+  call_helpers(5)
+
+def call_scale(a):
+  return scale(a, 1)
+
+def test_other_globals():
+  # Compiled while scale looks SCALE up in globals of its own, so it must
+  # not be inlined.
+  global scale
+  original = scale
+  try:
+    scale = types.FunctionType(original.func_code, { 'SCALE': 100 })
+    wrap(call_scale)(4)
+  finally:
+    scale = original
+
+def test_caller_globals():
+  # The same scale, called from call_scale's code running with other
+  # globals: the inlined body would look SCALE up in those.
+  wrap(call_scale)(4)
+  other_globals = dict(globals())
+  other_globals['SCALE'] = 100
+  wrap(types.FunctionType(call_scale.func_code, other_globals))(4)
@@ -0,0 +1,113 @@
+import math
+import falcon
+from testing_helpers import wrap
+
+class Counter(object):
+  def __init__(self):
+    self.n = 0
+
+  def add(self, x, y=1):
+    return self.n + x * y
+
+  @staticmethod
+  def double(x):
+    return x * 2
+
+  @classmethod
+  def make(cls, n):
+    c = cls()
+    c.n = n
+    return c
+
+class OldStyle:
+  def get(self, x):
+    return x + 1
+
+@wrap
+def call_methods(c, x):
+  c.add(x)
+  c.add(x, y=3)
+  c.add(*(x,))
+  return c.double(x) + c.make(x).n + c.add(c.double(x))
+
+def test_methods():
+  for i in range(5):
+    call_methods(Counter(), i)
+
+def test_instance_function():
+  c = Counter()
+  c.add(1)
+  call_methods(c, 1)
+  # A function stored on the instance is not bound.
+  c.add = lambda x, y=1: x - y
+  call_methods(c, 2)
+  del c.add
+  call_methods(c, 3)
+
+def test_old_style():
+  o = OldStyle()
+  call_methods(Counter(), 1)
+  try:
+    falcon.wrap(call_methods.python_fn)(o, 1)
+    assert False, 'Expected AttributeError'
+  except AttributeError:
+    pass
+
+@wrap
+def call_get(o, x):
+  return o.get(x)
+
+def test_builtin_methods():
+  for o in [OldStyle(), {1: 2}, OldStyle(), {}]:
+    call_get(o, 1)
+
+@wrap
+def call_module(m, x):
+  return m.sqrt(x)
+
+def test_module_function():
+  for i in range(5):
+    call_module(math, i)
+
+@wrap
+def rebind_receiver(c, xs):
+  # In Python 2, x leaks out of the comprehension and is reassigned
+  # between the method lookup and the call.
+  x = c
+  return x.add(len([x for x in xs]))
+
+def test_rebind_receiver():
+  rebind_receiver(Counter(), [1, 2, 3])
+
+@wrap
+def method_error(c):
+  return c.add('a', None)
+
+def test_method_error():
+  try:
+    method_error.falcon_fn(Counter())
+    assert False, 'Expected TypeError'
+  except TypeError:
+    pass
+
+@wrap
+def builtin_calls(s, xs):
+  out = [len(s), ord(s[0]), abs(-len(xs)), math.sqrt(len(s)), max(xs), min(1, 2, 3), globals() is not None]
+  xs.append(len(s))
+  out.append(xs.pop())
+  for bad in (s, None):
+    try:
+      out.append(len(bad, bad))
+    except TypeError, e:
+      out.append(str(e))
+    try:
+      out.append(ord(bad))
+    except TypeError, e:
+      out.append(str(e))
+  return out
+
+def test_builtin_calls():
+  # Calls to C functions, by each of METH_O, METH_NOARGS and
+  # METH_VARARGS, and with counts they reject.
+  builtin_calls('abc', [1, 2])
+  builtin_calls('x', [5])
@@ -0,0 +1,80 @@
+import math
+import falcon
+from testing_helpers import wrap
+
+# Each function is called with a stable operand type, so its generic
+# operations are quickened, and then with other types, which must take
+# them back to the generic form.
+
+@wrap
+def lookup(c, k):
+  return c[k]
+
+@wrap
+def combine(a, b):
+  x = a + b
+  x -= a
+  x *= b
+  return x
+
+@wrap
+def less(a, b):
+  return a < b
+
+class Point(object):
+  sqrt = 'not a function'
+
+@wrap
+def get_sqrt(m):
+  return m.sqrt
+
+def test_subscr():
+  for i in range(10):
+    lookup([1, 2, 3], i % 3)
+  for i in range(10):
+    lookup({'a': 1, 'b': 2}, 'a')
+  lookup((1, 2, 3), 1)
+  lookup('abc', -1)
+  lookup([1, 2, 3], -1)
+  lookup([1, 2, 3], slice(0, 2))
+
+def test_subscr_error():
+  for i in range(10):
+    lookup([1, 2, 3], i % 3)
+  try:
+    falcon.wrap(lookup.python_fn)({}, 'missing')
+    assert False, 'Expected KeyError'
+  except KeyError:
+    pass
+
+def test_float_arith():
+  for i in range(10):
+    combine(1.5 * i, 0.25)
+  combine(3, 4)
+  combine(2.5, 4)
+  combine(1 << 62, 5)
+  for i in range(10):
+    combine(0.5, 1.5)
+
+def test_float_compare():
+  for i in range(10):
+    less(float(i), 4.5)
+  less(3, 4)
+  less('a', 'b')
+  less(float('nan'), 1.0)
+  less(2.0, 1)
+
+def test_module_attr():
+  for i in range(10):
+    get_sqrt(math)
+  get_sqrt(Point())
+  get_sqrt(math)
+
+def test_module_attr_error():
+  for i in range(10):
+    get_sqrt(math)
+  try:
+    falcon.wrap(get_sqrt.python_fn)(falcon)
+    assert False, 'Expected AttributeError'
+  except AttributeError:
+    pass
@@ -0,0 +1,30 @@
+import falcon
+from testing_helpers import wrap
+
+@wrap
+def sum_squares(n):
+  i = 0
+  t = 0
+  while i < n:
+    t += i * i
+    i += 1
+  return t
+
+def trace(m, n):
+  t = 0
+  for i in range(n):
+    t += m[i][i] * 2
+  return t
+
+def test_fused_loop():
+  sum_squares(100)
+
+def test_fused_subscript():
+  wrap(trace)([[1, 2], [3, 4]], 2)
+
+def test_fused_subscript_error():
+  try:
+    falcon.wrap(trace)([[1, 2], [3, 4]], 3)
+    assert False, 'Expected IndexError'
+  except IndexError:
+    pass
@@ -0,0 +1,74 @@
+import signal
+import threading
+import falcon
+from testing_helpers import wrap
+
+# A loop run by falcon must let other threads take the GIL, and signal
+# handlers run.
+
+@wrap
+def wait_for(flag, n):
+  i = 0
+  while not flag and i < n:
+    i += 1
+  return len(flag)
+
+def test_release_gil():
+  wait_for([], 10)
+  flag = []
+  t = threading.Thread(target=flag.append, args=(1,))
+  t.start()
+  assert wait_for.falcon_fn(flag, 100000000) == 1
+  t.join()
+
+class Interrupted(Exception):
+  pass
+
+def interrupt(signum, frame):
+  raise Interrupted()
+
+@wrap
+def spin(n):
+  i = 0
+  while i < n:
+    i += 1
+  return i
+
+def test_signal():
+  spin(10)
+  old = signal.signal(signal.SIGALRM, interrupt)
+  try:
+    signal.setitimer(signal.ITIMER_REAL, 0.05)
+    spin.falcon_fn(100000000)
+    assert False, 'Expected Interrupted'
+  except Interrupted:
+    pass
+  finally:
+    signal.setitimer(signal.ITIMER_REAL, 0)
+    signal.signal(signal.SIGALRM, old)
+
+def depth(n):
+  if n == 0:
+    return 0
+  return depth(n - 1) + 1
+
+@wrap
+def call_depths(n, times):
+  total = 0
+  for i in xrange(times):
+    total += depth(n)
+  return total
+
+def test_concurrent_calls():
+  # Frames of several threads are live at once, each thread switching
+  # out mid-frame.
+  falcon.wrap(depth)(1)
+  results = []
+  def run():
+    results.append(call_depths.falcon_fn(20, 5000))
+  threads = [threading.Thread(target=run) for i in range(4)]
+  for t in threads:
+    t.start()
+  for t in threads:
+    t.join()
+  assert results == [100000] * 4, results
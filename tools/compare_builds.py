@@ -0,0 +1,71 @@
+#!/usr/bin/env python
+'''Compare the benchmark times of two or more builds of Falcon.
+
+Each BUILD is a directory holding a _falcon_core.so, such as build/opt
+(see `make opt`).  Every benchmark is run --repeat times under each build,
+alternating between builds so that machine noise is spread evenly.  The
+best time of each is reported, with its ratio to the first build.
+
+Usage: compare_builds.py [--repeat N] [--python PATH] BUILD BUILD...
+'''
+
+from __future__ import print_function
+
+import glob
+import optparse
+import os
+import subprocess
+import sys
+import time
+
+TOPDIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+
+
+def run(python, build, script):
+  env = dict(os.environ)
+  # The build must come before src, which may hold a link to another build.
+  env['PYTHONPATH'] = os.pathsep.join([os.path.abspath(build), os.path.join(TOPDIR, 'src')])
+  with open(os.devnull, 'w') as devnull:
+    start = time.time()
+    rc = subprocess.call([python, '-m', 'falcon', script], env=env,
+                         stdout=devnull, stderr=devnull)
+    elapsed = time.time() - start
+  return elapsed if rc == 0 else None
+
+
+def main():
+  parser = optparse.OptionParser(usage='%prog [options] BUILD BUILD...')
+  parser.add_option('--repeat', type='int', default=5)
+  parser.add_option('--python', default=sys.executable)
+  options, builds = parser.parse_args()
+  if len(builds) < 2:
+    parser.error('at least two builds are needed')
+
+  scripts = sorted(s for s in glob.glob(os.path.join(TOPDIR, 'benchmarks', '*.py'))
+                   if os.path.basename(s) != 'run_all.py')
+
+  print('%-20s' % 'benchmark' + ''.join('%16s' % os.path.basename(os.path.normpath(b)) for b in builds))
+  for script in scripts:
+    best = [None] * len(builds)
+    failed = [False] * len(builds)
+    for i in range(options.repeat):
+      for j, build in enumerate(builds):
+        t = run(options.python, build, script)
+        if t is None:
+          failed[j] = True
+        elif best[j] is None or t < best[j]:
+          best[j] = t
+
+    cols = []
+    for j in range(len(builds)):
+      if failed[j]:
+        cols.append('%16s' % 'FAILED')
+      elif j == 0 or failed[0]:
+        cols.append('%15.3fs' % best[j])
+      else:
+        cols.append('%8.3fs %5.2fx' % (best[j], best[j] / best[0]))
+    print('%-20s' % os.path.basename(script) + ''.join(cols))
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,189 @@
+#!/usr/bin/env python
+'''Generate src/falcon/superinstructions.h from opcode sequence profiles.
+
+Profiles are written by an evaluator built with -DPROFILE_OP_SEQUENCES=1
+when $FALCON_OP_PROFILE names an output file (see `make superinstructions`).
+Each run appends a block of "<count> <op> <op> [<op>]" lines, headed by a
+"# <workload>" line.  Blocks are normalized so every workload carries the
+same weight, then the sequences that would save the most dispatches are
+turned into fused opcodes.
+
+Usage: gen_superinstructions.py [--max N] [--handlers FILE] [--out FILE] PROFILE...
+'''
+
+from __future__ import print_function
+
+import collections
+import optparse
+import os
+import re
+import sys
+
+TOPDIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+
+# Every handler that is invoked through one of these macros in
+# reval_handlers.h can be composed into a superinstruction.
+HANDLER_RE = re.compile(r'^\s*(DEFINE_OP|BINARY_OP3|BINARY_OP2|BINARY_OP_IMM|BINARY_OP_FLOAT|UNARY_OP2|FALLTHROUGH)\((.*)\);\s*$')
+
+
+def parse_first_opcode(oputil_path):
+  '''Superinstructions are numbered from FIRST_SUPERINSTRUCTION.'''
+  for line in open(oputil_path):
+    m = re.match(r'#define FIRST_SUPERINSTRUCTION (\d+)', line)
+    if m:
+      return int(m.group(1))
+  raise ValueError('FIRST_SUPERINSTRUCTION not defined in %s' % oputil_path)
+
+
+def parse_handlers(handlers_path):
+  '''Map opcode name -> handler type expression used by the evaluator.'''
+  handlers = {}
+  pending = []
+  for line in open(handlers_path):
+    m = HANDLER_RE.match(line)
+    if not m:
+      continue
+    kind, args = m.group(1), [a.strip() for a in m.group(2).split(',')]
+    opname = args[0]
+    if kind == 'FALLTHROUGH':
+      pending.append(opname)
+      continue
+    if kind == 'DEFINE_OP':
+      impl = ', '.join(args[1:])
+    elif kind == 'BINARY_OP3':
+      impl = 'BinaryOpWithSpecialization<CONCAT(%s)>' % ', '.join(args)
+    elif kind == 'BINARY_OP2':
+      impl = 'BinaryOp<CONCAT(%s)>' % ', '.join(args)
+    elif kind == 'BINARY_OP_IMM':
+      impl = 'BinaryOpImm<CONCAT(%s)>' % ', '.join(args)
+    elif kind == 'BINARY_OP_FLOAT':
+      impl = 'BinaryFloatOp<CONCAT(%s)>' % ', '.join(args)
+    else:
+      impl = 'UnaryOp<CONCAT(%s)>' % ', '.join(args)
+    for name in pending + [opname]:
+      handlers.setdefault(name, impl)
+    pending = []
+  return handlers
+
+
+def read_profiles(paths):
+  '''Return {sequence: weight}, each workload normalized to a total of 1.'''
+  weights = collections.defaultdict(float)
+  for path in paths:
+    blocks = []
+    for line in open(path):
+      line = line.strip()
+      if not line:
+        continue
+      if line.startswith('#'):
+        blocks.append({})
+        continue
+      if not blocks:
+        blocks.append({})
+      fields = line.split()
+      seq = tuple(fields[1:])
+      blocks[-1][seq] = blocks[-1].get(seq, 0) + int(fields[0])
+    for block in blocks:
+      # Normalize by the number of executed pairs in the workload.
+      total = float(sum(c for s, c in block.items() if len(s) == 2)) or 1.0
+      for seq, count in block.items():
+        weights[seq] += count / total
+  return weights
+
+
+def select(weights, handlers, max_ops):
+  candidates = []
+  for seq, weight in weights.items():
+    if not all(op in handlers for op in seq):
+      continue
+    if any(op.startswith('SUPER_') for op in seq):
+      continue
+    # A superinstruction of length n saves n - 1 dispatches.
+    candidates.append((weight * (len(seq) - 1), seq))
+  candidates.sort(key=lambda c: (-c[0], c[1]))
+  return [seq for _, seq in candidates[:max_ops]]
+
+
+def super_name(seq):
+  return 'SUPER_' + '__'.join(op.replace('+', '_') for op in seq)
+
+
+def write_header(out, first, seqs, handlers, workloads):
+  lines = []
+  w = lines.append
+  w('// Generated by tools/gen_superinstructions.py -- do not edit.')
+  w('//')
+  w('// Each superinstruction fuses a common opcode sequence into a single')
+  w('// dispatch.  Only the opcode of the first instruction is rewritten; the')
+  w('// remaining instructions keep their encoding and are run in line by the')
+  w('// fused handler.')
+  if workloads:
+    w('//')
+    w('// Profiled workloads: %s' % ', '.join(workloads))
+  w('')
+  w('#ifndef FALCON_SUPERINSTRUCTIONS_H')
+  w('#define FALCON_SUPERINSTRUCTIONS_H')
+  w('')
+  # Handler labels are pasted from opcode values, so these must be literals.
+  w('#if FIRST_SUPERINSTRUCTION != %d' % first)
+  w('#error "superinstructions.h is out of date; rerun tools/gen_superinstructions.py"')
+  w('#endif')
+  w('')
+  for i, seq in enumerate(seqs):
+    w('#define %s %d' % (super_name(seq), first + i))
+  w('#define NUM_SUPERINSTRUCTIONS %d' % len(seqs))
+  w('')
+
+  def x_macro(name, comment, fmt):
+    w('// %s' % comment)
+    w('#define %s(X2, X3)%s' % (name, ' \\' if seqs else ''))
+    for i, seq in enumerate(seqs):
+      sep = ' \\' if i + 1 < len(seqs) else ''
+      w('  X%d(%s, %s)%s' % (len(seq), super_name(seq), ', '.join(fmt(op) for op in seq), sep))
+    w('')
+
+  x_macro('SUPERINSTRUCTIONS', 'X2(super, op1, op2) and X3(super, op1, op2, op3), in opcode order.',
+          lambda op: op)
+  x_macro('SUPERINSTRUCTION_HANDLERS', 'The same list, naming the evaluator handler for each operation.',
+          lambda op: handlers[op])
+  w('#endif /* FALCON_SUPERINSTRUCTIONS_H */')
+  out.write('\n'.join(lines) + '\n')
+
+
+def workload_names(paths):
+  names = []
+  for path in paths:
+    for line in open(path):
+      if line.startswith('#'):
+        name = line[1:].strip()
+        if name and name not in names:
+          names.append(name)
+  return names
+
+
+def main():
+  parser = optparse.OptionParser(usage='%prog [options] PROFILE...')
+  parser.add_option('--max', type='int', default=24,
+                    help='maximum number of superinstructions to generate')
+  parser.add_option('--handlers', default=os.path.join(TOPDIR, 'src', 'falcon', 'reval_handlers.h'))
+  parser.add_option('--oputil', default=os.path.join(TOPDIR, 'src', 'falcon', 'oputil.h'))
+  parser.add_option('--out', default=os.path.join(TOPDIR, 'src', 'falcon', 'superinstructions.h'))
+  options, paths = parser.parse_args()
+
+  # Opcodes must fit in a byte.
+  first = parse_first_opcode(options.oputil)
+  if first + options.max > 256:
+    parser.error('at most %d superinstructions are supported' % (256 - first))
+
+  handlers = parse_handlers(options.handlers)
+  seqs = select(read_profiles(paths), handlers, options.max)
+  # Longer sequences are matched first by the compiler, but opcode order
+  # is otherwise irrelevant; keep the output stable.
+  seqs.sort(key=lambda s: (len(s), s))
+  with open(options.out, 'w') as out:
+    write_header(out, first, seqs, handlers, workload_names(paths))
+  print('Wrote %d superinstructions to %s' % (len(seqs), options.out), file=sys.stderr)
+
+
+if __name__ == '__main__':
+  main()